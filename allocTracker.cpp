@@ -0,0 +1,327 @@
+﻿#include "allocTracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#endif
+
+namespace {
+	struct Slot {
+		std::atomic<uint64_t> allocations;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> frees;
+	};
+
+	// Everything here is zero-initialized before any constructor runs, the
+	// hooks are called long before main and must not depend on dynamic init
+	Slot slots[ME::AllocTracker::MAX_THREADS];
+	std::atomic<int> slotCount;
+	std::atomic<int> mode;
+	std::atomic<bool> armed;
+	std::atomic<bool> checkMalloc;
+	std::atomic<int> frameScopes;
+	std::atomic<size_t> violations;
+	thread_local int threadSlot = -1;
+}
+
+bool ME::AllocTracker::isEnabled() {
+#ifdef ME_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+ME::AllocTracker::Counters ME::AllocTracker::getTotal() {
+	Counters total;
+	int used = slotCount.load();
+	if (used > MAX_THREADS)
+		used = MAX_THREADS;
+	for (int i = 0; i < used; i++) {
+		total.allocations += slots[i].allocations.load(std::memory_order_relaxed);
+		total.bytes += slots[i].bytes.load(std::memory_order_relaxed);
+		total.frees += slots[i].frees.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+ME::AllocTracker::Counters ME::AllocTracker::getThread() {
+	Counters counters;
+	if (threadSlot < 0)
+		return counters;
+	counters.allocations = slots[threadSlot].allocations.load(std::memory_order_relaxed);
+	counters.bytes = slots[threadSlot].bytes.load(std::memory_order_relaxed);
+	counters.frees = slots[threadSlot].frees.load(std::memory_order_relaxed);
+	return counters;
+}
+
+void ME::AllocTracker::setMode(Mode newMode) {
+	mode = static_cast<int>(newMode);
+}
+
+void ME::AllocTracker::setCheckMalloc(bool check) {
+	checkMalloc = check;
+}
+
+void ME::AllocTracker::arm() {
+#if defined(__GLIBC__)
+	// The first backtrace loads libgcc, which would allocate mid-report
+	void* frame;
+	backtrace(&frame, 1);
+#endif
+	armed = true;
+}
+
+void ME::AllocTracker::disarm() {
+	armed = false;
+}
+
+bool ME::AllocTracker::isArmed() {
+	return armed;
+}
+
+void ME::AllocTracker::enterFrameScope() {
+	frameScopes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ME::AllocTracker::leaveFrameScope() {
+	frameScopes.fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t ME::AllocTracker::getViolations() {
+	return violations;
+}
+
+#ifdef ME_TRACK_ALLOCATIONS
+
+#if defined(__GLIBC__)
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* memory, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* memory);
+}
+#endif
+
+// Only the hooks count and report, the rest is read-only without them
+namespace {
+	// Zero-initialized like the counters above
+	std::atomic<bool> reported;
+
+	// Set while our operator new runs, so its malloc isn't counted twice
+	thread_local int insideNew = 0;
+	thread_local bool reporting = false;
+
+	Slot& getSlot() {
+		if (threadSlot < 0) {
+			int slot = slotCount.fetch_add(1, std::memory_order_relaxed);
+			// Late threads share the last slot, the counters are atomic anyway
+			threadSlot = slot < ME::AllocTracker::MAX_THREADS ? slot : ME::AllocTracker::MAX_THREADS - 1;
+		}
+		return slots[threadSlot];
+	}
+
+	void printStackTrace() {
+#if defined(__GLIBC__)
+		void* frames[32];
+		int count = backtrace(frames, 32);
+		// Writes straight to the descriptor without allocating
+		backtrace_symbols_fd(frames, count, STDERR_FILENO);
+#elif defined(_WIN32)
+		void* frames[32];
+		USHORT count = CaptureStackBackTrace(0, 32, frames, nullptr);
+		for (USHORT i = 0; i < count; i++)
+			std::fprintf(stderr, "  %p\n", frames[i]);
+#endif
+	}
+
+	void report(size_t size, bool isMalloc) {
+		violations.fetch_add(1, std::memory_order_relaxed);
+		ME::AllocTracker::Mode current = static_cast<ME::AllocTracker::Mode>(mode.load(std::memory_order_relaxed));
+		if (current == ME::AllocTracker::Mode::COUNT || reporting)
+			return;
+		if (current == ME::AllocTracker::Mode::LOG && reported.exchange(true))
+			return;
+		reporting = true;
+		std::fprintf(stderr, "Allocation of %zu bytes by %s inside a frame:\n", size, isMalloc ? "malloc" : "operator new");
+		printStackTrace();
+		if (current == ME::AllocTracker::Mode::ABORT)
+			std::abort();
+		reporting = false;
+	}
+
+	void count(size_t size, bool isMalloc) {
+		Slot& slot = getSlot();
+		slot.allocations.fetch_add(1, std::memory_order_relaxed);
+		slot.bytes.fetch_add(size, std::memory_order_relaxed);
+		if (armed.load(std::memory_order_relaxed) && frameScopes.load(std::memory_order_relaxed) > 0
+			&& (!isMalloc || checkMalloc.load(std::memory_order_relaxed)))
+			report(size, isMalloc);
+	}
+
+	void countFree(void* memory) {
+		if (memory != nullptr)
+			getSlot().frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void* rawAllocate(size_t size, size_t alignment) {
+		insideNew++;
+		if (size == 0)
+			size = 1;
+		count(size, false);
+		void* memory;
+#if defined(__GLIBC__)
+		memory = alignment > alignof(std::max_align_t) ? __libc_memalign(alignment, size) : __libc_malloc(size);
+#elif defined(_MSC_VER)
+		memory = alignment > alignof(std::max_align_t) ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+		memory = alignment > alignof(std::max_align_t) ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+#endif
+		insideNew--;
+		return memory;
+	}
+
+	void rawFree(void* memory, size_t alignment) {
+		countFree(memory);
+#if defined(__GLIBC__)
+		(void)alignment;
+		__libc_free(memory);
+#elif defined(_MSC_VER)
+		if (alignment > alignof(std::max_align_t))
+			_aligned_free(memory);
+		else
+			std::free(memory);
+#else
+		(void)alignment;
+		std::free(memory);
+#endif
+	}
+
+	void* allocateOrThrow(size_t size, size_t alignment) {
+		void* memory = rawAllocate(size, alignment);
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+}
+
+void* operator new(std::size_t size) {
+	return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+	return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return rawAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return rawAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return rawAllocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return rawAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete[](void* memory) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	rawFree(memory, alignof(std::max_align_t));
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	rawFree(memory, static_cast<size_t>(alignment));
+}
+
+#if defined(__GLIBC__)
+// glibc lets the executable interpose malloc, which also catches C libraries
+// and drivers. Elsewhere only operator new is tracked.
+extern "C" {
+	void* malloc(size_t size) noexcept {
+		if (insideNew == 0)
+			count(size, true);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t number, size_t size) noexcept {
+		count(number * size, true);
+		return __libc_calloc(number, size);
+	}
+
+	void* realloc(void* memory, size_t size) noexcept {
+		if (size > 0)
+			count(size, true);
+		if (size == 0 && memory != nullptr)
+			countFree(memory);
+		return __libc_realloc(memory, size);
+	}
+
+	void free(void* memory) noexcept {
+		countFree(memory);
+		__libc_free(memory);
+	}
+}
+#endif
+
+#endif
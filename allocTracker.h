@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ME {
+	// Counts heap allocations per thread by replacing the global operator new
+	// and delete, and on glibc also malloc. Once armed, allocating while a
+	// frame scope is open anywhere in the program is a violation, which is
+	// how the render loop proves it reaches a zero-allocation steady state.
+	// The hooks are only compiled with ME_TRACK_ALLOCATIONS, without it every
+	// counter stays zero.
+	class AllocTracker {
+	public:
+		static const int MAX_THREADS = 64;
+		// What a violation does. LOG prints the first one with a stack trace.
+		enum class Mode { COUNT, LOG, ABORT };
+		struct Counters {
+			uint64_t allocations = 0;
+			uint64_t bytes = 0;
+			uint64_t frees = 0;
+		};
+	public:
+		static bool isEnabled();
+		// Summed over every thread
+		static Counters getTotal();
+		// The calling thread only
+		static Counters getThread();
+		static void setMode(Mode mode);
+		// Plain malloc is always counted but only checked when asked to, GL
+		// drivers and GLFW allocate behind our back
+		static void setCheckMalloc(bool check);
+		// Starts checking frame scopes, call once warm-up is over
+		static void arm();
+		static void disarm();
+		static bool isArmed();
+		static void enterFrameScope();
+		static void leaveFrameScope();
+		// Allocations made in an armed frame scope
+		static size_t getViolations();
+	};
+
+	class AllocFrameScope {
+	public:
+		AllocFrameScope() { AllocTracker::enterFrameScope(); }
+		AllocFrameScope(const AllocFrameScope&) = delete;
+		AllocFrameScope& operator=(const AllocFrameScope&) = delete;
+		~AllocFrameScope() { AllocTracker::leaveFrameScope(); }
+	};
+}
@@ -0,0 +1,145 @@
+﻿#include "benchHarness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+	const void* volatile sink;
+
+	void writeJsonString(std::FILE* file, const std::string& string) {
+		std::fputc('"', file);
+		for (char c : string) {
+			if (c == '"' || c == '\\')
+				std::fputc('\\', file);
+			if (static_cast<unsigned char>(c) >= 0x20)
+				std::fputc(c, file);
+		}
+		std::fputc('"', file);
+	}
+
+	// Reads a quoted string or a number following key on a line we wrote
+	bool findString(const std::string& line, const char* key, std::string& value) {
+		size_t position = line.find(key);
+		if (position == std::string::npos)
+			return false;
+		position = line.find('"', position + std::strlen(key));
+		if (position == std::string::npos)
+			return false;
+		value.clear();
+		for (position++; position < line.size() && line[position] != '"'; position++) {
+			if (line[position] == '\\' && position + 1 < line.size())
+				position++;
+			value += line[position];
+		}
+		return true;
+	}
+
+	bool findNumber(const std::string& line, const char* key, double& value) {
+		size_t position = line.find(key);
+		if (position == std::string::npos)
+			return false;
+		position = line.find(':', position);
+		return position != std::string::npos && std::sscanf(line.c_str() + position + 1, "%lf", &value) == 1;
+	}
+}
+
+void ME::benchSink(const void* value) {
+	sink = value;
+}
+
+ME::BenchRunner::BenchRunner(double secondsPerBenchmark, int batches) {
+	this->batches = batches > 0 ? batches : 1;
+	batchNanoseconds = secondsPerBenchmark * 1e9 / this->batches;
+}
+
+void ME::BenchRunner::setFilter(const std::string& filter) {
+	this->filter = filter;
+}
+
+void ME::BenchRunner::setMetadata(const std::string& key, const std::string& value) {
+	for (auto& entry : metadata) {
+		if (entry.first == key) {
+			entry.second = value;
+			return;
+		}
+	}
+	metadata.emplace_back(key, value);
+}
+
+const std::vector<ME::BenchRunner::Result>& ME::BenchRunner::getResults() const {
+	return results;
+}
+
+bool ME::BenchRunner::matches(const char* name) const {
+	return filter.empty() || std::strstr(name, filter.c_str()) != nullptr;
+}
+
+void ME::BenchRunner::addResult(const char* name, uint64_t batchSize, std::vector<double>& samples) {
+	Result result;
+	result.name = name;
+	result.iterations = batchSize * samples.size();
+	std::sort(samples.begin(), samples.end());
+	result.minNanoseconds = samples.front();
+	result.medianNanoseconds = samples[samples.size() / 2];
+	for (double sample : samples)
+		result.meanNanoseconds += sample;
+	result.meanNanoseconds /= samples.size();
+	results.push_back(result);
+	std::printf("%-40s %14.1f ns  (min %.1f, %llu iterations)\n", name, result.medianNanoseconds,
+		result.minNanoseconds, static_cast<unsigned long long>(result.iterations));
+	std::fflush(stdout);
+}
+
+bool ME::BenchRunner::writeJson(const std::string& path) const {
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (file == nullptr)
+		return false;
+	std::fprintf(file, "{\n  \"metadata\": {");
+	for (size_t i = 0; i < metadata.size(); i++) {
+		std::fprintf(file, i == 0 ? "\n    " : ",\n    ");
+		writeJsonString(file, metadata[i].first);
+		std::fprintf(file, ": ");
+		writeJsonString(file, metadata[i].second);
+	}
+	std::fprintf(file, "\n  },\n  \"benchmarks\": [");
+	// One benchmark per line keeps the file easy to diff and to read back
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+		std::fprintf(file, i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ");
+		writeJsonString(file, result.name);
+		std::fprintf(file, ", \"iterations\": %llu, \"median ns\": %.3f, \"min ns\": %.3f, \"mean ns\": %.3f}",
+			static_cast<unsigned long long>(result.iterations), result.medianNanoseconds,
+			result.minNanoseconds, result.meanNanoseconds);
+	}
+	std::fprintf(file, "\n  ]\n}\n");
+	return std::fclose(file) == 0;
+}
+
+bool ME::BenchRunner::compare(const std::string& path) const {
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	std::vector<std::pair<std::string, double>> baseline;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::string name;
+		double median;
+		if (findString(line, "\"name\"", name) && findNumber(line, "\"median ns\"", median))
+			baseline.emplace_back(name, median);
+	}
+	std::printf("\nCompared with %s:\n", path.c_str());
+	for (const Result& result : results) {
+		auto found = std::find_if(baseline.begin(), baseline.end(),
+			[&result](const std::pair<std::string, double>& entry) { return entry.first == result.name; });
+		if (found == baseline.end()) {
+			std::printf("%-40s %14.1f ns  (new)\n", result.name.c_str(), result.medianNanoseconds);
+			continue;
+		}
+		double change = found->second > 0 ? (result.medianNanoseconds / found->second - 1) * 100 : 0;
+		std::printf("%-40s %14.1f ns  was %.1f ns  %+.1f%%\n", result.name.c_str(),
+			result.medianNanoseconds, found->second, change);
+	}
+	return true;
+}
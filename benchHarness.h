@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ME {
+	// Keeps the compiler from optimizing a benchmarked result away
+	void benchSink(const void* value);
+	template <typename T>
+	inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "g"(&value) : "memory");
+#else
+		benchSink(&value);
+#endif
+	}
+
+	// A small built-in microbenchmark runner. Each benchmark runs in batches
+	// big enough to time reliably, and the per-iteration time of every batch
+	// goes into the result, so one noisy batch doesn't move the median.
+	// Results are written as JSON and can be compared with an earlier run.
+	class BenchRunner {
+	public:
+		struct Result {
+			std::string name;
+			uint64_t iterations = 0;
+			double minNanoseconds = 0;
+			double medianNanoseconds = 0;
+			double meanNanoseconds = 0;
+		};
+	public:
+		explicit BenchRunner(double secondsPerBenchmark = 0.5, int batches = 15);
+		// Only benchmarks whose name contains the filter run
+		void setFilter(const std::string& filter);
+		void setMetadata(const std::string& key, const std::string& value);
+		// Times body(), which performs one iteration
+		template <typename Body>
+		void run(const char* name, Body body);
+		const std::vector<Result>& getResults() const;
+		bool writeJson(const std::string& path) const;
+		// Prints every result next to the same benchmark in an earlier JSON file
+		bool compare(const std::string& path) const;
+	private:
+		bool matches(const char* name) const;
+		void addResult(const char* name, uint64_t batchSize, std::vector<double>& samples);
+
+		template <typename Body>
+		static double timeBatch(Body& body, uint64_t batchSize) {
+			auto begin = std::chrono::steady_clock::now();
+			for (uint64_t i = 0; i < batchSize; i++)
+				body();
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+		}
+
+		double batchNanoseconds;
+		int batches;
+		std::string filter;
+		std::vector<std::pair<std::string, std::string>> metadata;
+		std::vector<Result> results;
+	};
+
+	template <typename Body>
+	void BenchRunner::run(const char* name, Body body) {
+		if (!matches(name))
+			return;
+		// Grow the batch until it is long enough for the clock, this also warms up
+		uint64_t batchSize = 1;
+		double elapsed = timeBatch(body, batchSize);
+		while (elapsed < batchNanoseconds && batchSize < (1ull << 32)) {
+			batchSize *= elapsed < batchNanoseconds / 10 ? 10 : 2;
+			elapsed = timeBatch(body, batchSize);
+		}
+		std::vector<double> samples;
+		samples.reserve(batches);
+		for (int batch = 0; batch < batches; batch++)
+			samples.push_back(timeBatch(body, batchSize) / batchSize);
+		addResult(name, batchSize, samples);
+	}
+}
@@ -0,0 +1,395 @@
+﻿#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace {
+	const int MAX_TRAVERSAL_DEPTH = 256;
+	// Skewed centroids can make the SAH peel off a few objects per level.
+	// Below this depth every split halves the node, which takes at most 32
+	// more levels, so traversal stacks of depth + 1 entries always fit.
+	const int MEDIAN_SPLIT_DEPTH = MAX_TRAVERSAL_DEPTH - 64;
+
+	inline float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+		glm::vec3 extent = max - min;
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	inline void grow(glm::vec3& min, glm::vec3& max, const glm::vec3& pointMin, const glm::vec3& pointMax) {
+		min = glm::min(min, pointMin);
+		max = glm::max(max, pointMax);
+	}
+
+	enum class Containment
+	{
+		OUTSIDE, INTERSECTING, INSIDE
+	};
+
+	Containment classify(const ME::Frustum& frustum, const float* min, const float* max) {
+		glm::vec3 center((min[0] + max[0]) * .5f, (min[1] + max[1]) * .5f, (min[2] + max[2]) * .5f);
+		glm::vec3 extent((max[0] - min[0]) * .5f, (max[1] - min[1]) * .5f, (max[2] - min[2]) * .5f);
+		Containment result = Containment::INSIDE;
+		for (const glm::vec4& plane : frustum.planes) {
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+			if (distance < -radius)
+				return Containment::OUTSIDE;
+			if (distance < radius)
+				result = Containment::INTERSECTING;
+		}
+		return result;
+	}
+
+	// Entry distance of the ray into the box, FLT_MAX when it misses
+	inline float slab(const glm::vec3& origin, const glm::vec3& inverseDirection, const float* min, const float* max) {
+		float tEnter = 0.f;
+		float tExit = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++) {
+			float t1 = (min[axis] - origin[axis]) * inverseDirection[axis];
+			float t2 = (max[axis] - origin[axis]) * inverseDirection[axis];
+			tEnter = std::max(tEnter, std::min(t1, t2));
+			tExit = std::min(tExit, std::max(t1, t2));
+		}
+		return tEnter <= tExit ? tEnter : FLT_MAX;
+	}
+
+	inline bool overlapsSphere(const glm::vec3& center, float radiusSquared, const float* min, const float* max) {
+		float distanceSquared = 0.f;
+		for (int axis = 0; axis < 3; axis++) {
+			float closest = std::min(std::max(center[axis], min[axis]), max[axis]);
+			float delta = center[axis] - closest;
+			distanceSquared += delta * delta;
+		}
+		return distanceSquared <= radiusSquared;
+	}
+}
+
+ME::AABB ME::AABB::fromTransform(const glm::mat4& model, const glm::vec3& halfExtent) {
+	glm::vec3 center(model[3]);
+	glm::vec3 extent;
+	for (int axis = 0; axis < 3; axis++) {
+		extent[axis] = std::abs(model[0][axis]) * halfExtent.x +
+			std::abs(model[1][axis]) * halfExtent.y +
+			std::abs(model[2][axis]) * halfExtent.z;
+	}
+	return { center - extent, center + extent };
+}
+
+void ME::BVH::updateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& bounds) {
+	Node& node = nodes[nodeIndex];
+	glm::vec3 min(FLT_MAX);
+	glm::vec3 max(-FLT_MAX);
+	for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+		const AABB& box = bounds[objectIndices[i]];
+		grow(min, max, box.min, box.max);
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		node.min[axis] = min[axis];
+		node.max[axis] = max[axis];
+	}
+}
+
+bool ME::BVH::split(uint32_t nodeIndex, const std::vector<AABB>& bounds, bool median) {
+	Node node = nodes[nodeIndex];
+	if (node.count <= MAX_LEAF_SIZE)
+		return false;
+	uint32_t first = node.leftOrFirst;
+	uint32_t last = first + node.count;
+
+	glm::vec3 centroidMin(FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX);
+	for (uint32_t i = first; i < last; i++) {
+		grow(centroidMin, centroidMax, centroids[objectIndices[i]], centroids[objectIndices[i]]);
+	}
+	if (median) {
+		glm::vec3 extent = centroidMax - centroidMin;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		uint32_t half = node.count / 2;
+		std::nth_element(objectIndices.data() + first, objectIndices.data() + first + half, objectIndices.data() + last,
+			[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+		addChildren(nodeIndex, half, bounds);
+		return true;
+	}
+
+	// Binned SAH: cost of a split is count * area summed over both sides
+	struct Bin {
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+		uint32_t count = 0;
+	};
+	int bestAxis = -1;
+	int bestPlane = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.f)
+			continue;
+		Bin bins[SAH_BINS];
+		float scale = SAH_BINS / extent;
+		for (uint32_t i = first; i < last; i++) {
+			uint32_t object = objectIndices[i];
+			int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[object][axis] - centroidMin[axis]) * scale));
+			bins[bin].count++;
+			grow(bins[bin].min, bins[bin].max, bounds[object].min, bounds[object].max);
+		}
+		float leftArea[SAH_BINS - 1];
+		uint32_t leftCount[SAH_BINS - 1];
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		uint32_t count = 0;
+		for (int plane = 0; plane < SAH_BINS - 1; plane++) {
+			count += bins[plane].count;
+			if (bins[plane].count > 0)
+				grow(min, max, bins[plane].min, bins[plane].max);
+			leftCount[plane] = count;
+			leftArea[plane] = count > 0 ? surfaceArea(min, max) : 0.f;
+		}
+		min = glm::vec3(FLT_MAX);
+		max = glm::vec3(-FLT_MAX);
+		count = 0;
+		for (int plane = SAH_BINS - 2; plane >= 0; plane--) {
+			count += bins[plane + 1].count;
+			if (bins[plane + 1].count > 0)
+				grow(min, max, bins[plane + 1].min, bins[plane + 1].max);
+			if (leftCount[plane] == 0 || count == 0)
+				continue;
+			float cost = leftCount[plane] * leftArea[plane] + count * surfaceArea(min, max);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestPlane = plane;
+			}
+		}
+	}
+	// All centroids coincide, nothing to split on
+	if (bestAxis < 0)
+		return false;
+	glm::vec3 nodeMin(node.min[0], node.min[1], node.min[2]);
+	glm::vec3 nodeMax(node.max[0], node.max[1], node.max[2]);
+	float leafCost = node.count * surfaceArea(nodeMin, nodeMax);
+	// Splitting doesn't pay off, but keep leaves small enough to stay cheap
+	if (bestCost >= leafCost && node.count <= 4 * MAX_LEAF_SIZE)
+		return false;
+
+	float scale = SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	uint32_t* middle = std::partition(objectIndices.data() + first, objectIndices.data() + last, [&](uint32_t object) {
+		int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[object][bestAxis] - centroidMin[bestAxis]) * scale));
+		return bin <= bestPlane;
+	});
+	uint32_t leftCount = static_cast<uint32_t>(middle - (objectIndices.data() + first));
+	if (leftCount == 0 || leftCount == node.count)
+		return false;
+	addChildren(nodeIndex, leftCount, bounds);
+	return true;
+}
+
+void ME::BVH::addChildren(uint32_t nodeIndex, uint32_t leftCount, const std::vector<AABB>& bounds) {
+	Node node = nodes[nodeIndex];
+	uint32_t left = static_cast<uint32_t>(nodes.size());
+	Node child = {};
+	child.leftOrFirst = node.leftOrFirst;
+	child.count = leftCount;
+	nodes.push_back(child);
+	child.leftOrFirst = node.leftOrFirst + leftCount;
+	child.count = node.count - leftCount;
+	nodes.push_back(child);
+	updateNodeBounds(left, bounds);
+	updateNodeBounds(left + 1, bounds);
+	nodes[nodeIndex].leftOrFirst = left;
+	nodes[nodeIndex].count = 0;
+}
+
+void ME::BVH::build(const std::vector<AABB>& bounds) {
+	uint32_t objectCount = static_cast<uint32_t>(bounds.size());
+	nodes.clear();
+	objectIndices.resize(objectCount);
+	std::iota(objectIndices.begin(), objectIndices.end(), 0);
+	centroids.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		centroids[i] = (bounds[i].min + bounds[i].max) * .5f;
+	}
+	leafBounds.clear();
+	if (objectCount == 0)
+		return;
+
+	nodes.reserve(2 * static_cast<size_t>(objectCount));
+	Node root = {};
+	root.leftOrFirst = 0;
+	root.count = objectCount;
+	nodes.push_back(root);
+	updateNodeBounds(0, bounds);
+	// Node and its depth
+	std::vector<std::pair<uint32_t, int>> pending;
+	pending.push_back({ 0, 0 });
+	while (!pending.empty()) {
+		uint32_t nodeIndex = pending.back().first;
+		int depth = pending.back().second;
+		pending.pop_back();
+		if (split(nodeIndex, bounds, depth >= MEDIAN_SPLIT_DEPTH)) {
+			pending.push_back({ nodes[nodeIndex].leftOrFirst, depth + 1 });
+			pending.push_back({ nodes[nodeIndex].leftOrFirst + 1, depth + 1 });
+		}
+	}
+
+	leafBounds.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		leafBounds[i] = bounds[objectIndices[i]];
+	}
+}
+
+void ME::BVH::refit(const std::vector<AABB>& bounds) {
+	if (bounds.size() != objectIndices.size()) {
+		build(bounds);
+		return;
+	}
+	for (size_t i = 0; i < objectIndices.size(); i++) {
+		leafBounds[i] = bounds[objectIndices[i]];
+	}
+	// Children always come after their parent
+	for (size_t nodeIndex = nodes.size(); nodeIndex-- > 0;) {
+		Node& node = nodes[nodeIndex];
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		if (node.count > 0) {
+			for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+				grow(min, max, leafBounds[i].min, leafBounds[i].max);
+		}
+		else {
+			for (uint32_t child = node.leftOrFirst; child <= node.leftOrFirst + 1; child++) {
+				const Node& childNode = nodes[child];
+				grow(min, max, glm::vec3(childNode.min[0], childNode.min[1], childNode.min[2]),
+					glm::vec3(childNode.max[0], childNode.max[1], childNode.max[2]));
+			}
+		}
+		for (int axis = 0; axis < 3; axis++) {
+			node.min[axis] = min[axis];
+			node.max[axis] = max[axis];
+		}
+	}
+}
+
+void ME::BVH::collectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& objects) const {
+	uint32_t stack[MAX_TRAVERSAL_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = nodeIndex;
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		if (node.count > 0) {
+			objects.insert(objects.end(), objectIndices.begin() + node.leftOrFirst,
+				objectIndices.begin() + node.leftOrFirst + node.count);
+			continue;
+		}
+		stack[stackSize++] = node.leftOrFirst;
+		stack[stackSize++] = node.leftOrFirst + 1;
+	}
+}
+
+void ME::BVH::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const {
+	objects.clear();
+	if (nodes.empty())
+		return;
+	uint32_t stack[MAX_TRAVERSAL_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		uint32_t nodeIndex = stack[--stackSize];
+		const Node& node = nodes[nodeIndex];
+		Containment containment = classify(frustum, node.min, node.max);
+		if (containment == Containment::OUTSIDE)
+			continue;
+		// Everything below a fully visible node is visible, skip the tests
+		if (containment == Containment::INSIDE) {
+			collectSubtree(nodeIndex, objects);
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				const AABB& box = leafBounds[i];
+				if (classify(frustum, &box.min.x, &box.max.x) != Containment::OUTSIDE)
+					objects.push_back(objectIndices[i]);
+			}
+			continue;
+		}
+		stack[stackSize++] = node.leftOrFirst;
+		stack[stackSize++] = node.leftOrFirst + 1;
+	}
+}
+
+void ME::BVH::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const {
+	objects.clear();
+	if (nodes.empty())
+		return;
+	float radiusSquared = radius * radius;
+	uint32_t stack[MAX_TRAVERSAL_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		if (!overlapsSphere(center, radiusSquared, node.min, node.max))
+			continue;
+		if (node.count > 0) {
+			for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				if (overlapsSphere(center, radiusSquared, &leafBounds[i].min.x, &leafBounds[i].max.x))
+					objects.push_back(objectIndices[i]);
+			}
+			continue;
+		}
+		stack[stackSize++] = node.leftOrFirst;
+		stack[stackSize++] = node.leftOrFirst + 1;
+	}
+}
+
+bool ME::BVH::raycast(const Ray& ray, float maxDistance, RayHit& hit) const {
+	if (nodes.empty())
+		return false;
+	glm::vec3 inverseDirection(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z);
+	float closest = maxDistance;
+	bool found = false;
+	uint32_t stack[MAX_TRAVERSAL_DEPTH];
+	int stackSize = 0;
+	if (slab(ray.origin, inverseDirection, nodes[0].min, nodes[0].max) < closest)
+		stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		// The entry distance may have been beaten since this node was pushed
+		if (slab(ray.origin, inverseDirection, node.min, node.max) >= closest)
+			continue;
+		if (node.count > 0) {
+			for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				float distance = slab(ray.origin, inverseDirection, &leafBounds[i].min.x, &leafBounds[i].max.x);
+				if (distance < closest) {
+					closest = distance;
+					hit.object = objectIndices[i];
+					hit.distance = distance;
+					found = true;
+				}
+			}
+			continue;
+		}
+		// Visit the nearer child first
+		uint32_t nearChild = node.leftOrFirst;
+		uint32_t farChild = node.leftOrFirst + 1;
+		float nearChildDistance = slab(ray.origin, inverseDirection, nodes[nearChild].min, nodes[nearChild].max);
+		float farChildDistance = slab(ray.origin, inverseDirection, nodes[farChild].min, nodes[farChild].max);
+		if (farChildDistance < nearChildDistance) {
+			std::swap(nearChild, farChild);
+			std::swap(nearChildDistance, farChildDistance);
+		}
+		if (farChildDistance < closest)
+			stack[stackSize++] = farChild;
+		if (nearChildDistance < closest)
+			stack[stackSize++] = nearChild;
+	}
+	return found;
+}
+
+size_t ME::BVH::getNodeCount() const {
+	return nodes.size();
+}
+
+size_t ME::BVH::getObjectCount() const {
+	return objectIndices.size();
+}
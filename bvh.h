@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.h"
+
+namespace ME {
+	struct AABB {
+		glm::vec3 min;
+		glm::vec3 max;
+		// Box around a transformed unit-centred box with the given half extent
+		static AABB fromTransform(const glm::mat4& model, const glm::vec3& halfExtent);
+	};
+
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+
+	struct RayHit {
+		uint32_t object;
+		float distance;
+	};
+
+	// Bounding volume hierarchy over object AABBs, built with the binned surface
+	// area heuristic. Nodes are 32 bytes, siblings are stored next to each other
+	// and always after their parent, so a refit is one reverse sweep.
+	class BVH {
+	public:
+		static const uint32_t MAX_LEAF_SIZE = 4;
+		static const int SAH_BINS = 16;
+		struct Node {
+			float min[3];
+			// First object if count > 0, otherwise the left child (right is +1)
+			uint32_t leftOrFirst;
+			float max[3];
+			uint32_t count;
+		};
+	public:
+		void build(const std::vector<AABB>& bounds);
+		// Updates node bounds after objects moved, keeping the topology. Faster
+		// than a rebuild, but the tree degrades if objects travel far.
+		void refit(const std::vector<AABB>& bounds);
+		void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const;
+		// Closest object whose box the ray enters within maxDistance
+		bool raycast(const Ray& ray, float maxDistance, RayHit& hit) const;
+		size_t getNodeCount() const;
+		size_t getObjectCount() const;
+	private:
+		void updateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& bounds);
+		// Binned SAH, or halves the node at the centroid median when median is set
+		bool split(uint32_t nodeIndex, const std::vector<AABB>& bounds, bool median);
+		// Turns the node into an inner node over its first leftCount objects and the rest
+		void addChildren(uint32_t nodeIndex, uint32_t leftCount, const std::vector<AABB>& bounds);
+		void collectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& objects) const;
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> objectIndices;
+		// Object boxes in leaf order, so leaf tests walk memory linearly
+		std::vector<AABB> leafBounds;
+		std::vector<glm::vec3> centroids;
+	};
+}
@@ -0,0 +1,100 @@
+﻿#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "bvh.h"
+
+// Build, refit and query timings for ME::BVH on random scenes
+namespace {
+	double millisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::vector<ME::AABB> randomBoxes(size_t count, float worldSize, std::mt19937& random) {
+		std::uniform_real_distribution<float> position(-worldSize, worldSize);
+		std::uniform_real_distribution<float> size(.25f, 1.f);
+		std::vector<ME::AABB> boxes(count);
+		for (ME::AABB& box : boxes) {
+			glm::vec3 center(position(random), position(random), position(random));
+			glm::vec3 halfExtent(size(random), size(random), size(random));
+			box = { center - halfExtent, center + halfExtent };
+		}
+		return boxes;
+	}
+
+	void benchmark(size_t objectCount) {
+		std::mt19937 random(42);
+		float worldSize = std::cbrt(static_cast<float>(objectCount)) * 4.f;
+		std::vector<ME::AABB> boxes = randomBoxes(objectCount, worldSize, random);
+		ME::BVH bvh;
+
+		auto start = std::chrono::steady_clock::now();
+		bvh.build(boxes);
+		double buildTime = millisecondsSince(start);
+
+		std::uniform_real_distribution<float> jitter(-.1f, .1f);
+		for (ME::AABB& box : boxes) {
+			glm::vec3 offset(jitter(random), jitter(random), jitter(random));
+			box.min += offset;
+			box.max += offset;
+		}
+		start = std::chrono::steady_clock::now();
+		bvh.refit(boxes);
+		double refitTime = millisecondsSince(start);
+
+		std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+		std::vector<uint32_t> results;
+		results.reserve(objectCount);
+		const int frustumQueries = 100;
+		size_t frustumHits = 0;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frustumQueries; i++) {
+			float yaw = angle(random);
+			glm::vec3 front(std::cos(yaw), 0.f, std::sin(yaw));
+			glm::mat4 viewProjection = glm::perspective(glm::radians(78.f), 16.f / 9.f, .01f, 100.f) *
+				glm::lookAt(glm::vec3(0.f), front, glm::vec3(0.f, 1.f, 0.f));
+			bvh.queryFrustum(ME::Frustum::fromMatrix(viewProjection), results);
+			frustumHits += results.size();
+		}
+		double frustumTime = millisecondsSince(start);
+
+		const int rayQueries = 100000;
+		size_t rayHits = 0;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < rayQueries; i++) {
+			float yaw = angle(random);
+			float pitch = angle(random);
+			ME::Ray ray = { glm::vec3(0.f), glm::vec3(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch)) };
+			ME::RayHit hit;
+			rayHits += bvh.raycast(ray, 1e30f, hit) ? 1 : 0;
+		}
+		double rayTime = millisecondsSince(start);
+
+		std::uniform_real_distribution<float> position(-worldSize, worldSize);
+		const int sphereQueries = 100000;
+		size_t sphereHits = 0;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < sphereQueries; i++) {
+			bvh.querySphere(glm::vec3(position(random), position(random), position(random)), 5.f, results);
+			sphereHits += results.size();
+		}
+		double sphereTime = millisecondsSince(start);
+
+		std::printf("%zu objects, %zu nodes\n", objectCount, bvh.getNodeCount());
+		std::printf("  build   %10.2f ms\n", buildTime);
+		std::printf("  refit   %10.2f ms\n", refitTime);
+		std::printf("  frustum %10.0f queries/s (%zu objects per query)\n", frustumQueries / frustumTime * 1000., frustumHits / frustumQueries);
+		std::printf("  ray     %10.0f queries/s (%zu hits)\n", rayQueries / rayTime * 1000., rayHits);
+		std::printf("  sphere  %10.0f queries/s (%zu objects per query)\n", sphereQueries / sphereTime * 1000., sphereHits / sphereQueries);
+	}
+}
+
+int main() {
+	benchmark(100000);
+	benchmark(1000000);
+	return 0;
+}
@@ -1,11 +1,40 @@
 ﻿#include "camera.h"
 
+#include <atomic>
+#include <cmath>
+
+namespace {
+	// Shared by every camera, so no two states ever carry the same version
+	std::atomic<uint64_t> nextVersion(1);
+}
+
 const float ME::Camera::MIN_V_FOV = 1;
 const float ME::Camera::MAX_V_FOV = 78;
 const float ME::Camera::DEFAULT_MOVEMENT_SPEED = 10;
 const float ME::Camera::DEFAULT_MOUSE_SENSITIVITY = 1;
 const float ME::Camera::MOUSE_SENSITIVITY_SCALING = 0.05;
 const float ME::Camera::DEFAULT_ZOOM_SENSITIVITY = 5;
+const float ME::Camera::NEAR_PLANE = .01f;
+const float ME::Camera::FAR_PLANE = 100.0f;
+
+ME::Frustum ME::Frustum::fromMatrix(const glm::mat4& m) {
+	// Gribb/Hartmann: combine the rows of the clip matrix
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	Frustum frustum;
+	frustum.planes[LEFT] = row3 + row0;
+	frustum.planes[RIGHT] = row3 - row0;
+	frustum.planes[BOTTOM] = row3 + row1;
+	frustum.planes[TOP] = row3 - row1;
+	frustum.planes[ZNEAR] = row3 + row2;
+	frustum.planes[ZFAR] = row3 - row2;
+	for (glm::vec4& plane : frustum.planes) {
+		plane = plane / glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
 
 ME::Camera::Camera() {
 	v_fov = MAX_V_FOV;
@@ -14,13 +43,37 @@ ME::Camera::Camera() {
 	up = glm::vec3(0, 1.0f, 0);
 	yaw = -90;
 	pitch = 0;
+	turned = false;
 	movementSpeed = DEFAULT_MOVEMENT_SPEED;
 	mouseSensitivity = DEFAULT_MOUSE_SENSITIVITY * MOUSE_SENSITIVITY_SCALING;
 	zoomSensitivity = DEFAULT_ZOOM_SENSITIVITY;
+	// Until the owner tells it otherwise
+	viewportWidth = 1920;
+	viewportHeight = 1080;
+	version = nextVersion++;
+	viewDirty = true;
+	projectionDirty = true;
+	combinedDirty = true;
+	inverseDirty = true;
+}
+
+void ME::Camera::viewChanged() {
+	version = nextVersion++;
+	viewDirty = true;
+	combinedDirty = true;
 }
-void ME::Camera::processMouseMovement(double xOffset, double yOffset) {
 
+void ME::Camera::projectionChanged() {
+	version = nextVersion++;
+	projectionDirty = true;
+	combinedDirty = true;
+}
+void ME::Camera::processMouseMovement(double xOffset, double yOffset) {
+	accumulateMouseMovement(xOffset, yOffset);
+	applyMouseMovement();
+}
 
+void ME::Camera::accumulateMouseMovement(double xOffset, double yOffset) {
 	xOffset *= mouseSensitivity;
 	yOffset *= mouseSensitivity;
 
@@ -31,23 +84,43 @@ void ME::Camera::processMouseMovement(double xOffset, double yOffset) {
 		pitch = 89.0f;
 	if (pitch < -89.0f)
 		pitch = -89.0f;
+	turned = true;
+}
 
+void ME::Camera::applyMouseMovement() {
+	if (!turned)
+		return;
+	turned = false;
 	glm::vec3 direction;
 	direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
 	direction.y = sin(glm::radians(pitch));
 	direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
 	front = glm::normalize(direction);
+	viewChanged();
 }
 
 void ME::Camera::setMovementSpeed(float speed) {
 	movementSpeed = speed;
 }
+ME::Camera ME::Camera::interpolate(const Camera& previous, const Camera& current, float alpha) {
+	Camera camera = current;
+	camera.pos = glm::mix(previous.pos, current.pos, alpha);
+	glm::vec3 front = glm::mix(previous.front, current.front, alpha);
+	// Opposite directions have no halfway, keep the newer one
+	if (glm::dot(front, front) > 1e-6f)
+		camera.front = glm::normalize(front);
+	camera.v_fov = glm::mix(previous.v_fov, current.v_fov, alpha);
+	camera.viewChanged();
+	camera.projectionChanged();
+	return camera;
+}
 void ME::Camera::processZooming(double yOffset) {
 	v_fov -= (float)yOffset * zoomSensitivity;
 	if (v_fov < MIN_V_FOV)
 		v_fov = MIN_V_FOV;
 	if (v_fov > MAX_V_FOV)
 		v_fov = MAX_V_FOV;
+	projectionChanged();
 }
 
 void ME::Camera::processCameraMovement(Direction direction, float deltaTime) {
@@ -72,13 +145,93 @@ void ME::Camera::processCameraMovement(Direction direction, float deltaTime) {
 		pos -= glm::normalize(glm::cross(up, front)) * movementSpeed * deltaTime;
 		break;
 	default:
-		break;
+		return;
+	}
+	viewChanged();
+}
+
+void ME::Camera::setViewport(int width, int height) {
+	if (width == viewportWidth && height == viewportHeight)
+		return;
+	viewportWidth = width;
+	viewportHeight = height;
+	projectionChanged();
+}
+
+int ME::Camera::getViewportWidth() const {
+	return viewportWidth;
+}
+
+int ME::Camera::getViewportHeight() const {
+	return viewportHeight;
+}
+
+void ME::Camera::setPosition(const glm::vec3& position) {
+	pos = position;
+	viewChanged();
+}
+
+void ME::Camera::setFront(const glm::vec3& direction) {
+	front = glm::normalize(direction);
+	yaw = glm::degrees(std::atan2(front.z, front.x));
+	pitch = glm::degrees(std::asin(glm::clamp(front.y, -1.0f, 1.0f)));
+	turned = false;
+	viewChanged();
+}
+
+const glm::vec3& ME::Camera::getPosition() const {
+	return pos;
+}
+
+const glm::vec3& ME::Camera::getFront() const {
+	return front;
+}
+
+uint64_t ME::Camera::getVersion() const {
+	return version;
+}
+
+const glm::mat4& ME::Camera::getViewMatrix() const {
+	if (viewDirty) {
+		view = glm::lookAt(pos, pos + front, up);
+		viewDirty = false;
+	}
+	return view;
+}
+
+const glm::mat4& ME::Camera::getProjectionMatrix() const {
+	if (projectionDirty) {
+		projection = glm::perspective(glm::radians(v_fov), static_cast<float>(viewportWidth) / viewportHeight, NEAR_PLANE, FAR_PLANE);
+		projectionDirty = false;
+	}
+	return projection;
+}
+
+void ME::Camera::updateCombined() const {
+	if (!combinedDirty)
+		return;
+	viewProjection = getProjectionMatrix() * getViewMatrix();
+	frustum = Frustum::fromMatrix(viewProjection);
+	combinedDirty = false;
+	inverseDirty = true;
+}
+
+const glm::mat4& ME::Camera::getViewProjectionMatrix() const {
+	updateCombined();
+	return viewProjection;
+}
+
+const glm::mat4& ME::Camera::getInverseViewProjectionMatrix() const {
+	updateCombined();
+	// Rarely needed, so only inverted on request
+	if (inverseDirty) {
+		inverseViewProjection = glm::inverse(viewProjection);
+		inverseDirty = false;
 	}
+	return inverseViewProjection;
 }
 
-glm::mat4 ME::Camera::getViewMatrix() const {
-	return glm::lookAt(pos, pos + front, up);
+const ME::Frustum& ME::Camera::getFrustum() const {
+	updateCombined();
+	return frustum;
 }
-glm::mat4 ME::Camera::getProjectionMatrix(const float& screenWidth, const float& screenHeight) const {
-	return glm::perspective(glm::radians(v_fov), static_cast<float>(screenWidth) / screenHeight, .01f, 100.0f);
-}
\ No newline at end of file
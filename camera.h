@@ -4,7 +4,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
+
 namespace ME {
+	// Plane i is (normal, d) with the normal pointing inwards, so a point p is
+	// inside when dot(normal, p) + d >= 0 for all six planes.
+	struct Frustum {
+		enum Plane
+		{
+			LEFT, RIGHT, BOTTOM, TOP, ZNEAR, ZFAR
+		};
+		glm::vec4 planes[6];
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+	};
+
+	// Caches its matrices and frustum behind dirty flags, so asking for them
+	// again is free until the camera moves, zooms or the viewport changes.
+	// The caches are filled lazily from const getters, so a camera must not
+	// be read from several threads at once.
 	class Camera {
 	private:
 		static const float MIN_V_FOV;
@@ -13,6 +30,9 @@ namespace ME {
 		static const float DEFAULT_MOUSE_SENSITIVITY;
 		static const float MOUSE_SENSITIVITY_SCALING;
 		static const float DEFAULT_ZOOM_SENSITIVITY;
+	public:
+		static const float NEAR_PLANE;
+		static const float FAR_PLANE;
 	public:
 		enum class Direction
 		{
@@ -20,21 +40,60 @@ namespace ME {
 		};
 	public:
 		Camera();
-		glm::mat4 getViewMatrix() const;
-		glm::mat4 getProjectionMatrix(const float& screenWidth, const float& screenHeight) const;
+		const glm::mat4& getViewMatrix() const;
+		const glm::mat4& getProjectionMatrix() const;
+		const glm::mat4& getViewProjectionMatrix() const;
+		const glm::mat4& getInverseViewProjectionMatrix() const;
+		const Frustum& getFrustum() const;
 		void processMouseMovement(double xOffset, double yOffset);
+		// Turns like processMouseMovement, but the front vector is only rebuilt
+		// by applyMouseMovement. A burst of events then costs one trig update
+		// and ends up exactly where processing them one by one would.
+		void accumulateMouseMovement(double xOffset, double yOffset);
+		void applyMouseMovement();
 		void processCameraMovement(Direction direction, float deltaTime);
 		void processZooming(double yOffset);
 		void setMovementSpeed(float speed);
+		void setViewport(int width, int height);
+		int getViewportWidth() const;
+		int getViewportHeight() const;
+		void setPosition(const glm::vec3& position);
+		// Also turns yaw and pitch to match, so the mouse carries on from there
+		void setFront(const glm::vec3& direction);
+		const glm::vec3& getPosition() const;
+		const glm::vec3& getFront() const;
+		// Changes whenever anything that affects the matrices does. Versions
+		// are unique across all cameras, so equal versions mean equal matrices.
+		uint64_t getVersion() const;
+		// Camera part way from previous to current, for rendering between fixed updates
+		static Camera interpolate(const Camera& previous, const Camera& current, float alpha);
+	private:
+		void viewChanged();
+		void projectionChanged();
+		void updateCombined() const;
+
 		glm::vec3 pos;
 		glm::vec3 front;
-	private:
 		float yaw;
 		float pitch;
+		// Yaw and pitch changed since front was last rebuilt
+		bool turned;
 		glm::vec3 up;
 		float v_fov;
 		float movementSpeed;
 		float mouseSensitivity;
 		float zoomSensitivity;
+		int viewportWidth;
+		int viewportHeight;
+		uint64_t version;
+		mutable bool viewDirty;
+		mutable bool projectionDirty;
+		mutable bool combinedDirty;
+		mutable bool inverseDirty;
+		mutable glm::mat4 view;
+		mutable glm::mat4 projection;
+		mutable glm::mat4 viewProjection;
+		mutable glm::mat4 inverseViewProjection;
+		mutable Frustum frustum;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+﻿#include "culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ME_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ME_CULLING_SSE
+#endif
+
+namespace {
+#if defined(ME_CULLING_AVX)
+	struct Lanes {
+		static const int WIDTH = 8;
+		typedef __m256 Float;
+		static Float load(const float* p) { return _mm256_loadu_ps(p); }
+		static Float set(float value) { return _mm256_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float negate(Float a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+		static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+		static Float greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static Float both(Float a, Float b) { return _mm256_and_ps(a, b); }
+		static int mask(Float a) { return _mm256_movemask_ps(a); }
+	};
+#elif defined(ME_CULLING_SSE)
+	struct Lanes {
+		static const int WIDTH = 4;
+		typedef __m128 Float;
+		static Float load(const float* p) { return _mm_loadu_ps(p); }
+		static Float set(float value) { return _mm_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float negate(Float a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+		static Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+		static Float greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+		static Float both(Float a, Float b) { return _mm_and_ps(a, b); }
+		static int mask(Float a) { return _mm_movemask_ps(a); }
+	};
+#endif
+
+	inline float planeDistance(const glm::vec4& plane, float x, float y, float z) {
+		return plane.x * x + plane.y * y + plane.z * z + plane.w;
+	}
+
+	uint32_t cullSpheres(const ME::Frustum& frustum, const ME::BoundingSpheres& spheres,
+		size_t begin, size_t end, uint32_t* out) {
+		uint32_t visibleCount = 0;
+		size_t i = begin;
+#if defined(ME_CULLING_AVX) || defined(ME_CULLING_SSE)
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			Lanes::Float x = Lanes::load(&spheres.x[i]);
+			Lanes::Float y = Lanes::load(&spheres.y[i]);
+			Lanes::Float z = Lanes::load(&spheres.z[i]);
+			Lanes::Float negativeRadius = Lanes::negate(Lanes::load(&spheres.radius[i]));
+			Lanes::Float inside = Lanes::greater(Lanes::set(1.f), Lanes::set(0.f));
+			for (const glm::vec4& plane : frustum.planes) {
+				Lanes::Float distance = Lanes::add(
+					Lanes::add(Lanes::mul(x, Lanes::set(plane.x)), Lanes::mul(y, Lanes::set(plane.y))),
+					Lanes::add(Lanes::mul(z, Lanes::set(plane.z)), Lanes::set(plane.w)));
+				inside = Lanes::both(inside, Lanes::greater(distance, negativeRadius));
+			}
+			int mask = Lanes::mask(inside);
+			// Branch-free compaction of the visible lanes
+			for (int lane = 0; lane < Lanes::WIDTH; lane++) {
+				out[visibleCount] = static_cast<uint32_t>(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+#endif
+		for (; i < end; i++) {
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				inside &= planeDistance(plane, spheres.x[i], spheres.y[i], spheres.z[i]) > -spheres.radius[i];
+			}
+			out[visibleCount] = static_cast<uint32_t>(i);
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+
+	uint32_t cullBoxes(const ME::Frustum& frustum, const ME::BoundingBoxes& boxes,
+		size_t begin, size_t end, uint32_t* out) {
+		uint32_t visibleCount = 0;
+		size_t i = begin;
+#if defined(ME_CULLING_AVX) || defined(ME_CULLING_SSE)
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			Lanes::Float x = Lanes::load(&boxes.centerX[i]);
+			Lanes::Float y = Lanes::load(&boxes.centerY[i]);
+			Lanes::Float z = Lanes::load(&boxes.centerZ[i]);
+			Lanes::Float extentX = Lanes::load(&boxes.extentX[i]);
+			Lanes::Float extentY = Lanes::load(&boxes.extentY[i]);
+			Lanes::Float extentZ = Lanes::load(&boxes.extentZ[i]);
+			Lanes::Float inside = Lanes::greater(Lanes::set(1.f), Lanes::set(0.f));
+			for (const glm::vec4& plane : frustum.planes) {
+				Lanes::Float distance = Lanes::add(
+					Lanes::add(Lanes::mul(x, Lanes::set(plane.x)), Lanes::mul(y, Lanes::set(plane.y))),
+					Lanes::add(Lanes::mul(z, Lanes::set(plane.z)), Lanes::set(plane.w)));
+				// Projected radius of the box onto the plane normal
+				Lanes::Float radius = Lanes::add(
+					Lanes::add(Lanes::mul(extentX, Lanes::set(std::abs(plane.x))), Lanes::mul(extentY, Lanes::set(std::abs(plane.y)))),
+					Lanes::mul(extentZ, Lanes::set(std::abs(plane.z))));
+				inside = Lanes::both(inside, Lanes::greater(distance, Lanes::negate(radius)));
+			}
+			int mask = Lanes::mask(inside);
+			for (int lane = 0; lane < Lanes::WIDTH; lane++) {
+				out[visibleCount] = static_cast<uint32_t>(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+#endif
+		for (; i < end; i++) {
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				float radius = boxes.extentX[i] * std::abs(plane.x) + boxes.extentY[i] * std::abs(plane.y) +
+					boxes.extentZ[i] * std::abs(plane.z);
+				inside &= planeDistance(plane, boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]) > -radius;
+			}
+			out[visibleCount] = static_cast<uint32_t>(i);
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+}
+
+void ME::BoundingSpheres::clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+void ME::BoundingSpheres::reserve(size_t capacity) {
+	x.reserve(capacity);
+	y.reserve(capacity);
+	z.reserve(capacity);
+	radius.reserve(capacity);
+}
+
+uint32_t ME::BoundingSpheres::add(const glm::vec3& center, float sphereRadius) {
+	x.push_back(center.x);
+	y.push_back(center.y);
+	z.push_back(center.z);
+	radius.push_back(sphereRadius);
+	return static_cast<uint32_t>(x.size() - 1);
+}
+
+void ME::BoundingSpheres::set(uint32_t index, const glm::vec3& center, float sphereRadius) {
+	x[index] = center.x;
+	y[index] = center.y;
+	z[index] = center.z;
+	radius[index] = sphereRadius;
+}
+
+size_t ME::BoundingSpheres::size() const {
+	return x.size();
+}
+
+void ME::BoundingBoxes::clear() {
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void ME::BoundingBoxes::reserve(size_t capacity) {
+	centerX.reserve(capacity);
+	centerY.reserve(capacity);
+	centerZ.reserve(capacity);
+	extentX.reserve(capacity);
+	extentY.reserve(capacity);
+	extentZ.reserve(capacity);
+}
+
+uint32_t ME::BoundingBoxes::add(const glm::vec3& min, const glm::vec3& max) {
+	centerX.push_back(0);
+	centerY.push_back(0);
+	centerZ.push_back(0);
+	extentX.push_back(0);
+	extentY.push_back(0);
+	extentZ.push_back(0);
+	uint32_t index = static_cast<uint32_t>(centerX.size() - 1);
+	set(index, min, max);
+	return index;
+}
+
+void ME::BoundingBoxes::set(uint32_t index, const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 center = (min + max) * .5f;
+	glm::vec3 extent = (max - min) * .5f;
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+}
+
+size_t ME::BoundingBoxes::size() const {
+	return centerX.size();
+}
+
+const char* ME::FrustumCuller::getInstructionSet() {
+#if defined(ME_CULLING_AVX)
+	return "AVX";
+#elif defined(ME_CULLING_SSE)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+ME::FrustumCuller::FrustumCuller(ThreadPool* pool) : pool(pool) {
+}
+
+template <typename TestRange>
+size_t ME::FrustumCuller::run(size_t count, uint32_t* out, const TestRange& testRange) {
+	auto start = std::chrono::steady_clock::now();
+	// Every chunk writes its visible indices at its own offset, then the
+	// chunks are packed together in order
+	size_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	chunkVisibleCounts.resize(chunkCount);
+	auto job = [&](size_t begin, size_t end) {
+		chunkVisibleCounts[begin / CHUNK_SIZE] = testRange(begin, end, out + begin);
+	};
+	if (pool != nullptr) {
+		pool->parallelFor(count, CHUNK_SIZE, job);
+	}
+	else {
+		for (size_t begin = 0; begin < count; begin += CHUNK_SIZE)
+			job(begin, std::min(begin + CHUNK_SIZE, count));
+	}
+	size_t visibleCount = 0;
+	for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+		uint32_t chunkVisible = chunkVisibleCounts[chunk];
+		if (visibleCount != chunk * CHUNK_SIZE)
+			std::memmove(out + visibleCount, out + chunk * CHUNK_SIZE, chunkVisible * sizeof(uint32_t));
+		visibleCount += chunkVisible;
+	}
+
+	stats.tested = static_cast<unsigned int>(count);
+	stats.visible = static_cast<unsigned int>(visibleCount);
+	stats.culled = static_cast<unsigned int>(count - visibleCount);
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return visibleCount;
+}
+
+size_t ME::FrustumCuller::cull(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible) {
+	return run(spheres.size(), visible, [&](size_t begin, size_t end, uint32_t* out) {
+		return cullSpheres(frustum, spheres, begin, end, out);
+	});
+}
+
+size_t ME::FrustumCuller::cull(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible) {
+	return run(boxes.size(), visible, [&](size_t begin, size_t end, uint32_t* out) {
+		return cullBoxes(frustum, boxes, begin, end, out);
+	});
+}
+
+void ME::FrustumCuller::cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible) {
+	visible.resize(spheres.size());
+	visible.resize(cull(frustum, spheres, visible.data()));
+}
+
+void ME::FrustumCuller::cull(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible) {
+	visible.resize(boxes.size());
+	visible.resize(cull(frustum, boxes, visible.data()));
+}
+
+const ME::FrustumCuller::Stats& ME::FrustumCuller::getStats() const {
+	return stats;
+}
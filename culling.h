@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.h"
+#include "threadPool.h"
+
+namespace ME {
+	// Bounding spheres stored structure-of-arrays so the culler can test a
+	// whole SIMD register of them against a plane at once
+	class BoundingSpheres {
+	public:
+		void clear();
+		void reserve(size_t capacity);
+		uint32_t add(const glm::vec3& center, float radius);
+		void set(uint32_t index, const glm::vec3& center, float radius);
+		size_t size() const;
+
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+	};
+
+	// Axis-aligned boxes as center and half extent, same layout as above
+	class BoundingBoxes {
+	public:
+		void clear();
+		void reserve(size_t capacity);
+		uint32_t add(const glm::vec3& min, const glm::vec3& max);
+		void set(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+		size_t size() const;
+
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+	};
+
+	class FrustumCuller {
+	public:
+		// Number of objects handed to one worker at a time
+		static const size_t CHUNK_SIZE = 4096;
+		struct Stats {
+			unsigned int tested = 0;
+			unsigned int visible = 0;
+			unsigned int culled = 0;
+			double milliseconds = 0;
+		};
+		// Name of the instruction set the culler was compiled for
+		static const char* getInstructionSet();
+	public:
+		explicit FrustumCuller(ThreadPool* pool = nullptr);
+		// Fills visible with the indices of the objects intersecting the frustum,
+		// in ascending order
+		void cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible);
+		void cull(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible);
+		// Same into caller memory with room for every object, e.g. from a
+		// FrameArena. Returns how many indices were written.
+		size_t cull(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible);
+		size_t cull(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible);
+		const Stats& getStats() const;
+	private:
+		template <typename TestRange>
+		size_t run(size_t count, uint32_t* out, const TestRange& testRange);
+
+		ThreadPool* pool;
+		std::vector<uint32_t> chunkVisibleCounts;
+		Stats stats;
+	};
+}
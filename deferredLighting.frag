@@ -0,0 +1,136 @@
+﻿#version 330 core
+
+// Lighting pass of the deferred path. Lights every pixel of the G-buffer
+// once, with the same flashlight and clustered lights as lighting.frag.
+struct Material {
+    float shininess;
+};
+
+struct Light {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+// The frame fills this corner of the G-buffer, which is sized to the output
+uniform vec2 frameSize;
+// Back from depth to world space
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+
+uniform Material material;
+uniform Light light;
+uniform vec3 viewPos;
+
+// Clustered lights, see LightClusters and lighting.frag
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLights;
+uniform vec2 clusterScreenScale;
+uniform vec2 clusterDepthScale;
+
+// Spot light shadows, see ShadowAtlas and lighting.frag
+const float SHADOW_NORMAL_OFFSET = 0.02;
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 shadowMatrices[16];
+uniform int flashlightShadow;
+
+out vec4 fragColor;
+
+float shadow(int tile, vec3 fragPos, vec3 norm)
+{
+    if (tile < 0)
+        return 1.0;
+    // Pushed off the surface along the normal against acne on steep slopes
+    vec4 atlasPos = shadowMatrices[tile] * vec4(fragPos + norm * SHADOW_NORMAL_OFFSET, 1.0);
+    // Behind the light or past its range, the cone or window is zero there anyway
+    if (atlasPos.w <= 0.0 || atlasPos.z > atlasPos.w)
+        return 1.0;
+    return textureProj(shadowAtlas, atlasPos);
+}
+
+vec3 clusteredLights(vec3 fragPos, float viewDepth, vec3 norm, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScreenScale), CLUSTER_GRID.xy - 1);
+    int slice = clamp(int(log(viewDepth) * clusterDepthScale.x + clusterDepthScale.y), 0, CLUSTER_GRID.z - 1);
+    int cluster = tile.x + CLUSTER_GRID.x * (tile.y + CLUSTER_GRID.y * slice);
+    uvec2 range = texelFetch(clusterRanges, cluster).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int first = int(texelFetch(clusterLights, int(range.x + i)).x) * 4;
+        vec4 positionRange = texelFetch(lightData, first);
+        vec4 colorCutOff = texelFetch(lightData, first + 1);
+        vec4 directionOuterCutOff = texelFetch(lightData, first + 2);
+        int shadowTile = int(texelFetch(lightData, first + 3).x);
+        vec3 toLight = positionRange.xyz - fragPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / dist;
+        float window = clamp(1.0 - pow(dist / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+        float theta = dot(lightDir, -directionOuterCutOff.xyz);
+        float cone = clamp((theta - directionOuterCutOff.w) / (colorCutOff.w - directionOuterCutOff.w), 0.0, 1.0);
+        float diff = max(dot(norm, lightDir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), material.shininess);
+        float lit = attenuation * cone;
+        if (shadowTile >= 0 && lit > 0.0)
+            lit *= shadow(shadowTile, fragPos, norm);
+        result += colorCutOff.rgb * (diff * diffuseColor + spec * specularColor) * lit;
+    }
+    return result;
+}
+
+void main()
+{
+    // The depth test already dropped the pixels nothing was drawn on
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec2 ndc = gl_FragCoord.xy / frameSize * 2.0 - 1.0;
+    vec4 viewPosition = inverseProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    viewPosition /= viewPosition.w;
+    vec3 fragPos = vec3(inverseView * viewPosition);
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec3 diffuseColor = albedoSpecular.rgb;
+    vec3 specularColor = vec3(albedoSpecular.a);
+    vec3 norm = normalize(texelFetch(gNormal, pixel, 0).xyz * 2.0 - 1.0);
+
+    // Ambient
+    vec3 ambient = light.ambient * diffuseColor;
+    // Diffuse
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    // Specular
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specular = light.specular * spec * specularColor;
+    // spotlight (soft edges)
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = (light.cutOff - light.outerCutOff);
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0) * shadow(flashlightShadow, fragPos, norm);
+    diffuse *= intensity;
+    specular *= intensity;
+    // attenuation
+    float dist = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * (dist * dist));
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    // result
+    vec3 result = ambient + diffuse + specular;
+    result += clusteredLights(fragPos, -viewPosition.z, norm, viewDir, diffuseColor, specularColor);
+    fragColor = vec4(result, 1.0);
+}
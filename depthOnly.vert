@@ -0,0 +1,17 @@
+﻿#version 330 core
+layout(location = 0) in vec3 aPos;
+// Per-draw model matrix, selected by the draw's base instance
+layout(location = 3) in mat4 aModel;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// The lighting pass tests against this depth with GL_EQUAL, so the position
+// is computed exactly as lightingInstanced.vert does
+invariant gl_Position;
+
+void main()
+{
+    vec4 viewPos = view * aModel * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+}
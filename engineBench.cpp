@@ -0,0 +1,571 @@
+﻿#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchHarness.h"
+#include "bvh.h"
+#include "camera.h"
+#include "headless.h"
+#include "occlusionCuller.h"
+#include "shader.h"
+#include "simd.h"
+#include "stb_image.h"
+#include "util.h"
+#include "vertices.h"
+
+// Microbenchmarks for the engine's hot paths. Run from the asset directory,
+// the GL ones need a build with ME_HEADLESS_EGL.
+namespace {
+	const char* VERTEX_SHADER = "lightingInstanced.vert";
+	const char* FRAGMENT_SHADER = "lighting.frag";
+	const char* IMAGE = "container2.png";
+
+	std::string readFile(const char* path) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+
+	void printUsage() {
+		std::printf("Usage: bench [--filter TEXT] [--out bench.json] [--compare baseline.json]\n"
+			"             [--label TEXT] [--seconds S]\n"
+			"--label is stored with the results, e.g. the commit they were run on\n");
+	}
+
+	void benchCamera(ME::BenchRunner& runner) {
+		ME::Camera camera;
+		camera.setViewport(1920, 1080);
+		runner.run("camera/view matrix", [&]() {
+			glm::mat4 view = camera.getViewMatrix();
+			ME::doNotOptimize(view);
+		});
+		// Turning dirties the view, so the matrix is rebuilt
+		double direction = 1;
+		runner.run("camera/view matrix after turning", [&]() {
+			camera.processMouseMovement(direction, 0);
+			direction = -direction;
+			glm::mat4 view = camera.getViewMatrix();
+			ME::doNotOptimize(view);
+		});
+		// A frame's worth of events from a high rate mouse
+		const int events = 40;
+		runner.run("camera/40 mouse events one by one", [&]() {
+			for (int i = 0; i < events; i++)
+				camera.processMouseMovement(direction * .1, .05);
+			direction = -direction;
+			ME::doNotOptimize(camera.getFront());
+		});
+		runner.run("camera/40 mouse events coalesced", [&]() {
+			for (int i = 0; i < events; i++)
+				camera.accumulateMouseMovement(direction * .1, .05);
+			camera.applyMouseMovement();
+			direction = -direction;
+			ME::doNotOptimize(camera.getFront());
+		});
+		runner.run("camera/projection matrix", [&]() {
+			glm::mat4 projection = camera.getProjectionMatrix();
+			ME::doNotOptimize(projection);
+		});
+		runner.run("camera/frustum after turning", [&]() {
+			camera.processMouseMovement(direction, 0);
+			direction = -direction;
+			ME::Frustum frustum = camera.getFrustum();
+			ME::doNotOptimize(frustum);
+		});
+		runner.run("camera/frustum", [&]() {
+			ME::Frustum frustum = camera.getFrustum();
+			ME::doNotOptimize(frustum);
+		});
+	}
+
+	void benchScene(ME::BenchRunner& runner) {
+		// The same composition SceneRenderer does for every cube
+		size_t i = 0;
+		runner.run("scene/model matrix per cube", [&]() {
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, cubePositions[i % 10]);
+			float angle = 20.0f * i;
+			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+			ME::doNotOptimize(model);
+			i++;
+		});
+	}
+
+	float maxDifference(const glm::mat4& a, const glm::mat4& b) {
+		float difference = 0;
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				difference = std::max(difference, std::abs(a[column][row] - b[column][row]));
+		return difference;
+	}
+
+	// Every instruction set against glm on the same objects. Returns false
+	// when one of them is off by more than float rounding explains.
+	bool checkTransforms(const ME::simd::TransformBatch& transforms, const glm::mat4& viewProjection) {
+		size_t count = transforms.size();
+		std::vector<glm::mat4> models(count), clips(count), normals(count);
+		ME::BoundingBoxes local, world;
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 position(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+			glm::quat rotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]);
+			glm::vec3 scale(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]);
+			models[i] = glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.f), scale);
+			clips[i] = viewProjection * models[i];
+			normals[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(models[i]))));
+			local.add(glm::vec3(-.5f), glm::vec3(.5f));
+		}
+		bool passed = true;
+		ME::simd::InstructionSet supported = ME::simd::getSupportedInstructionSet();
+		for (int set = 0; set <= static_cast<int>(supported); set++) {
+			ME::simd::setInstructionSet(static_cast<ME::simd::InstructionSet>(set));
+			ME::simd::MatrixBatch batch, clipBatch, normalBatch;
+			ME::simd::composeTRS(transforms, batch);
+			ME::simd::multiply(viewProjection, batch, clipBatch);
+			ME::simd::inverseTranspose(batch, normalBatch);
+			ME::simd::transformBounds(batch, local, world);
+			float modelError = 0, clipError = 0, normalError = 0, boundsError = 0;
+			for (size_t i = 0; i < count; i++) {
+				modelError = std::max(modelError, maxDifference(batch.get(i), models[i]));
+				// Relative, the clip space values grow with the distance
+				float clipScale = std::max(1.f, std::abs(clips[i][3][3]));
+				clipError = std::max(clipError, maxDifference(clipBatch.get(i), clips[i]) / clipScale);
+				normalError = std::max(normalError, maxDifference(normalBatch.get(i), normals[i]));
+				ME::AABB box = ME::AABB::fromTransform(models[i], glm::vec3(.5f));
+				glm::vec3 center = (box.min + box.max) * .5f;
+				glm::vec3 extent = (box.max - box.min) * .5f;
+				boundsError = std::max({ boundsError, std::abs(world.centerX[i] - center.x), std::abs(world.centerY[i] - center.y),
+					std::abs(world.centerZ[i] - center.z), std::abs(world.extentX[i] - extent.x),
+					std::abs(world.extentY[i] - extent.y), std::abs(world.extentZ[i] - extent.z) });
+			}
+			const float tolerance = 1e-4f;
+			bool setPassed = modelError < tolerance && clipError < tolerance && normalError < tolerance && boundsError < tolerance;
+			std::printf("simd %-8s max error: model %g, view-projection %g, normal %g, bounds %g%s\n",
+				ME::simd::getInstructionSetName(static_cast<ME::simd::InstructionSet>(set)),
+				modelError, clipError, normalError, boundsError, setPassed ? "" : "  FAILED");
+			passed &= setPassed;
+		}
+		ME::simd::setInstructionSet(supported);
+		return passed;
+	}
+
+	bool benchTransforms(ME::BenchRunner& runner) {
+		const size_t count = 10000;
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> position(-50.f, 50.f);
+		std::uniform_real_distribution<float> component(-1.f, 1.f);
+		std::uniform_real_distribution<float> scale(.25f, 4.f);
+		ME::simd::TransformBatch transforms;
+		transforms.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			glm::quat rotation = glm::normalize(glm::quat(component(random), component(random), component(random), component(random)));
+			transforms.add(glm::vec3(position(random), position(random), position(random)), rotation,
+				glm::vec3(scale(random), scale(random), scale(random)));
+		}
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.f), 16.f / 9.f, .1f, 100.f) *
+			glm::lookAt(glm::vec3(0.f, 0.f, 60.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+		bool passed = checkTransforms(transforms, viewProjection);
+		runner.setMetadata("simd", ME::simd::getInstructionSetName(ME::simd::getSupportedInstructionSet()));
+
+		// What the engine did before, one object at a time through glm
+		std::vector<glm::mat4> models(count), clips(count), normals(count);
+		runner.run("transform/10000 TRS glm", [&]() {
+			for (size_t i = 0; i < count; i++) {
+				glm::quat rotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]);
+				models[i] = glm::translate(glm::mat4(1.f), glm::vec3(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i])) *
+					glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.f), glm::vec3(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]));
+			}
+			ME::doNotOptimize(models);
+		});
+		runner.run("transform/10000 view-projection glm", [&]() {
+			for (size_t i = 0; i < count; i++)
+				clips[i] = viewProjection * models[i];
+			ME::doNotOptimize(clips);
+		});
+		runner.run("transform/10000 inverse-transpose glm", [&]() {
+			for (size_t i = 0; i < count; i++)
+				normals[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(models[i]))));
+			ME::doNotOptimize(normals);
+		});
+		std::vector<ME::AABB> boxes(count);
+		runner.run("transform/10000 bounds glm", [&]() {
+			for (size_t i = 0; i < count; i++)
+				boxes[i] = ME::AABB::fromTransform(models[i], glm::vec3(.5f));
+			ME::doNotOptimize(boxes);
+		});
+
+		ME::simd::MatrixBatch batch, clipBatch, normalBatch;
+		ME::BoundingBoxes local, world;
+		for (size_t i = 0; i < count; i++)
+			local.add(glm::vec3(-.5f), glm::vec3(.5f));
+		ME::simd::composeTRS(transforms, batch);
+		ME::simd::InstructionSet supported = ME::simd::getSupportedInstructionSet();
+		for (int set = 0; set <= static_cast<int>(supported); set++) {
+			ME::simd::setInstructionSet(static_cast<ME::simd::InstructionSet>(set));
+			std::string name = ME::simd::getInstructionSetName(static_cast<ME::simd::InstructionSet>(set));
+			runner.run(("transform/10000 TRS " + name).c_str(), [&]() {
+				ME::simd::composeTRS(transforms, batch);
+				ME::doNotOptimize(batch);
+			});
+			runner.run(("transform/10000 view-projection " + name).c_str(), [&]() {
+				ME::simd::multiply(viewProjection, batch, clipBatch);
+				ME::doNotOptimize(clipBatch);
+			});
+			runner.run(("transform/10000 inverse-transpose " + name).c_str(), [&]() {
+				ME::simd::inverseTranspose(batch, normalBatch);
+				ME::doNotOptimize(normalBatch);
+			});
+			runner.run(("transform/10000 bounds " + name).c_str(), [&]() {
+				ME::simd::transformBounds(batch, local, world);
+				ME::doNotOptimize(world);
+			});
+		}
+		ME::simd::setInstructionSet(supported);
+		return passed;
+	}
+
+	// Random convex polygons with corners on a quarter pixel grid, so every
+	// edge function is exact in float and both kernels must agree on
+	// coverage. Depth only differs by rounding.
+	std::vector<ME::occlusion::Polygon> makePolygons(std::mt19937& random, size_t count) {
+		using namespace ME::occlusion;
+		std::uniform_real_distribution<float> centerX(-20.f, WIDTH + 20.f);
+		std::uniform_real_distribution<float> centerY(-20.f, HEIGHT + 20.f);
+		std::uniform_real_distribution<float> radius(2.f, 60.f);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		std::uniform_int_distribution<int> vertices(3, MAX_EDGES);
+		std::vector<Polygon> polygons;
+		while (polygons.size() < count) {
+			int vertexCount = vertices(random);
+			// Sorted by insertion, GCC 12 warns about std::sort's unrolled
+			// paths on an array this short
+			float angles[MAX_EDGES];
+			for (int vertex = 0; vertex < vertexCount; vertex++) {
+				float angle = unit(random) * 6.2831853f;
+				int slot = vertex;
+				for (; slot > 0 && angles[slot - 1] > angle; slot--)
+					angles[slot] = angles[slot - 1];
+				angles[slot] = angle;
+			}
+			float x[MAX_EDGES], y[MAX_EDGES];
+			float cx = centerX(random), cy = centerY(random), r = radius(random);
+			for (int vertex = 0; vertex < vertexCount; vertex++) {
+				x[vertex] = std::round((cx + r * std::cos(angles[vertex])) * 4.f) / 4.f;
+				y[vertex] = std::round((cy + r * std::sin(angles[vertex])) * 4.f) / 4.f;
+			}
+			Polygon polygon;
+			for (int edge = 0; edge < MAX_EDGES; edge++) {
+				int next = (edge + 1) % vertexCount;
+				polygon.edgeX[edge] = edge < vertexCount ? y[edge] - y[next] : 0.f;
+				polygon.edgeY[edge] = edge < vertexCount ? x[next] - x[edge] : 0.f;
+				polygon.edgeConstant[edge] = edge < vertexCount ? -(polygon.edgeX[edge] * x[edge] + polygon.edgeY[edge] * y[edge]) : 1.f;
+			}
+			polygon.depthX = (unit(random) - .5f) * 1e-3f;
+			polygon.depthY = (unit(random) - .5f) * 1e-3f;
+			polygon.depthConstant = .2f + unit(random) * .5f;
+			polygon.minX = std::max(0, static_cast<int>(std::floor(*std::min_element(x, x + vertexCount))));
+			polygon.minY = std::max(0, static_cast<int>(std::floor(*std::min_element(y, y + vertexCount))));
+			polygon.maxX = std::min(WIDTH - 1, static_cast<int>(std::floor(*std::max_element(x, x + vertexCount))));
+			polygon.maxY = std::min(HEIGHT - 1, static_cast<int>(std::floor(*std::max_element(y, y + vertexCount))));
+			if (polygon.minX <= polygon.maxX && polygon.minY <= polygon.maxY)
+				polygons.push_back(polygon);
+		}
+		return polygons;
+	}
+
+	// The AVX2 occlusion kernels against the scalar ones on the same
+	// polygons and rectangles
+	bool checkOcclusionKernels() {
+#if defined(ME_OCCLUSION_X86)
+		using namespace ME::occlusion;
+		if (ME::simd::getSupportedInstructionSet() < ME::simd::InstructionSet::AVX2) {
+			std::printf("occlusion kernels: no AVX2, nothing to compare\n");
+			return true;
+		}
+		const Kernels& scalar = getScalarKernels();
+		const Kernels& avx2 = getAvx2Kernels();
+		std::mt19937 random(7);
+		std::vector<Polygon> polygons = makePolygons(random, 500);
+		// One polygon at a time, overlaps would hide coverage differences
+		std::vector<float> scalarPolygon(WIDTH * HEIGHT), avx2Polygon(WIDTH * HEIGHT);
+		int coverageMismatches = 0;
+		float depthError = 0;
+		for (const Polygon& polygon : polygons) {
+			std::fill(scalarPolygon.begin(), scalarPolygon.end(), 0.f);
+			std::fill(avx2Polygon.begin(), avx2Polygon.end(), 0.f);
+			scalar.rasterize(polygon, 0, HEIGHT, scalarPolygon.data());
+			avx2.rasterize(polygon, 0, HEIGHT, avx2Polygon.data());
+			for (int i = 0; i < WIDTH * HEIGHT; i++) {
+				coverageMismatches += (scalarPolygon[i] == 0.f) != (avx2Polygon[i] == 0.f);
+				depthError = std::max(depthError, std::abs(scalarPolygon[i] - avx2Polygon[i]));
+			}
+		}
+		std::vector<float> scalarDepth(WIDTH * HEIGHT, 0.f);
+		for (const Polygon& polygon : polygons)
+			scalar.rasterize(polygon, 0, HEIGHT, scalarDepth.data());
+		std::vector<float> scalarFarthest(TILES_X * TILES_Y), avx2Farthest(TILES_X * TILES_Y);
+		scalar.reduceTiles(scalarDepth.data(), 0, TILES_X * TILES_Y, scalarFarthest.data());
+		avx2.reduceTiles(scalarDepth.data(), 0, TILES_X * TILES_Y, avx2Farthest.data());
+		int tileMismatches = 0;
+		for (int tile = 0; tile < TILES_X * TILES_Y; tile++)
+			tileMismatches += scalarFarthest[tile] != avx2Farthest[tile];
+		std::uniform_int_distribution<int> pixelX(0, WIDTH - 1), pixelY(0, HEIGHT - 1);
+		std::uniform_int_distribution<int> size(0, 40);
+		std::uniform_real_distribution<float> nearest(0.f, .8f);
+		int rectMismatches = 0;
+		for (int i = 0; i < 10000; i++) {
+			int minX = pixelX(random), minY = pixelY(random);
+			int maxX = std::min(WIDTH - 1, minX + size(random)), maxY = std::min(HEIGHT - 1, minY + size(random));
+			float depth = nearest(random);
+			rectMismatches += scalar.isRectVisible(scalarDepth.data(), scalarFarthest.data(), minX, minY, maxX, maxY, depth) !=
+				avx2.isRectVisible(scalarDepth.data(), scalarFarthest.data(), minX, minY, maxX, maxY, depth);
+		}
+		bool passed = coverageMismatches == 0 && depthError < 1e-5f && tileMismatches == 0 && rectMismatches == 0;
+		std::printf("occlusion kernels AVX2 against scalar: %d pixels covered differently, depth error %g, "
+			"%d tiles and %d rectangles differ%s\n", coverageMismatches, depthError, tileMismatches, rectMismatches,
+			passed ? "" : "  FAILED");
+		return passed;
+#else
+		return true;
+#endif
+	}
+
+	// A small scene with known answers, on every kernel set: a box behind a
+	// wall is culled, one seen through a gap narrower than a pixel and one
+	// across the near plane are kept
+	bool checkOcclusionScene() {
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.f), 2.f, .1f, 100.f) *
+			glm::lookAt(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+		// Two walls 0.03 apart, half a pixel of the buffer
+		glm::mat4 walls[2] = {
+			glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(-3.015f, 0.f, 0.f)), glm::vec3(6.f, 10.f, 1.f)),
+			glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(3.015f, 0.f, 0.f)), glm::vec3(6.f, 10.f, 1.f)),
+		};
+		ME::BoundingSpheres spheres;
+		uint32_t hidden = spheres.add(glm::vec3(3.f, 0.f, -5.f), .5f);
+		uint32_t throughGap = spheres.add(glm::vec3(0.f, 0.f, -5.f), .5f);
+		uint32_t nearPlane = spheres.add(glm::vec3(0.f, 0.f, 9.95f), .5f);
+		bool passed = true;
+		ME::simd::InstructionSet supported = ME::simd::getSupportedInstructionSet();
+		ME::simd::InstructionSet sets[2] = { ME::simd::InstructionSet::SCALAR, supported };
+		for (ME::simd::InstructionSet set : sets) {
+			ME::simd::setInstructionSet(set);
+			ME::OcclusionCuller culler;
+			culler.renderOccluders(viewProjection, walls, 2);
+			uint32_t objects[3] = { hidden, throughGap, nearPlane };
+			size_t visibleCount = culler.cull(spheres, objects, 3);
+			auto isKept = [&](uint32_t object) {
+				return std::find(objects, objects + visibleCount, object) != objects + visibleCount;
+			};
+			bool setPassed = !isKept(hidden) && isKept(throughGap) && isKept(nearPlane);
+			std::printf("occlusion %-6s hidden box %s, box behind the gap %s, box across the near plane %s%s\n",
+				ME::OcclusionCuller::getInstructionSet(), isKept(hidden) ? "kept" : "culled",
+				isKept(throughGap) ? "kept" : "culled", isKept(nearPlane) ? "kept" : "culled", setPassed ? "" : "  FAILED");
+			passed &= setPassed;
+			if (set == supported)
+				break;
+		}
+		ME::simd::setInstructionSet(supported);
+		return passed;
+	}
+
+	bool benchOcclusion(ME::BenchRunner& runner) {
+		bool passed = checkOcclusionKernels();
+		passed &= checkOcclusionScene();
+
+		// Occluders in front of a field of small objects, single threaded
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> position(-20.f, 20.f);
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.f), 16.f / 9.f, .1f, 100.f) *
+			glm::lookAt(glm::vec3(0.f, 0.f, 30.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+		std::vector<glm::mat4> models;
+		for (int i = 0; i < 64; i++)
+			models.push_back(glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(position(random), position(random), position(random) * .5f)), glm::vec3(3.f)));
+		const size_t count = 10000;
+		ME::BoundingSpheres spheres;
+		for (size_t i = 0; i < count; i++)
+			spheres.add(glm::vec3(position(random), position(random), position(random) - 10.f), .5f);
+		std::vector<uint32_t> objects(count);
+		ME::simd::InstructionSet supported = ME::simd::getSupportedInstructionSet();
+		ME::simd::InstructionSet sets[2] = { ME::simd::InstructionSet::SCALAR, supported };
+		for (ME::simd::InstructionSet set : sets) {
+			ME::simd::setInstructionSet(set);
+			std::string name = ME::OcclusionCuller::getInstructionSet();
+			ME::OcclusionCuller culler;
+			runner.run(("occlusion/64 occluders " + name).c_str(), [&]() {
+				culler.renderOccluders(viewProjection, models.data(), models.size());
+				ME::doNotOptimize(culler.getStats());
+			});
+			runner.run(("occlusion/10000 spheres " + name).c_str(), [&]() {
+				for (size_t i = 0; i < count; i++)
+					objects[i] = static_cast<uint32_t>(i);
+				size_t visibleCount = culler.cull(spheres, objects.data(), count);
+				ME::doNotOptimize(visibleCount);
+			});
+			if (set == supported)
+				break;
+		}
+		ME::simd::setInstructionSet(supported);
+		return passed;
+	}
+
+	void benchLoading(ME::BenchRunner& runner) {
+		std::string source = readFile(FRAGMENT_SHADER);
+		std::string withBOM = "\xEF\xBB\xBF" + source;
+		runner.run("util/copy shader source", [&]() {
+			std::string copy = withBOM;
+			ME::doNotOptimize(copy);
+		});
+		runner.run("util/copy and removeBOM", [&]() {
+			std::string copy = withBOM;
+			ME::removeBOM(copy);
+			ME::doNotOptimize(copy);
+		});
+		runner.run("io/shader source pair", [&]() {
+			// What the Shader constructor does before compiling
+			std::string vertexCode = readFile(VERTEX_SHADER);
+			std::string fragmentCode = readFile(FRAGMENT_SHADER);
+			ME::removeBOM(vertexCode);
+			ME::removeBOM(fragmentCode);
+			ME::doNotOptimize(vertexCode);
+			ME::doNotOptimize(fragmentCode);
+		});
+		// Decoding only, the file is read once up front
+		std::string image = readFile(IMAGE);
+		if (image.empty()) {
+			std::printf("%s not found, skipping image decoding\n", IMAGE);
+			return;
+		}
+		stbi_set_flip_vertically_on_load(true);
+		runner.run("io/decode container2.png", [&]() {
+			int width, height, channels;
+			unsigned char* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(image.data()),
+				static_cast<int>(image.size()), &width, &height, &channels, 0);
+			ME::doNotOptimize(data);
+			stbi_image_free(data);
+		});
+	}
+
+	void benchGL(ME::BenchRunner& runner) {
+		std::unique_ptr<ME::HeadlessContext> context;
+		try {
+			context = std::make_unique<ME::HeadlessContext>();
+		}
+		catch (const ME::HeadlessException& e) {
+			std::printf("Skipping GL benchmarks: %s\n", e.what());
+			return;
+		}
+		if (!gladLoadGLLoader(ME::HeadlessContext::getLoader())) {
+			std::printf("Skipping GL benchmarks: failed to initialize GLAD\n");
+			return;
+		}
+		runner.setMetadata("renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		try {
+			runner.run("gl/shader compile and link", [&]() {
+				ME::Shader shader(VERTEX_SHADER, FRAGMENT_SHADER);
+				ME::doNotOptimize(shader.ID);
+			});
+			ME::Shader shader(VERTEX_SHADER, FRAGMENT_SHADER);
+			shader.use();
+			glm::vec3 position(1.0f, 2.0f, 3.0f);
+			glm::mat4 matrix(1.0f);
+			// The per-frame uniforms of SceneRenderer, through both setter overloads
+			runner.run("gl/uniform setters std::string", [&]() {
+				shader.setVec3(std::string("light.position"), position);
+				shader.setVec3(std::string("light.direction"), position);
+				shader.setFloat(std::string("light.cutOff"), .9f);
+				shader.setVec3(std::string("viewPos"), position);
+				shader.setMatrix4f(std::string("view"), matrix);
+				shader.setMatrix4f(std::string("projection"), matrix);
+			});
+			runner.run("gl/uniform setters const char*", [&]() {
+				shader.setVec3("light.position", position);
+				shader.setVec3("light.direction", position);
+				shader.setFloat("light.cutOff", .9f);
+				shader.setVec3("viewPos", position);
+				shader.setMatrix4f("view", matrix);
+				shader.setMatrix4f("projection", matrix);
+			});
+			glFinish();
+		}
+		catch (const ME::MyError& e) {
+			std::printf("GL benchmarks failed: %s\n", e.what());
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	std::string outPath = "bench.json";
+	std::string comparePath;
+	std::string filter;
+	std::string label;
+	double seconds = 0.5;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			printUsage();
+			return -1;
+		}
+		const char* value = argv[++i];
+		if (std::strcmp(argv[i - 1], "--filter") == 0)
+			filter = value;
+		else if (std::strcmp(argv[i - 1], "--out") == 0)
+			outPath = value;
+		else if (std::strcmp(argv[i - 1], "--compare") == 0)
+			comparePath = value;
+		else if (std::strcmp(argv[i - 1], "--label") == 0)
+			label = value;
+		else if (std::strcmp(argv[i - 1], "--seconds") == 0)
+			seconds = std::atof(value);
+		else {
+			printUsage();
+			return -1;
+		}
+	}
+
+	ME::BenchRunner runner(seconds);
+	runner.setFilter(filter);
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+	runner.setMetadata("date", date);
+	if (!label.empty())
+		runner.setMetadata("label", label);
+	benchCamera(runner);
+	benchScene(runner);
+	bool transformsPassed = benchTransforms(runner);
+	bool occlusionPassed = benchOcclusion(runner);
+	benchLoading(runner);
+	benchGL(runner);
+
+	if (!runner.writeJson(outPath)) {
+		std::printf("Failed to write %s\n", outPath.c_str());
+		return -1;
+	}
+	std::printf("Wrote %s\n", outPath.c_str());
+	if (!comparePath.empty() && !runner.compare(comparePath)) {
+		std::printf("Failed to read %s\n", comparePath.c_str());
+		return -1;
+	}
+	if (!transformsPassed) {
+		std::printf("The SIMD transforms don't match glm\n");
+		return -1;
+	}
+	if (!occlusionPassed) {
+		std::printf("The occlusion culler failed its checks\n");
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+﻿#include "fragmentCounter.h"
+
+ME::FragmentCounter::FragmentCounter(const GLExtensions& extensions) {
+	supported = extensions.pipelineStatistics;
+	current = 0;
+	counting = false;
+	lastCount = 0;
+	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		queries[i] = 0;
+		pending[i] = false;
+	}
+	if (supported)
+		glGenQueries(FRAMES_IN_FLIGHT, queries);
+}
+
+ME::FragmentCounter::~FragmentCounter() {
+	if (supported)
+		glDeleteQueries(FRAMES_IN_FLIGHT, queries);
+}
+
+bool ME::FragmentCounter::isSupported() const {
+	return supported;
+}
+
+void ME::FragmentCounter::begin() {
+	if (!supported)
+		return;
+	// Oldest first, and stop at the first query that isn't done yet
+	for (int i = 1; i <= FRAMES_IN_FLIGHT; i++) {
+		int slot = (current + i) % FRAMES_IN_FLIGHT;
+		if (!pending[slot])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 count = 0;
+		glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &count);
+		lastCount = count;
+		pending[slot] = false;
+	}
+	current = (current + 1) % FRAMES_IN_FLIGHT;
+	counting = !pending[current];
+	if (counting)
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[current]);
+}
+
+void ME::FragmentCounter::end() {
+	if (!counting)
+		return;
+	glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+	pending[current] = true;
+	counting = false;
+}
+
+uint64_t ME::FragmentCounter::getLastCount() const {
+	return lastCount;
+}
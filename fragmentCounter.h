@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+#include "glExtensions.h"
+
+namespace ME {
+	// Counts the fragment shader invocations of one stretch of every frame,
+	// which shows how much overdraw a pass shades. Uses a ring of
+	// GL_FRAGMENT_SHADER_INVOCATIONS queries like GpuProfiler does, so the
+	// count arrives a few frames late and the CPU never waits for it. Without
+	// pipeline statistics queries every call does nothing and the count stays 0.
+	class FragmentCounter {
+	public:
+		static const int FRAMES_IN_FLIGHT = 4;
+	public:
+		explicit FragmentCounter(const GLExtensions& extensions);
+		FragmentCounter(const FragmentCounter&) = delete;
+		FragmentCounter& operator=(const FragmentCounter&) = delete;
+		~FragmentCounter();
+		bool isSupported() const;
+		// Collects whatever results have arrived, then starts counting unless
+		// the next query is still busy. Only one count may run at a time.
+		void begin();
+		void end();
+		// Latest count, from a few frames ago
+		uint64_t getLastCount() const;
+	private:
+		bool supported;
+		GLuint queries[FRAMES_IN_FLIGHT];
+		bool pending[FRAMES_IN_FLIGHT];
+		int current;
+		bool counting;
+		uint64_t lastCount;
+	};
+}
@@ -0,0 +1,64 @@
+﻿#include "frameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+ME::FrameArena::FrameArena(size_t bytesPerFrame, int frameCount) {
+	capacity = bytesPerFrame;
+	current = 0;
+	buffers.resize(std::max(frameCount, 1));
+	for (Buffer& buffer : buffers) {
+		buffer.memory = static_cast<unsigned char*>(::operator new(capacity));
+		buffer.offset = 0;
+	}
+}
+
+ME::FrameArena::~FrameArena() {
+	for (Buffer& buffer : buffers) {
+		releaseOverflow(buffer);
+		::operator delete(buffer.memory);
+	}
+}
+
+void* ME::FrameArena::allocate(size_t size, size_t alignment) {
+	Buffer& buffer = buffers[current];
+	uintptr_t base = reinterpret_cast<uintptr_t>(buffer.memory);
+	uintptr_t aligned = (base + buffer.offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+	size_t end = aligned - base + size;
+	if (end <= capacity) {
+		buffer.offset = end;
+		stats.used = end;
+		stats.highWater = std::max(stats.highWater, end);
+		return reinterpret_cast<void*>(aligned);
+	}
+	alignment = std::max(alignment, alignof(std::max_align_t));
+	void* memory = ::operator new(size, std::align_val_t(alignment));
+	buffer.overflow.push_back({ memory, alignment });
+	stats.overflowBytes += size;
+	stats.overflows++;
+	return memory;
+}
+
+void ME::FrameArena::beginFrame() {
+	current = (current + 1) % static_cast<int>(buffers.size());
+	Buffer& buffer = buffers[current];
+	buffer.offset = 0;
+	releaseOverflow(buffer);
+	stats.used = 0;
+	stats.overflowBytes = 0;
+}
+
+void ME::FrameArena::releaseOverflow(Buffer& buffer) {
+	for (const Overflow& overflow : buffer.overflow)
+		::operator delete(overflow.memory, std::align_val_t(overflow.alignment));
+	buffer.overflow.clear();
+}
+
+size_t ME::FrameArena::getCapacity() const {
+	return capacity;
+}
+
+const ME::FrameArena::Stats& ME::FrameArena::getStats() const {
+	return stats;
+}
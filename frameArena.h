@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace ME {
+	// Bump allocator for data that only lives for a frame. Every frame gets
+	// its own buffer and beginFrame() recycles the oldest one, so with N
+	// buffers an allocation stays valid for N - 1 more frames (e.g. while a
+	// render thread still reads it). Nothing is freed individually. When a
+	// buffer runs out, allocations fall back to the heap until that buffer is
+	// recycled, and are counted so the capacity can be raised. Not thread safe.
+	class FrameArena {
+	public:
+		struct Stats {
+			// This frame
+			size_t used = 0;
+			size_t overflowBytes = 0;
+			// Since creation
+			size_t highWater = 0;
+			unsigned int overflows = 0;
+		};
+	public:
+		explicit FrameArena(size_t bytesPerFrame, int frameCount = 2);
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		~FrameArena();
+		// Alignment must be a power of two
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		// Uninitialized storage, for types that don't need constructing
+		template <typename T>
+		T* allocateArray(size_t count) {
+			static_assert(std::is_trivially_destructible<T>::value, "Frame arena memory is never destructed");
+			return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		}
+		// Moves on to the next buffer and drops everything allocated there before
+		void beginFrame();
+		size_t getCapacity() const;
+		const Stats& getStats() const;
+	private:
+		struct Overflow {
+			void* memory;
+			size_t alignment;
+		};
+		struct Buffer {
+			unsigned char* memory;
+			size_t offset;
+			std::vector<Overflow> overflow;
+		};
+		void releaseOverflow(Buffer& buffer);
+
+		std::vector<Buffer> buffers;
+		size_t capacity;
+		int current;
+		Stats stats;
+	};
+
+	// Lets standard containers take their memory from a FrameArena.
+	// deallocate does nothing, so reserve up front rather than growing.
+	template <typename T>
+	class FrameAllocator {
+	public:
+		typedef T value_type;
+
+		explicit FrameAllocator(FrameArena& arena) : arena(&arena) {}
+		template <typename U>
+		FrameAllocator(const FrameAllocator<U>& other) : arena(other.getArena()) {}
+		T* allocate(size_t count) {
+			return static_cast<T*>(arena->allocate(sizeof(T) * count, alignof(T)));
+		}
+		void deallocate(T*, size_t) {}
+		FrameArena* getArena() const {
+			return arena;
+		}
+		template <typename U>
+		bool operator==(const FrameAllocator<U>& other) const {
+			return arena == other.getArena();
+		}
+		template <typename U>
+		bool operator!=(const FrameAllocator<U>& other) const {
+			return arena != other.getArena();
+		}
+	private:
+		FrameArena* arena;
+	};
+
+	template <typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
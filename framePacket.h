@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ME {
+	// How the scene is lit. Forward shades every fragment as it is drawn,
+	// deferred first stores the surfaces in a GBuffer and then lights each
+	// pixel once.
+	enum class ShadingPath {
+		FORWARD,
+		DEFERRED,
+	};
+
+	// The spotlight the camera carries
+	struct SpotLight {
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+		// Cosines of the inner and outer cone angles
+		float cutOff = 0;
+		float outerCutOff = 0;
+		glm::vec3 ambient = glm::vec3(0.0f);
+		glm::vec3 diffuse = glm::vec3(0.0f);
+		float constant = 1;
+		float linear = 0;
+		float quadratic = 0;
+	};
+
+	// One tile of the shadow atlas, see ShadowAtlas. Caster lists live in
+	// the producer's FrameArena.
+	struct ShadowTile {
+		bool active = false;
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		// Static depth is stale, the static casters have to be drawn again
+		bool renderStatic = false;
+		const uint32_t* staticCasters = nullptr;
+		size_t staticCount = 0;
+		// Drawn every frame over the cached static depth
+		const uint32_t* dynamicCasters = nullptr;
+		size_t dynamicCount = 0;
+	};
+
+	struct ShadowPacket {
+		static const int MAX_TILES = 16;
+		ShadowTile tiles[MAX_TILES];
+		// World space to atlas coordinates and depth of every tile
+		glm::mat4 atlasMatrices[MAX_TILES];
+		int flashlightTile = -1;
+		// Changes with the matrices or the flashlight's tile
+		uint64_t version = 0;
+		// Tiles whose static depth is drawn this frame, tiles with dynamic
+		// casters, and the draws of both
+		unsigned int staticRenders = 0;
+		unsigned int dynamicRenders = 0;
+		unsigned int casters = 0;
+	};
+
+	// The scene's lights sorted into clusters, see LightClusters. The arrays
+	// live in the producer's FrameArena.
+	struct LightClusterPacket {
+		// LightClusters::TEXELS_PER_LIGHT texels per light, see lighting.frag
+		const glm::vec4* lights = nullptr;
+		size_t lightCount = 0;
+		// First index and count of every cluster
+		const uint32_t* ranges = nullptr;
+		const uint16_t* indices = nullptr;
+		size_t indexCount = 0;
+		// Clusters per pixel, and the scale and bias from log(depth) to slice
+		glm::vec2 screenScale = glm::vec2(0.0f);
+		glm::vec2 depthScale = glm::vec2(0.0f);
+		double milliseconds = 0;
+	};
+
+	// Everything the renderer needs to draw one frame, built by the thread
+	// that runs the simulation. Once handed over it is only read, so the
+	// render thread never touches the camera or the scene's culling state.
+	struct FramePacket {
+		uint64_t frame = 0;
+		// What the scene is rendered at, the output size times resolutionScale
+		int width = 0;
+		int height = 0;
+		// The viewport the frame ends up in, upscaled when it differs
+		int outputWidth = 0;
+		int outputHeight = 0;
+		float resolutionScale = 1;
+		// Camera::getVersion of the camera the packet was built from
+		uint64_t cameraVersion = 0;
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		glm::vec3 cameraPosition = glm::vec3(0.0f);
+		glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+		ShadingPath shadingPath = ShadingPath::FORWARD;
+		// Lay down depth first, so the shading pass only runs on visible fragments
+		bool depthPrepass = false;
+		// Drop the cubes hidden behind the biggest ones before submitting
+		bool occlusionCulling = false;
+		SpotLight light;
+		LightClusterPacket lightClusters;
+		ShadowPacket shadows;
+		// Models of the cubes that move, the first dynamicCount ones
+		const glm::mat4* dynamicModels = nullptr;
+		size_t dynamicCount = 0;
+		// Indices of the visible cubes, in the producer's FrameArena
+		const uint32_t* visible = nullptr;
+		size_t visibleCount = 0;
+		unsigned int culled = 0;
+		double cullMilliseconds = 0;
+		// Of the cubes left by the frustum, the ones the occlusion culler dropped
+		unsigned int occluded = 0;
+		float occludedFraction = 0;
+		double occlusionMilliseconds = 0;
+	};
+}
@@ -0,0 +1,131 @@
+﻿#include "frameReport.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	void writeJsonString(std::FILE* file, const std::string& string) {
+		std::fputc('"', file);
+		for (char c : string) {
+			if (c == '"' || c == '\\')
+				std::fputc('\\', file);
+			if (static_cast<unsigned char>(c) >= 0x20)
+				std::fputc(c, file);
+		}
+		std::fputc('"', file);
+	}
+
+	std::FILE* openReport(const std::string& path) {
+		std::FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+			throw ME::ReportException("Failed to open report " + path);
+		return file;
+	}
+
+	void closeReport(std::FILE* file, const std::string& path) {
+		if (std::fclose(file) != 0)
+			throw ME::ReportException("Failed to write report " + path);
+	}
+}
+
+ME::FrameReport::FrameReport(const std::vector<std::string>& columns) {
+	this->columns = columns;
+}
+
+void ME::FrameReport::reserve(size_t frames) {
+	values.reserve(frames * columns.size());
+}
+
+void ME::FrameReport::setMetadata(const std::string& key, const std::string& value) {
+	for (auto& entry : metadata) {
+		if (entry.first == key) {
+			entry.second = value;
+			return;
+		}
+	}
+	metadata.emplace_back(key, value);
+}
+
+void ME::FrameReport::addRow(const double* row) {
+	values.insert(values.end(), row, row + columns.size());
+}
+
+size_t ME::FrameReport::getRowCount() const {
+	return columns.empty() ? 0 : values.size() / columns.size();
+}
+
+ME::FrameStats::Summary ME::FrameReport::summarize(size_t column) const {
+	FrameStats::Summary summary;
+	size_t rows = getRowCount();
+	if (rows == 0 || column >= columns.size())
+		return summary;
+	std::vector<double> sorted(rows);
+	double sum = 0;
+	for (size_t row = 0; row < rows; row++) {
+		sorted[row] = values[row * columns.size() + column];
+		sum += sorted[row];
+	}
+	std::sort(sorted.begin(), sorted.end());
+	size_t last = rows - 1;
+	summary.mean = sum / rows;
+	summary.p50 = sorted[last * 50 / 100];
+	summary.p95 = sorted[last * 95 / 100];
+	summary.p99 = sorted[last * 99 / 100];
+	summary.max = sorted[last];
+	return summary;
+}
+
+void ME::FrameReport::write(const std::string& path) const {
+	bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+	if (csv)
+		writeCsv(path);
+	else
+		writeJson(path);
+}
+
+void ME::FrameReport::writeCsv(const std::string& path) const {
+	std::FILE* file = openReport(path);
+	for (size_t column = 0; column < columns.size(); column++)
+		std::fprintf(file, column == 0 ? "%s" : ",%s", columns[column].c_str());
+	std::fputc('\n', file);
+	for (size_t row = 0; row < getRowCount(); row++) {
+		for (size_t column = 0; column < columns.size(); column++)
+			std::fprintf(file, column == 0 ? "%.6g" : ",%.6g", values[row * columns.size() + column]);
+		std::fputc('\n', file);
+	}
+	closeReport(file, path);
+}
+
+void ME::FrameReport::writeJson(const std::string& path) const {
+	std::FILE* file = openReport(path);
+	std::fputs("{\n\"metadata\": {", file);
+	for (size_t i = 0; i < metadata.size(); i++) {
+		std::fputs(i == 0 ? "\n  " : ",\n  ", file);
+		writeJsonString(file, metadata[i].first);
+		std::fputs(": ", file);
+		writeJsonString(file, metadata[i].second);
+	}
+	std::fputs("\n},\n\"summary\": {", file);
+	for (size_t column = 0; column < columns.size(); column++) {
+		FrameStats::Summary summary = summarize(column);
+		std::fputs(column == 0 ? "\n  " : ",\n  ", file);
+		writeJsonString(file, columns[column]);
+		std::fprintf(file, ": {\"mean\": %.6g, \"p50\": %.6g, \"p95\": %.6g, \"p99\": %.6g, \"max\": %.6g}",
+			summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+	}
+	std::fputs("\n},\n\"columns\": [", file);
+	for (size_t column = 0; column < columns.size(); column++) {
+		if (column > 0)
+			std::fputs(", ", file);
+		writeJsonString(file, columns[column]);
+	}
+	std::fputs("],\n\"frames\": [", file);
+	for (size_t row = 0; row < getRowCount(); row++) {
+		std::fputs(row == 0 ? "\n  [" : ",\n  [", file);
+		for (size_t column = 0; column < columns.size(); column++)
+			std::fprintf(file, column == 0 ? "%.6g" : ", %.6g", values[row * columns.size() + column]);
+		std::fputc(']', file);
+	}
+	std::fputs("\n]\n}\n", file);
+	closeReport(file, path);
+}
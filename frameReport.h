@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "frameStats.h"
+#include "util.h"
+
+namespace ME {
+	// Per-frame values of a scripted run, written out for tooling. CSV gets one
+	// row per frame, JSON additionally gets the run's metadata and a summary
+	// of every column.
+	class FrameReport {
+	public:
+		explicit FrameReport(const std::vector<std::string>& columns);
+		void reserve(size_t frames);
+		void setMetadata(const std::string& key, const std::string& value);
+		// One value per column
+		void addRow(const double* values);
+		size_t getRowCount() const;
+		FrameStats::Summary summarize(size_t column) const;
+		// Picks the format from the extension, .csv or anything else for JSON.
+		// Throws ReportException when the file can't be written.
+		void write(const std::string& path) const;
+		void writeCsv(const std::string& path) const;
+		void writeJson(const std::string& path) const;
+	private:
+		std::vector<std::string> columns;
+		std::vector<std::pair<std::string, std::string>> metadata;
+		std::vector<double> values;
+	};
+
+	class ReportException : public ME::MyError {
+	public:
+		ReportException(const std::string& message) : MyError(message) {}
+		virtual ~ReportException() {}
+	};
+}
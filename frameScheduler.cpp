@@ -0,0 +1,97 @@
+﻿#include "frameScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+	double toSeconds(ME::FrameScheduler::Clock::duration duration) {
+		return std::chrono::duration<double>(duration).count();
+	}
+}
+
+ME::FrameScheduler::FrameScheduler(double updateRate, double frameCap) {
+	start = Clock::now();
+	lastFrame = start;
+	nextFrame = start;
+	accumulator = 0;
+	frameDuration = 0;
+	sleepOvershoot = 0.001;
+	droppedSteps = 0;
+	setUpdateRate(updateRate);
+	setFrameCap(frameCap);
+}
+
+void ME::FrameScheduler::setUpdateRate(double updateRate) {
+	stepDuration = 1.0 / std::max(updateRate, 1.0);
+}
+
+void ME::FrameScheduler::setFrameCap(double frameCap) {
+	frameInterval = frameCap > 0
+		? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameCap))
+		: Clock::duration::zero();
+	nextFrame = Clock::now();
+}
+
+int ME::FrameScheduler::beginFrame() {
+	Clock::time_point now = Clock::now();
+	frameDuration = toSeconds(now - lastFrame);
+	lastFrame = now;
+	accumulator += frameDuration;
+	int steps = 0;
+	while (accumulator >= stepDuration && steps < MAX_STEPS_PER_FRAME) {
+		accumulator -= stepDuration;
+		steps++;
+	}
+	// After a stall, jump ahead instead of trying to simulate all of it
+	if (accumulator >= stepDuration) {
+		double behind = std::floor(accumulator / stepDuration);
+		droppedSteps += static_cast<unsigned long long>(behind);
+		accumulator -= behind * stepDuration;
+	}
+	return steps;
+}
+
+double ME::FrameScheduler::getStepDuration() const {
+	return stepDuration;
+}
+
+double ME::FrameScheduler::getAlpha() const {
+	return accumulator / stepDuration;
+}
+
+double ME::FrameScheduler::getFrameDuration() const {
+	return frameDuration;
+}
+
+double ME::FrameScheduler::getTime() const {
+	return toSeconds(Clock::now() - start);
+}
+
+unsigned long long ME::FrameScheduler::getDroppedSteps() const {
+	return droppedSteps;
+}
+
+void ME::FrameScheduler::waitForNextFrame() {
+	if (frameInterval == Clock::duration::zero())
+		return;
+	Clock::time_point now = Clock::now();
+	nextFrame += frameInterval;
+	// Running late, pace from here rather than rushing to catch up
+	if (nextFrame <= now) {
+		nextFrame = now;
+		return;
+	}
+	// Sleep in short naps while a nap surely ends before the deadline
+	const double nap = 0.001;
+	while (toSeconds(nextFrame - now) > nap + sleepOvershoot) {
+		std::this_thread::sleep_for(std::chrono::duration<double>(nap));
+		Clock::time_point woke = Clock::now();
+		double overshoot = toSeconds(woke - now) - nap;
+		// Follow a worse wake-up at once, forget it slowly
+		sleepOvershoot = std::max(overshoot, sleepOvershoot * 0.95 + overshoot * 0.05);
+		now = woke;
+	}
+	while (Clock::now() < nextFrame)
+		std::this_thread::yield();
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <chrono>
+
+namespace ME {
+	// Main loop pacing. Simulation runs in fixed steps, fed by the real time
+	// that passed, and rendering interpolates between the last two steps with
+	// getAlpha(). An optional frame cap first sleeps, then spins for the last
+	// stretch the OS scheduler can't hit reliably. Times are doubles off the
+	// monotonic clock, so they keep their precision however long the app runs.
+	class FrameScheduler {
+	public:
+		typedef std::chrono::steady_clock Clock;
+		// A frame never runs more steps than this, the rest of a stall is dropped
+		static const int MAX_STEPS_PER_FRAME = 8;
+	public:
+		// A frame cap of 0 renders as fast as possible
+		explicit FrameScheduler(double updateRate = 120.0, double frameCap = 0.0);
+		void setUpdateRate(double updateRate);
+		void setFrameCap(double frameCap);
+		// Call once at the top of each frame. Returns how many fixed steps to run.
+		int beginFrame();
+		// Seconds per fixed step
+		double getStepDuration() const;
+		// How far rendering is between the previous step and the current one, [0, 1)
+		double getAlpha() const;
+		// Seconds the last frame took, wait included
+		double getFrameDuration() const;
+		// Seconds since the scheduler was created
+		double getTime() const;
+		unsigned long long getDroppedSteps() const;
+		// Blocks until the frame cap allows the next frame
+		void waitForNextFrame();
+	private:
+		Clock::time_point start;
+		Clock::time_point lastFrame;
+		Clock::time_point nextFrame;
+		Clock::duration frameInterval;
+		double stepDuration;
+		double accumulator;
+		double frameDuration;
+		// How late a short sleep tends to wake up, learned as we go
+		double sleepOvershoot;
+		unsigned long long droppedSteps;
+	};
+}
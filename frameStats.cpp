@@ -0,0 +1,102 @@
+﻿#include "frameStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+ME::FrameStats::FrameStats(double publishRate) {
+	channelCount = 0;
+	started = false;
+	setPublishRate(publishRate);
+	addChannel("frame", "ms");
+}
+
+void ME::FrameStats::setPublishRate(double publishRate) {
+	publishInterval = publishRate > 0 ? 1.0 / publishRate : 0.0;
+}
+
+int ME::FrameStats::addChannel(const char* name, const char* unit) {
+	if (channelCount >= MAX_CHANNELS)
+		return -1;
+	Channel& channel = channels[channelCount];
+	channel.name = name;
+	channel.unit = unit;
+	channel.head = 0;
+	channel.count = 0;
+	channel.summary = Summary();
+	return channelCount++;
+}
+
+void ME::FrameStats::record(int channelIndex, double value) {
+	if (channelIndex < 0 || channelIndex >= channelCount)
+		return;
+	Channel& channel = channels[channelIndex];
+	channel.values[channel.head] = value;
+	channel.head = (channel.head + 1) % HISTORY;
+	if (channel.count < HISTORY)
+		channel.count++;
+}
+
+bool ME::FrameStats::tick() {
+	auto now = std::chrono::steady_clock::now();
+	if (!started) {
+		started = true;
+		lastFrame = now;
+		lastPublish = now;
+		return false;
+	}
+	record(FRAME_TIME, std::chrono::duration<double, std::milli>(now - lastFrame).count());
+	lastFrame = now;
+	if (std::chrono::duration<double>(now - lastPublish).count() < publishInterval)
+		return false;
+	lastPublish = now;
+	publish();
+	return true;
+}
+
+void ME::FrameStats::publish() {
+	for (int i = 0; i < channelCount; i++) {
+		Channel& channel = channels[i];
+		if (channel.count == 0)
+			continue;
+		double sum = 0;
+		for (int j = 0; j < channel.count; j++) {
+			scratch[j] = channel.values[j];
+			sum += channel.values[j];
+		}
+		std::sort(scratch, scratch + channel.count);
+		int last = channel.count - 1;
+		channel.summary.mean = sum / channel.count;
+		channel.summary.p50 = scratch[last * 50 / 100];
+		channel.summary.p95 = scratch[last * 95 / 100];
+		channel.summary.p99 = scratch[last * 99 / 100];
+		channel.summary.max = scratch[last];
+	}
+}
+
+const ME::FrameStats::Summary& ME::FrameStats::getSummary(int channel) const {
+	return channels[channel].summary;
+}
+
+const char* ME::FrameStats::getChannelName(int channel) const {
+	return channels[channel].name;
+}
+
+int ME::FrameStats::getChannelCount() const {
+	return channelCount;
+}
+
+size_t ME::FrameStats::format(char* buffer, size_t size) const {
+	if (size == 0)
+		return 0;
+	const Summary& frame = channels[FRAME_TIME].summary;
+	int written = std::snprintf(buffer, size, "fps: %.1f frame ms: mean %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f",
+		frame.mean > 0 ? 1000.0 / frame.mean : 0.0, frame.mean, frame.p50, frame.p95, frame.p99, frame.max);
+	size_t length = written > 0 ? std::min(static_cast<size_t>(written), size - 1) : 0;
+	for (int i = 1; i < channelCount && length + 1 < size; i++) {
+		written = std::snprintf(buffer + length, size - length, " | %s: %.2f%s",
+			channels[i].name, channels[i].summary.mean, channels[i].unit);
+		if (written > 0)
+			length = std::min(length + written, size - 1);
+	}
+	return length;
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace ME {
+	// Rolling per-frame statistics. Values go into fixed ring buffers, and a
+	// summary (mean, percentiles, max) is only computed at the publish rate,
+	// so nothing on the per-frame path allocates.
+	class FrameStats {
+	public:
+		static const int HISTORY = 256;
+		static const int MAX_CHANNELS = 32;
+		// Channel 0 always holds the frame time
+		static const int FRAME_TIME = 0;
+		struct Summary {
+			double mean = 0;
+			double p50 = 0;
+			double p95 = 0;
+			double p99 = 0;
+			double max = 0;
+		};
+	public:
+		explicit FrameStats(double publishRate = 2.0);
+		void setPublishRate(double publishRate);
+		// Returns the id to record into, or -1 when all channels are taken
+		int addChannel(const char* name, const char* unit = "");
+		void record(int channel, double value);
+		// Call once per frame. Records the frame time since the previous call and
+		// returns true when a new summary has been published.
+		bool tick();
+		const Summary& getSummary(int channel) const;
+		const char* getChannelName(int channel) const;
+		int getChannelCount() const;
+		// Formats the last published summary, truncating to fit
+		size_t format(char* buffer, size_t size) const;
+	private:
+		struct Channel {
+			const char* name;
+			const char* unit;
+			double values[HISTORY];
+			int head;
+			int count;
+			Summary summary;
+		};
+		void publish();
+
+		Channel channels[MAX_CHANNELS];
+		int channelCount;
+		double scratch[HISTORY];
+		double publishInterval;
+		std::chrono::steady_clock::time_point lastFrame;
+		std::chrono::steady_clock::time_point lastPublish;
+		bool started;
+	};
+}
@@ -0,0 +1,60 @@
+﻿#include "framebuffer.h"
+
+ME::Framebuffer::Framebuffer(GLsizei width, GLsizei height) {
+	this->width = width;
+	this->height = height;
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenRenderbuffers(1, &depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(1, &depthStencil);
+		glDeleteTextures(1, &colorTexture);
+		throw FramebufferException("Framebuffer incomplete, status " + std::to_string(status));
+	}
+	colorMemoryID = ResourceRegistry::addTexture("framebuffer color", GL_RGBA8, width, height);
+	depthMemoryID = ResourceRegistry::add(ResourceRegistry::Category::RENDERBUFFER, "framebuffer depth",
+		static_cast<size_t>(width) * height * ResourceRegistry::getBytesPerPixel(GL_DEPTH24_STENCIL8), GL_DEPTH24_STENCIL8);
+}
+
+ME::Framebuffer::~Framebuffer() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &depthStencil);
+	glDeleteTextures(1, &colorTexture);
+	ResourceRegistry::remove(colorMemoryID);
+	ResourceRegistry::remove(depthMemoryID);
+}
+
+void ME::Framebuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, width, height);
+}
+
+GLuint ME::Framebuffer::getID() const {
+	return fbo;
+}
+
+GLuint ME::Framebuffer::getColorTexture() const {
+	return colorTexture;
+}
+
+GLsizei ME::Framebuffer::getWidth() const {
+	return width;
+}
+
+GLsizei ME::Framebuffer::getHeight() const {
+	return height;
+}
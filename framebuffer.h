@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include "resourceRegistry.h"
+#include "util.h"
+
+namespace ME {
+	// Offscreen render target with an RGBA8 color texture and a 24 bit depth,
+	// 8 bit stencil renderbuffer.
+	class Framebuffer {
+	public:
+		// Throws FramebufferException when the driver rejects the attachments
+		Framebuffer(GLsizei width, GLsizei height);
+		Framebuffer(const Framebuffer&) = delete;
+		Framebuffer& operator=(const Framebuffer&) = delete;
+		~Framebuffer();
+		// Binds for drawing and reading and sets the viewport to cover it
+		void bind() const;
+		GLuint getID() const;
+		GLuint getColorTexture() const;
+		GLsizei getWidth() const;
+		GLsizei getHeight() const;
+	private:
+		GLuint fbo;
+		GLuint colorTexture;
+		GLuint depthStencil;
+		GLsizei width;
+		GLsizei height;
+		ResourceRegistry::ID colorMemoryID;
+		ResourceRegistry::ID depthMemoryID;
+	};
+
+	class FramebufferException : public ME::MyError {
+	public:
+		FramebufferException(const std::string& message) : MyError(message) {}
+		virtual ~FramebufferException() {}
+	};
+}
@@ -0,0 +1,99 @@
+﻿#include "gBuffer.h"
+
+namespace {
+	GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, GLsizei width, GLsizei height) {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+		// Read with texelFetch, one texel per pixel
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	}
+}
+
+ME::GBuffer::GBuffer(GLsizei width, GLsizei height) {
+	this->width = width;
+	this->height = height;
+	create();
+}
+
+ME::GBuffer::~GBuffer() {
+	destroy();
+}
+
+void ME::GBuffer::create() {
+	albedoSpecular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	normal = createTarget(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, width, height);
+	depth = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &albedoSpecular);
+		glDeleteTextures(1, &normal);
+		glDeleteTextures(1, &depth);
+		throw FramebufferException("G-buffer incomplete, status " + std::to_string(status));
+	}
+	albedoSpecularMemoryID = ResourceRegistry::addTexture("g-buffer albedo and specular", GL_RGBA8, width, height);
+	normalMemoryID = ResourceRegistry::addTexture("g-buffer normal", GL_RGB10_A2, width, height);
+	depthMemoryID = ResourceRegistry::addTexture("g-buffer depth", GL_DEPTH24_STENCIL8, width, height);
+}
+
+void ME::GBuffer::destroy() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &albedoSpecular);
+	glDeleteTextures(1, &normal);
+	glDeleteTextures(1, &depth);
+	ResourceRegistry::remove(albedoSpecularMemoryID);
+	ResourceRegistry::remove(normalMemoryID);
+	ResourceRegistry::remove(depthMemoryID);
+}
+
+void ME::GBuffer::resize(GLsizei width, GLsizei height) {
+	if (width == this->width && height == this->height)
+		return;
+	destroy();
+	this->width = width;
+	this->height = height;
+	create();
+}
+
+void ME::GBuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, width, height);
+}
+
+GLuint ME::GBuffer::getID() const {
+	return fbo;
+}
+
+GLuint ME::GBuffer::getAlbedoSpecularTexture() const {
+	return albedoSpecular;
+}
+
+GLuint ME::GBuffer::getNormalTexture() const {
+	return normal;
+}
+
+GLuint ME::GBuffer::getDepthTexture() const {
+	return depth;
+}
+
+GLsizei ME::GBuffer::getWidth() const {
+	return width;
+}
+
+GLsizei ME::GBuffer::getHeight() const {
+	return height;
+}
@@ -0,0 +1,26 @@
+﻿#version 330 core
+
+// Geometry pass of the deferred path, see GBuffer. Takes the same inputs as
+// lighting.frag and stores the surface instead of lighting it.
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+in vec3 normal;
+in vec3 fragPos;
+in vec2 textureCoordinate;
+
+uniform Material material;
+
+layout(location = 0) out vec4 albedoSpecular;
+layout(location = 1) out vec4 packedNormal;
+
+void main()
+{
+    // The specular map is grey, one channel of it is enough
+    vec3 specular = texture(material.specular, textureCoordinate).rgb;
+    albedoSpecular = vec4(texture(material.diffuse, textureCoordinate).rgb, dot(specular, vec3(1.0 / 3.0)));
+    packedNormal = vec4(normalize(normal) * 0.5 + 0.5, 1.0);
+}
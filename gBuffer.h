@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include "framebuffer.h"
+#include "resourceRegistry.h"
+
+namespace ME {
+	// Render targets of the deferred path's geometry pass. Positions are not
+	// stored, the lighting pass rebuilds them from the depth texture.
+	//   albedo and specular  RGBA8, diffuse color and specular intensity
+	//   normal               RGB10_A2, world space packed into [0, 1]
+	//   depth                DEPTH24_STENCIL8
+	class GBuffer {
+	public:
+		// Throws FramebufferException when the driver rejects the attachments
+		GBuffer(GLsizei width, GLsizei height);
+		GBuffer(const GBuffer&) = delete;
+		GBuffer& operator=(const GBuffer&) = delete;
+		~GBuffer();
+		// Reallocates the attachments when the size changed
+		void resize(GLsizei width, GLsizei height);
+		// Binds for drawing and sets the viewport to cover it
+		void bind() const;
+		GLuint getID() const;
+		GLuint getAlbedoSpecularTexture() const;
+		GLuint getNormalTexture() const;
+		GLuint getDepthTexture() const;
+		GLsizei getWidth() const;
+		GLsizei getHeight() const;
+	private:
+		void create();
+		void destroy();
+
+		GLuint fbo;
+		GLuint albedoSpecular;
+		GLuint normal;
+		GLuint depth;
+		GLsizei width;
+		GLsizei height;
+		ResourceRegistry::ID albedoSpecularMemoryID;
+		ResourceRegistry::ID normalMemoryID;
+		ResourceRegistry::ID depthMemoryID;
+	};
+}
@@ -0,0 +1,46 @@
+﻿#include "glExtensions.h"
+
+#include <cstring>
+
+ME::GLExtensions::GLExtensions() {
+	major = 0;
+	minor = 0;
+	multiDrawIndirect = false;
+	bufferStorage = false;
+	baseInstance = false;
+	pipelineStatistics = false;
+	MultiDrawElementsIndirect = nullptr;
+	BufferStorage = nullptr;
+}
+
+void ME::GLExtensions::load(GLADloadproc loader) {
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	MultiDrawElementsIndirect = reinterpret_cast<PFNMEMULTIDRAWELEMENTSINDIRECTPROC>(loader("glMultiDrawElementsIndirect"));
+	BufferStorage = reinterpret_cast<PFNMEBUFFERSTORAGEPROC>(loader("glBufferStorage"));
+
+	multiDrawIndirect = (isVersionAtLeast(4, 3) || hasExtension("GL_ARB_multi_draw_indirect")) &&
+		MultiDrawElementsIndirect != nullptr;
+	bufferStorage = (isVersionAtLeast(4, 4) || hasExtension("GL_ARB_buffer_storage")) &&
+		BufferStorage != nullptr;
+	// baseInstance in indirect commands is only honoured from 4.2 on
+	baseInstance = isVersionAtLeast(4, 2) || hasExtension("GL_ARB_base_instance");
+	// Plain glBeginQuery targets, nothing to load
+	pipelineStatistics = isVersionAtLeast(4, 6) || hasExtension("GL_ARB_pipeline_statistics_query");
+}
+
+bool ME::GLExtensions::hasExtension(const char* name) const {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension != nullptr && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool ME::GLExtensions::isVersionAtLeast(int requiredMajor, int requiredMinor) const {
+	return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+}
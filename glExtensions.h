@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+// glad is generated for the 3.3 core profile, so anything newer is declared
+// and loaded here.
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS
+#define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+#endif
+
+namespace ME {
+	typedef void (APIENTRYP PFNMEMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+	typedef void (APIENTRYP PFNMEBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	class GLExtensions {
+	public:
+		GLExtensions();
+		// Needs a current context
+		void load(GLADloadproc loader);
+		bool hasExtension(const char* name) const;
+		bool isVersionAtLeast(int major, int minor) const;
+
+		int major;
+		int minor;
+		bool multiDrawIndirect;
+		bool bufferStorage;
+		bool baseInstance;
+		// Query targets such as GL_FRAGMENT_SHADER_INVOCATIONS
+		bool pipelineStatistics;
+		PFNMEMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+		PFNMEBUFFERSTORAGEPROC BufferStorage;
+	};
+}
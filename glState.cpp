@@ -0,0 +1,178 @@
+﻿#include "glState.h"
+#include "glExtensions.h"
+
+ME::GLState::GLState() {
+	invalidate();
+}
+
+int ME::GLState::bufferSlot(GLenum target) {
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_TEXTURE_BUFFER: return 3;
+	case GL_COPY_READ_BUFFER: return 4;
+	case GL_COPY_WRITE_BUFFER: return 5;
+	case GL_DRAW_INDIRECT_BUFFER: return 6;
+	default: return -1;
+	}
+}
+
+int ME::GLState::textureSlot(GLenum target) {
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_CUBE_MAP: return 1;
+	case GL_TEXTURE_2D_ARRAY: return 2;
+	case GL_TEXTURE_BUFFER: return 3;
+	default: return -1;
+	}
+}
+
+int ME::GLState::capabilitySlot(GLenum capability) {
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return 0;
+	case GL_CULL_FACE: return 1;
+	case GL_BLEND: return 2;
+	case GL_STENCIL_TEST: return 3;
+	case GL_SCISSOR_TEST: return 4;
+	case GL_POLYGON_OFFSET_FILL: return 5;
+	case GL_FRAMEBUFFER_SRGB: return 6;
+	default: return -1;
+	}
+}
+
+bool ME::GLState::changed(GLuint& cached, GLuint value) {
+	if (cached == value) {
+		stats.filtered++;
+		return false;
+	}
+	cached = value;
+	stats.issued++;
+	return true;
+}
+
+void ME::GLState::useProgram(GLuint newProgram) {
+	if (changed(program, newProgram))
+		glUseProgram(newProgram);
+}
+
+void ME::GLState::bindVertexArray(GLuint newVAO) {
+	if (changed(vao, newVAO)) {
+		glBindVertexArray(newVAO);
+		// The element buffer binding is part of the VAO
+		buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void ME::GLState::bindBuffer(GLenum target, GLuint buffer) {
+	int slot = bufferSlot(target);
+	if (slot < 0) {
+		stats.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (changed(buffers[slot], buffer))
+		glBindBuffer(target, buffer);
+}
+
+void ME::GLState::activeTexture(unsigned int unit) {
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		stats.issued++;
+	}
+}
+
+void ME::GLState::bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+	int slot = textureSlot(target);
+	if (unit >= MAX_TEXTURE_UNITS || slot < 0) {
+		activeTexture(unit);
+		stats.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (textures[unit][slot] == texture) {
+		stats.filtered++;
+		return;
+	}
+	activeTexture(unit);
+	textures[unit][slot] = texture;
+	stats.issued++;
+	glBindTexture(target, texture);
+}
+
+void ME::GLState::bindSampler(unsigned int unit, GLuint sampler) {
+	if (unit >= MAX_TEXTURE_UNITS) {
+		stats.issued++;
+		glBindSampler(unit, sampler);
+		return;
+	}
+	if (changed(samplers[unit], sampler))
+		glBindSampler(unit, sampler);
+}
+
+void ME::GLState::setEnabled(GLenum capability, bool enabled) {
+	int slot = capabilitySlot(capability);
+	if (slot >= 0 && !changed(capabilities[slot], enabled ? 1 : 0))
+		return;
+	if (slot < 0)
+		stats.issued++;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void ME::GLState::enable(GLenum capability) {
+	setEnabled(capability, true);
+}
+
+void ME::GLState::disable(GLenum capability) {
+	setEnabled(capability, false);
+}
+
+void ME::GLState::depthFunc(GLenum func) {
+	if (changed(depthFunction, func))
+		glDepthFunc(func);
+}
+
+void ME::GLState::depthMask(bool enabled) {
+	if (changed(depthWrite, enabled ? 1 : 0))
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void ME::GLState::colorMask(bool enabled) {
+	if (changed(colorWrite, enabled ? 1 : 0)) {
+		GLboolean value = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(value, value, value, value);
+	}
+}
+
+void ME::GLState::invalidate() {
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	for (GLuint& buffer : buffers)
+		buffer = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (auto& unit : textures)
+		for (GLuint& texture : unit)
+			texture = UNKNOWN;
+	for (GLuint& sampler : samplers)
+		sampler = UNKNOWN;
+	for (GLuint& capability : capabilities)
+		capability = UNKNOWN;
+	depthFunction = UNKNOWN;
+	depthWrite = UNKNOWN;
+	colorWrite = UNKNOWN;
+}
+
+const ME::GLState::Stats& ME::GLState::getStats() const {
+	return stats;
+}
+
+void ME::GLState::resetStats() {
+	stats = Stats();
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+namespace ME {
+	// Shadow copy of the GL binding state. Calls that would not change anything
+	// are dropped before they reach the driver. Anything that touches GL state
+	// behind this object's back must be followed by invalidate().
+	class GLState {
+	public:
+		static const int MAX_TEXTURE_UNITS = 16;
+		struct Stats {
+			unsigned int issued = 0;
+			unsigned int filtered = 0;
+		};
+	public:
+		GLState();
+		void useProgram(GLuint program);
+		void bindVertexArray(GLuint vao);
+		void bindBuffer(GLenum target, GLuint buffer);
+		void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+		void bindSampler(unsigned int unit, GLuint sampler);
+		void setEnabled(GLenum capability, bool enabled);
+		void enable(GLenum capability);
+		void disable(GLenum capability);
+		void depthFunc(GLenum func);
+		void depthMask(bool enabled);
+		// All four channels at once
+		void colorMask(bool enabled);
+		// Forget everything, the next call of each kind goes through
+		void invalidate();
+		const Stats& getStats() const;
+		void resetStats();
+	private:
+		static const GLuint UNKNOWN = 0xFFFFFFFF;
+		static const int BUFFER_TARGET_COUNT = 7;
+		static const int TEXTURE_TARGET_COUNT = 4;
+		static const int CAPABILITY_COUNT = 7;
+		static int bufferSlot(GLenum target);
+		static int textureSlot(GLenum target);
+		static int capabilitySlot(GLenum capability);
+		bool changed(GLuint& cached, GLuint value);
+		void activeTexture(unsigned int unit);
+
+		GLuint program;
+		GLuint vao;
+		GLuint buffers[BUFFER_TARGET_COUNT];
+		GLuint activeUnit;
+		GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+		GLuint samplers[MAX_TEXTURE_UNITS];
+		GLuint capabilities[CAPABILITY_COUNT];
+		GLuint depthFunction;
+		GLuint depthWrite;
+		GLuint colorWrite;
+		Stats stats;
+	};
+}
@@ -0,0 +1,107 @@
+﻿#include "gpuProfiler.h"
+
+ME::GpuProfiler::GpuProfiler(FrameStats* stats) : stats(stats) {
+	passCount = 0;
+	current = 0;
+	profiling = false;
+	skippedFrames = 0;
+	for (Frame& frame : frames) {
+		glGenQueries(MAX_PASSES * 2, &frame.queries[0][0]);
+		for (auto& pass : frame.issued)
+			pass[0] = pass[1] = false;
+		frame.pending = false;
+	}
+	for (int i = 0; i < MAX_PASSES; i++) {
+		channels[i] = -1;
+		lastTimes[i] = 0;
+	}
+}
+
+ME::GpuProfiler::~GpuProfiler() {
+	for (Frame& frame : frames)
+		glDeleteQueries(MAX_PASSES * 2, &frame.queries[0][0]);
+}
+
+int ME::GpuProfiler::addPass(const char* name) {
+	if (passCount >= MAX_PASSES)
+		return -1;
+	if (stats != nullptr) {
+		int channel = stats->addChannel(name, "ms");
+		if (channel < 0)
+			return -1;
+		channels[passCount] = channel;
+	}
+	return passCount++;
+}
+
+bool ME::GpuProfiler::collect(Frame& frame) {
+	// The end queries were issued last, once they are in so is everything else
+	for (int pass = 0; pass < passCount; pass++) {
+		if (!frame.issued[pass][1])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[pass][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+	}
+	// A pass that did not run that frame took no time, rather than keeping
+	// whatever it took when it last ran
+	for (int pass = 0; pass < passCount; pass++) {
+		lastTimes[pass] = 0.0;
+		if (frame.issued[pass][0] && frame.issued[pass][1]) {
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(frame.queries[pass][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[pass][1], GL_QUERY_RESULT, &end);
+			lastTimes[pass] = end > begin ? (end - begin) / 1e6 : 0.0;
+		}
+		if (stats != nullptr)
+			stats->record(channels[pass], lastTimes[pass]);
+		frame.issued[pass][0] = frame.issued[pass][1] = false;
+	}
+	frame.pending = false;
+	return true;
+}
+
+void ME::GpuProfiler::beginFrame() {
+	// Oldest first, and stop at the first frame that isn't done yet
+	for (int i = 1; i <= FRAMES_IN_FLIGHT; i++) {
+		Frame& frame = frames[(current + i) % FRAMES_IN_FLIGHT];
+		if (frame.pending && !collect(frame))
+			break;
+	}
+	current = (current + 1) % FRAMES_IN_FLIGHT;
+	profiling = !frames[current].pending;
+	if (!profiling)
+		skippedFrames++;
+}
+
+void ME::GpuProfiler::beginPass(int pass) {
+	if (!profiling || pass < 0 || pass >= passCount)
+		return;
+	Frame& frame = frames[current];
+	glQueryCounter(frame.queries[pass][0], GL_TIMESTAMP);
+	frame.issued[pass][0] = true;
+}
+
+void ME::GpuProfiler::endPass(int pass) {
+	if (!profiling || pass < 0 || pass >= passCount)
+		return;
+	Frame& frame = frames[current];
+	glQueryCounter(frame.queries[pass][1], GL_TIMESTAMP);
+	frame.issued[pass][1] = true;
+}
+
+void ME::GpuProfiler::endFrame() {
+	if (profiling)
+		frames[current].pending = true;
+	profiling = false;
+}
+
+unsigned int ME::GpuProfiler::getSkippedFrames() const {
+	return skippedFrames;
+}
+
+double ME::GpuProfiler::getLastTime(int pass) const {
+	return pass >= 0 && pass < passCount ? lastTimes[pass] : 0.0;
+}
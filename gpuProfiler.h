@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include "frameStats.h"
+
+namespace ME {
+	// Times render passes on the GPU with GL_TIMESTAMP query pairs, so passes
+	// may nest or overlap. Queries come from a ring several frames deep and
+	// results are only read once GL reports them available, so the CPU never
+	// waits on the GPU. If the GPU falls that far behind, the frame is simply
+	// not profiled. Pass times are recorded into FrameStats channels when
+	// given some, otherwise read them with getLastTime.
+	class GpuProfiler {
+	public:
+		static const int FRAMES_IN_FLIGHT = 4;
+		static const int MAX_PASSES = 8;
+	public:
+		explicit GpuProfiler(FrameStats* stats = nullptr);
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+		~GpuProfiler();
+		// Returns the pass id, or -1 when out of passes or channels
+		int addPass(const char* name);
+		// Collects whatever results have arrived, then starts a new frame
+		void beginFrame();
+		void beginPass(int pass);
+		void endPass(int pass);
+		void endFrame();
+		// Frames that could not be profiled because their queries were busy
+		unsigned int getSkippedFrames() const;
+		// Latest GPU time of a pass in milliseconds, 0 when the pass did not
+		// run in the latest profiled frame
+		double getLastTime(int pass) const;
+	private:
+		struct Frame {
+			GLuint queries[MAX_PASSES][2];
+			bool issued[MAX_PASSES][2];
+			bool pending;
+		};
+		bool collect(Frame& frame);
+
+		FrameStats* stats;
+		Frame frames[FRAMES_IN_FLIGHT];
+		int channels[MAX_PASSES];
+		double lastTimes[MAX_PASSES];
+		int passCount;
+		int current;
+		bool profiling;
+		unsigned int skippedFrames;
+	};
+}
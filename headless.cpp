@@ -0,0 +1,140 @@
+﻿#include "headless.h"
+
+#ifdef ME_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+#ifndef EGL_NO_CONFIG_KHR
+#define EGL_NO_CONFIG_KHR ((EGLConfig)0)
+#endif
+
+namespace {
+	bool hasEglExtension(const char* extensions, const char* name) {
+		if (extensions == nullptr)
+			return false;
+		size_t length = std::strlen(name);
+		for (const char* found = std::strstr(extensions, name); found != nullptr; found = std::strstr(found + length, name)) {
+			bool starts = found == extensions || found[-1] == ' ';
+			bool ends = found[length] == ' ' || found[length] == '\0';
+			if (starts && ends)
+				return true;
+		}
+		return false;
+	}
+
+	EGLDisplay openDisplay() {
+		const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (hasEglExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+			auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+			if (getPlatformDisplay != nullptr) {
+				EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+				if (display != EGL_NO_DISPLAY)
+					return display;
+			}
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	void* loadProc(const char* name) {
+		return reinterpret_cast<void*>(eglGetProcAddress(name));
+	}
+}
+
+ME::HeadlessContext::HeadlessContext() {
+	display = nullptr;
+	context = nullptr;
+	surface = nullptr;
+	EGLDisplay eglDisplay = openDisplay();
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+		throw HeadlessException("Failed to initialize an EGL display");
+	display = eglDisplay;
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		eglTerminate(eglDisplay);
+		throw HeadlessException("EGL display does not support desktop OpenGL");
+	}
+	const char* extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+	bool surfaceless = hasEglExtension(extensions, "EGL_KHR_surfaceless_context");
+	bool configless = surfaceless && (hasEglExtension(extensions, "EGL_KHR_no_config_context")
+		|| hasEglExtension(extensions, "EGL_MESA_configless_context"));
+	// Without those a 1x1 pbuffer stands in for the window
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	if (!configless) {
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+			EGL_NONE
+		};
+		EGLint configCount = 0;
+		if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			eglTerminate(eglDisplay);
+			throw HeadlessException("No EGL config for desktop OpenGL");
+		}
+	}
+	// Same preference as the window, newest first for multi-draw indirect
+	const EGLint versions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 3 }, { 3, 3 } };
+	EGLContext eglContext = EGL_NO_CONTEXT;
+	for (const EGLint* version : versions) {
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, version[0],
+			EGL_CONTEXT_MINOR_VERSION, version[1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+		if (eglContext != EGL_NO_CONTEXT)
+			break;
+	}
+	if (eglContext == EGL_NO_CONTEXT) {
+		eglTerminate(eglDisplay);
+		throw HeadlessException("Failed to create a 3.3+ core EGL context");
+	}
+	context = eglContext;
+	EGLSurface eglSurface = EGL_NO_SURFACE;
+	if (!surfaceless) {
+		const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+		surface = eglSurface;
+	}
+	if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+		if (eglSurface != EGL_NO_SURFACE)
+			eglDestroySurface(eglDisplay, eglSurface);
+		eglDestroyContext(eglDisplay, eglContext);
+		eglTerminate(eglDisplay);
+		throw HeadlessException("Failed to make the EGL context current");
+	}
+}
+
+ME::HeadlessContext::~HeadlessContext() {
+	if (display == nullptr)
+		return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != nullptr)
+		eglDestroySurface(display, surface);
+	if (context != nullptr)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+	display = nullptr;
+}
+
+GLADloadproc ME::HeadlessContext::getLoader() {
+	return loadProc;
+}
+#else
+ME::HeadlessContext::HeadlessContext() {
+	display = nullptr;
+	context = nullptr;
+	surface = nullptr;
+	throw HeadlessException("Headless mode needs a build with ME_HEADLESS_EGL");
+}
+
+ME::HeadlessContext::~HeadlessContext() {
+}
+
+GLADloadproc ME::HeadlessContext::getLoader() {
+	return nullptr;
+}
+#endif
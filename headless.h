@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include "util.h"
+
+namespace ME {
+	// An OpenGL core context without a window, for machines with no display.
+	// Uses EGL on Mesa's surfaceless platform when available (llvmpipe works
+	// fine), so rendering has to go into a Framebuffer. Only built with the
+	// ME_HEADLESS_EGL option, otherwise constructing one throws.
+	class HeadlessContext {
+	public:
+		// Tries the newest core profile first, down to 3.3. Makes the context
+		// current on the calling thread.
+		HeadlessContext();
+		HeadlessContext(const HeadlessContext&) = delete;
+		HeadlessContext& operator=(const HeadlessContext&) = delete;
+		~HeadlessContext();
+		// For gladLoadGLLoader and GLExtensions::load
+		static GLADloadproc getLoader();
+	private:
+		void* display;
+		void* context;
+		void* surface;
+	};
+
+	class HeadlessException : public ME::MyError {
+	public:
+		HeadlessException(const std::string& message) : MyError(message) {}
+		virtual ~HeadlessException() {}
+	};
+}
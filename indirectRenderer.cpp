@@ -0,0 +1,188 @@
+﻿#include "indirectRenderer.h"
+
+#include <cstdint>
+
+ME::IndirectRenderer::IndirectRenderer(const GLExtensions& extensions, GLState& state, GLsizei maxDrawsPerFrame)
+	: extensions(extensions) {
+	multiDraw = extensions.multiDrawIndirect && extensions.baseInstance;
+	persistent = multiDraw && extensions.bufferStorage;
+	maxDraws = maxDrawsPerFrame;
+	instanceLocation = 0;
+	commandBuffer = 0;
+	mappedCommands = nullptr;
+	mappedInstances = nullptr;
+	for (GLsync& fence : fences)
+		fence = nullptr;
+	frame = 0;
+	drawCount = 0;
+	commandCount = 0;
+	bucketDrawStart = 0;
+	bucketCommandStart = 0;
+
+	GLsizeiptr commandBytes = sizeof(DrawElementsIndirectCommand) * maxDraws * FRAMES_IN_FLIGHT;
+	GLsizeiptr instanceBytes = sizeof(glm::mat4) * maxDraws * FRAMES_IN_FLIGHT;
+	glGenBuffers(1, &instanceBuffer);
+	state.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if (multiDraw) {
+		glGenBuffers(1, &commandBuffer);
+		state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	}
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		extensions.BufferStorage(GL_ARRAY_BUFFER, instanceBytes, nullptr, flags);
+		mappedInstances = static_cast<glm::mat4*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, instanceBytes, flags));
+		extensions.BufferStorage(GL_DRAW_INDIRECT_BUFFER, commandBytes, nullptr, flags);
+		mappedCommands = static_cast<DrawElementsIndirectCommand*>(glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, commandBytes, flags));
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);
+		if (multiDraw)
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, nullptr, GL_STREAM_DRAW);
+		stagingInstances.resize(maxDraws);
+	}
+	// Commands are kept on the CPU side for the instanced fallback as well
+	if (mappedCommands == nullptr)
+		stagingCommands.resize(maxDraws);
+	instanceMemoryID = ResourceRegistry::add(ResourceRegistry::Category::BUFFER, "instance matrices", instanceBytes);
+	commandMemoryID = multiDraw ? ResourceRegistry::add(ResourceRegistry::Category::BUFFER, "indirect commands", commandBytes) : 0;
+	stagingMemoryID = ResourceRegistry::add(ResourceRegistry::Category::CPU, "indirect staging",
+		stagingCommands.capacity() * sizeof(DrawElementsIndirectCommand) + stagingInstances.capacity() * sizeof(glm::mat4));
+}
+
+ME::IndirectRenderer::~IndirectRenderer() {
+	for (GLsync fence : fences) {
+		if (fence != nullptr)
+			glDeleteSync(fence);
+	}
+	if (persistent) {
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+	}
+	glDeleteBuffers(1, &instanceBuffer);
+	if (commandBuffer != 0)
+		glDeleteBuffers(1, &commandBuffer);
+	ResourceRegistry::remove(instanceMemoryID);
+	ResourceRegistry::remove(commandMemoryID);
+	ResourceRegistry::remove(stagingMemoryID);
+}
+
+bool ME::IndirectRenderer::isMultiDraw() const {
+	return multiDraw;
+}
+
+void ME::IndirectRenderer::pointInstanceAttributes(GLuint firstInstance) {
+	for (GLuint column = 0; column < 4; column++) {
+		uintptr_t offset = sizeof(glm::mat4) * firstInstance + sizeof(glm::vec4) * column;
+		glVertexAttribPointer(instanceLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+	}
+}
+
+void ME::IndirectRenderer::attachInstanceAttributes(GLState& state, GLuint vao, GLuint location) {
+	instanceLocation = location;
+	state.bindVertexArray(vao);
+	state.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	pointInstanceAttributes(0);
+	for (GLuint column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(location + column);
+		glVertexAttribDivisor(location + column, 1);
+	}
+}
+
+void ME::IndirectRenderer::beginFrame() {
+	frame = (frame + 1) % FRAMES_IN_FLIGHT;
+	stats = Stats();
+	drawCount = 0;
+	commandCount = 0;
+	bucketDrawStart = 0;
+	bucketCommandStart = 0;
+	// The region about to be rewritten may still be read by the GPU
+	GLsync& fence = fences[frame];
+	if (fence != nullptr) {
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		while (result == GL_TIMEOUT_EXPIRED) {
+			stats.fenceWaits++;
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void ME::IndirectRenderer::addDraw(GLuint count, GLuint firstIndex, GLint baseVertex, const glm::mat4& model) {
+	if (drawCount >= maxDraws) {
+		stats.droppedDraws++;
+		return;
+	}
+	GLuint instance = static_cast<GLuint>(frame * maxDraws + drawCount);
+	if (mappedInstances != nullptr)
+		mappedInstances[instance] = model;
+	else
+		stagingInstances[drawCount] = model;
+	drawCount++;
+	stats.draws++;
+
+	DrawElementsIndirectCommand* commands = mappedCommands != nullptr ? mappedCommands + frame * maxDraws : stagingCommands.data();
+	// Consecutive draws of the same mesh collapse into one instanced command
+	if (commandCount > bucketCommandStart) {
+		DrawElementsIndirectCommand& last = commands[commandCount - 1];
+		if (last.count == count && last.firstIndex == firstIndex && last.baseVertex == baseVertex &&
+			last.baseInstance + last.instanceCount == instance) {
+			last.instanceCount++;
+			return;
+		}
+	}
+	DrawElementsIndirectCommand& command = commands[commandCount++];
+	command.count = count;
+	command.instanceCount = 1;
+	command.firstIndex = firstIndex;
+	command.baseVertex = baseVertex;
+	command.baseInstance = instance;
+	stats.commands++;
+}
+
+void ME::IndirectRenderer::submitBucket(GLState& state, GLenum mode) {
+	GLsizei bucketCommands = commandCount - bucketCommandStart;
+	if (bucketCommands == 0)
+		return;
+	GLsizei bucketDraws = drawCount - bucketDrawStart;
+	GLintptr instanceOffset = sizeof(glm::mat4) * (frame * maxDraws + bucketDrawStart);
+	if (mappedInstances == nullptr) {
+		state.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, instanceOffset, sizeof(glm::mat4) * bucketDraws, stagingInstances.data() + bucketDrawStart);
+	}
+	if (multiDraw) {
+		GLintptr commandOffset = sizeof(DrawElementsIndirectCommand) * (frame * maxDraws + bucketCommandStart);
+		state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		if (mappedCommands == nullptr) {
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, commandOffset, sizeof(DrawElementsIndirectCommand) * bucketCommands,
+				stagingCommands.data() + bucketCommandStart);
+		}
+		extensions.MultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)commandOffset, bucketCommands, 0);
+		stats.drawCalls++;
+	}
+	else {
+		// No baseInstance before 4.2, so the attribute offset is moved instead
+		state.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (GLsizei i = bucketCommandStart; i < commandCount; i++) {
+			const DrawElementsIndirectCommand& command = stagingCommands[i];
+			pointInstanceAttributes(command.baseInstance);
+			uintptr_t indexOffset = sizeof(GLuint) * command.firstIndex;
+			glDrawElementsInstancedBaseVertex(mode, command.count, GL_UNSIGNED_INT, (void*)indexOffset,
+				command.instanceCount, command.baseVertex);
+			stats.drawCalls++;
+		}
+	}
+	bucketDrawStart = drawCount;
+	bucketCommandStart = commandCount;
+}
+
+void ME::IndirectRenderer::endFrame() {
+	if (persistent)
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+const ME::IndirectRenderer::Stats& ME::IndirectRenderer::getStats() const {
+	return stats;
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "glExtensions.h"
+#include "glState.h"
+#include "resourceRegistry.h"
+
+namespace ME {
+	// Layout mandated by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Batches indexed draws that share state into one call per bucket.
+	// Per-draw model matrices are read as a per-instance mat4 attribute, and
+	// each command's baseInstance points it at its own matrix.
+	// On GL 4.3+ commands and matrices are written into persistently mapped,
+	// fenced ring buffers and issued with glMultiDrawElementsIndirect. On
+	// older contexts each command becomes one instanced draw.
+	class IndirectRenderer {
+	public:
+		static const int FRAMES_IN_FLIGHT = 3;
+		struct Stats {
+			unsigned int draws = 0;
+			unsigned int commands = 0;
+			unsigned int drawCalls = 0;
+			unsigned int droppedDraws = 0;
+			unsigned int fenceWaits = 0;
+		};
+	public:
+		IndirectRenderer(const GLExtensions& extensions, GLState& state, GLsizei maxDrawsPerFrame);
+		IndirectRenderer(const IndirectRenderer&) = delete;
+		IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+		~IndirectRenderer();
+		bool isMultiDraw() const;
+		// Feeds the per-draw matrices to attributes location..location+3 of vao
+		void attachInstanceAttributes(GLState& state, GLuint vao, GLuint location);
+		void beginFrame();
+		void addDraw(GLuint count, GLuint firstIndex, GLint baseVertex, const glm::mat4& model);
+		// Issues the draws added since the last submit. The bucket's program,
+		// VAO and textures must already be bound.
+		void submitBucket(GLState& state, GLenum mode);
+		void endFrame();
+		const Stats& getStats() const;
+	private:
+		void pointInstanceAttributes(GLuint firstInstance);
+
+		const GLExtensions& extensions;
+		bool multiDraw;
+		bool persistent;
+		GLsizei maxDraws;
+		GLuint instanceLocation;
+		GLuint commandBuffer;
+		GLuint instanceBuffer;
+		DrawElementsIndirectCommand* mappedCommands;
+		glm::mat4* mappedInstances;
+		std::vector<DrawElementsIndirectCommand> stagingCommands;
+		std::vector<glm::mat4> stagingInstances;
+		ResourceRegistry::ID instanceMemoryID;
+		ResourceRegistry::ID commandMemoryID;
+		ResourceRegistry::ID stagingMemoryID;
+		GLsync fences[FRAMES_IN_FLIGHT];
+		int frame;
+		// Cursors into the current frame's region
+		GLsizei drawCount;
+		GLsizei commandCount;
+		GLsizei bucketDrawStart;
+		GLsizei bucketCommandStart;
+		Stats stats;
+	};
+}
@@ -0,0 +1,194 @@
+﻿#include "inputLog.h"
+
+#include <cstring>
+
+namespace {
+	const char MAGIC[4] = { 'M', 'E', 'I', 'N' };
+	const uint32_t VERSION = 1;
+	// Record tags. A frame's events come right before its FRAME record.
+	const unsigned char TAG_MOUSE = 1;
+	const unsigned char TAG_SCROLL = 2;
+	const unsigned char TAG_FRAME = 3;
+	// Tag, time in microseconds and the payload
+	const size_t MOUSE_SIZE = 1 + 4 + 4 + 4;
+	const size_t SCROLL_SIZE = 1 + 4 + 4;
+	const size_t FRAME_SIZE = 1 + 4 + 4 + 1 + 6 * 4;
+
+	unsigned char* putU32(unsigned char* out, uint32_t value) {
+		out[0] = static_cast<unsigned char>(value);
+		out[1] = static_cast<unsigned char>(value >> 8);
+		out[2] = static_cast<unsigned char>(value >> 16);
+		out[3] = static_cast<unsigned char>(value >> 24);
+		return out + 4;
+	}
+
+	unsigned char* putFloat(unsigned char* out, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return putU32(out, bits);
+	}
+
+	uint32_t getU32(const unsigned char* in) {
+		return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+	}
+
+	float getFloat(const unsigned char* in) {
+		uint32_t bits = getU32(in);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	uint32_t toMicroseconds(double time) {
+		return time > 0 ? static_cast<uint32_t>(time * 1e6) : 0;
+	}
+}
+
+void ME::InputFrame::clear() {
+	deltaTime = 0;
+	keys = 0;
+	events.clear();
+}
+
+void ME::InputFrame::apply(Camera& camera) const {
+	// High rate mice send dozens of events a frame, the direction is rebuilt once
+	for (const Event& event : events) {
+		if (event.type == Event::Type::MOUSE)
+			camera.accumulateMouseMovement(event.x, event.y);
+		else
+			camera.processZooming(event.y);
+	}
+	camera.applyMouseMovement();
+	if (keys & KEY_FORWARD)
+		camera.processCameraMovement(Camera::Direction::FORWARD, deltaTime);
+	if (keys & KEY_BACKWARD)
+		camera.processCameraMovement(Camera::Direction::BACKWARD, deltaTime);
+	if (keys & KEY_LEFT)
+		camera.processCameraMovement(Camera::Direction::LEFT, deltaTime);
+	if (keys & KEY_RIGHT)
+		camera.processCameraMovement(Camera::Direction::RIGHT, deltaTime);
+	if (keys & KEY_DOWN)
+		camera.processCameraMovement(Camera::Direction::DOWN, deltaTime);
+	if (keys & KEY_UP)
+		camera.processCameraMovement(Camera::Direction::UP, deltaTime);
+}
+
+ME::InputRecorder::InputRecorder(const std::string& path) {
+	frameCount = 0;
+	file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		throw InputLogException("Failed to create input log " + path);
+	unsigned char header[8];
+	std::memcpy(header, MAGIC, 4);
+	putU32(header + 4, VERSION);
+	std::fwrite(header, 1, sizeof(header), file);
+}
+
+ME::InputRecorder::~InputRecorder() {
+	std::fclose(file);
+}
+
+void ME::InputRecorder::record(const InputFrame& frame, const Camera& camera) {
+	unsigned char record[FRAME_SIZE];
+	for (const InputFrame::Event& event : frame.events) {
+		unsigned char* out = record;
+		*out++ = event.type == InputFrame::Event::Type::MOUSE ? TAG_MOUSE : TAG_SCROLL;
+		out = putU32(out, toMicroseconds(event.time));
+		if (event.type == InputFrame::Event::Type::MOUSE)
+			out = putFloat(out, event.x);
+		out = putFloat(out, event.y);
+		std::fwrite(record, 1, out - record, file);
+	}
+	unsigned char* out = record;
+	*out++ = TAG_FRAME;
+	out = putU32(out, toMicroseconds(frame.time));
+	out = putFloat(out, frame.deltaTime);
+	*out++ = static_cast<unsigned char>(frame.keys);
+	for (int i = 0; i < 3; i++)
+		out = putFloat(out, camera.getPosition()[i]);
+	for (int i = 0; i < 3; i++)
+		out = putFloat(out, camera.getFront()[i]);
+	std::fwrite(record, 1, out - record, file);
+	frameCount++;
+}
+
+size_t ME::InputRecorder::getFrameCount() const {
+	return frameCount;
+}
+
+ME::InputReplay::InputReplay(const std::string& path) {
+	offset = 8;
+	frameCount = 0;
+	mismatches = 0;
+	recordedPos = glm::vec3(0);
+	recordedFront = glm::vec3(0);
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		throw InputLogException("Failed to open input log " + path);
+	unsigned char buffer[4096];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	std::fclose(file);
+	if (data.size() < 8 || std::memcmp(data.data(), MAGIC, 4) != 0 || getU32(data.data() + 4) != VERSION)
+		throw InputLogException("Not an input log: " + path);
+	// Validate up front so next() never reads past the end
+	size_t position = offset;
+	while (position < data.size()) {
+		unsigned char tag = data[position];
+		size_t size = tag == TAG_MOUSE ? MOUSE_SIZE : tag == TAG_SCROLL ? SCROLL_SIZE : tag == TAG_FRAME ? FRAME_SIZE : 0;
+		if (size == 0 || position + size > data.size())
+			throw InputLogException("Corrupt input log: " + path);
+		if (tag == TAG_FRAME)
+			frameCount++;
+		position += size;
+	}
+}
+
+bool ME::InputReplay::next(InputFrame& frame) {
+	frame.clear();
+	while (offset < data.size()) {
+		const unsigned char* in = data.data() + offset;
+		double time = getU32(in + 1) / 1e6;
+		if (in[0] == TAG_FRAME) {
+			frame.time = time;
+			frame.deltaTime = getFloat(in + 5);
+			frame.keys = in[9];
+			recordedPos = glm::vec3(getFloat(in + 10), getFloat(in + 14), getFloat(in + 18));
+			recordedFront = glm::vec3(getFloat(in + 22), getFloat(in + 26), getFloat(in + 30));
+			offset += FRAME_SIZE;
+			return true;
+		}
+		InputFrame::Event event;
+		event.time = time;
+		if (in[0] == TAG_MOUSE) {
+			event.type = InputFrame::Event::Type::MOUSE;
+			event.x = getFloat(in + 5);
+			event.y = getFloat(in + 9);
+			offset += MOUSE_SIZE;
+		}
+		else {
+			event.type = InputFrame::Event::Type::SCROLL;
+			event.x = 0;
+			event.y = getFloat(in + 5);
+			offset += SCROLL_SIZE;
+		}
+		frame.events.push_back(event);
+	}
+	return false;
+}
+
+bool ME::InputReplay::verify(const Camera& camera) {
+	bool same = camera.getPosition() == recordedPos && camera.getFront() == recordedFront;
+	if (!same)
+		mismatches++;
+	return same;
+}
+
+size_t ME::InputReplay::getFrameCount() const {
+	return frameCount;
+}
+
+size_t ME::InputReplay::getMismatches() const {
+	return mismatches;
+}
@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "util.h"
+
+namespace ME {
+	// Everything that moved the camera during one frame. Events are applied
+	// in order before the held keys move the camera by deltaTime.
+	struct InputFrame {
+		enum Key : uint32_t {
+			KEY_FORWARD = 1 << 0,
+			KEY_BACKWARD = 1 << 1,
+			KEY_LEFT = 1 << 2,
+			KEY_RIGHT = 1 << 3,
+			KEY_DOWN = 1 << 4,
+			KEY_UP = 1 << 5
+		};
+		struct Event {
+			enum class Type : uint8_t { MOUSE, SCROLL };
+			Type type;
+			// Seconds since startup, for reference only
+			double time;
+			// Mouse offsets, or the scroll offset in y
+			float x;
+			float y;
+		};
+		double time = 0;
+		float deltaTime = 0;
+		uint32_t keys = 0;
+		std::vector<Event> events;
+
+		void clear();
+		// Feeds the frame to the camera, the only place input reaches it
+		void apply(Camera& camera) const;
+	};
+
+	// Writes input frames to a compact little-endian binary log. Each frame
+	// also stores the camera pose it produced, so a replay can prove it
+	// followed the same path.
+	class InputRecorder {
+	public:
+		// Throws InputLogException when the file can't be created
+		explicit InputRecorder(const std::string& path);
+		InputRecorder(const InputRecorder&) = delete;
+		InputRecorder& operator=(const InputRecorder&) = delete;
+		~InputRecorder();
+		void record(const InputFrame& frame, const Camera& camera);
+		size_t getFrameCount() const;
+	private:
+		std::FILE* file;
+		size_t frameCount;
+	};
+
+	// Plays a recorded log back frame by frame. The recorded deltas replace
+	// the clock, so the camera takes exactly the same steps as when recorded.
+	class InputReplay {
+	public:
+		// Throws InputLogException when the file is missing or malformed
+		explicit InputReplay(const std::string& path);
+		// False once the log is exhausted
+		bool next(InputFrame& frame);
+		// Compares the camera with the pose recorded for the last frame
+		bool verify(const Camera& camera);
+		size_t getFrameCount() const;
+		// Frames whose pose differed from the recording
+		size_t getMismatches() const;
+	private:
+		std::vector<unsigned char> data;
+		size_t offset;
+		size_t frameCount;
+		glm::vec3 recordedPos;
+		glm::vec3 recordedFront;
+		size_t mismatches;
+	};
+
+	class InputLogException : public ME::MyError {
+	public:
+		InputLogException(const std::string& message) : MyError(message) {}
+		virtual ~InputLogException() {}
+	};
+}
@@ -0,0 +1,362 @@
+﻿#include "lightClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ME_CLUSTERS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ME_CLUSTERS_SSE
+#endif
+
+namespace {
+	// One light against a register of clusters, as in culling.cpp
+#if defined(ME_CLUSTERS_AVX)
+	struct Lanes {
+		static const int WIDTH = 8;
+		typedef __m256 Float;
+		static Float load(const float* p) { return _mm256_loadu_ps(p); }
+		static Float set(float value) { return _mm256_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+		static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+		static Float lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Float both(Float a, Float b) { return _mm256_and_ps(a, b); }
+		static int mask(Float a) { return _mm256_movemask_ps(a); }
+	};
+#elif defined(ME_CLUSTERS_SSE)
+	struct Lanes {
+		static const int WIDTH = 4;
+		typedef __m128 Float;
+		static Float load(const float* p) { return _mm_loadu_ps(p); }
+		static Float set(float value) { return _mm_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+		static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+		static Float lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+		static Float both(Float a, Float b) { return _mm_and_ps(a, b); }
+		static int mask(Float a) { return _mm_movemask_ps(a); }
+	};
+#else
+	// Comparisons give 1 or 0, so both() can multiply
+	struct Lanes {
+		static const int WIDTH = 1;
+		typedef float Float;
+		static Float load(const float* p) { return *p; }
+		static Float set(float value) { return value; }
+		static Float add(Float a, Float b) { return a + b; }
+		static Float sub(Float a, Float b) { return a - b; }
+		static Float mul(Float a, Float b) { return a * b; }
+		static Float max(Float a, Float b) { return a > b ? a : b; }
+		static Float sqrt(Float a) { return std::sqrt(a); }
+		static Float lessEqual(Float a, Float b) { return a <= b ? 1.f : 0.f; }
+		static Float both(Float a, Float b) { return a * b; }
+		static int mask(Float a) { return a != 0.f ? 1 : 0; }
+	};
+#endif
+
+	const int TILES_PER_SLICE = ME::LightClusters::TILES_X * ME::LightClusters::TILES_Y;
+	static_assert(TILES_PER_SLICE % Lanes::WIDTH == 0, "A slice has to fill whole registers");
+}
+
+size_t ME::LightClusters::getFrameBytes(size_t lightCount) {
+	if (lightCount == 0)
+		return 0;
+	lightCount = std::min(lightCount, static_cast<size_t>(MAX_LIGHTS));
+	size_t indices = std::min(static_cast<size_t>(CLUSTER_COUNT) * MAX_LIGHTS_PER_CLUSTER, lightCount * CLUSTER_COUNT);
+	// Plus some alignment padding
+	return lightCount * TEXELS_PER_LIGHT * sizeof(glm::vec4) + CLUSTER_COUNT * 2 * sizeof(uint32_t) +
+		indices * sizeof(uint16_t) + 64;
+}
+
+ME::LightClusters::LightClusters(ThreadPool* pool) : pool(pool) {
+	boundsProjection = glm::vec4(0.0f);
+	nearPlane = 0;
+	farPlane = 0;
+	for (float& depth : sliceNear)
+		depth = 0;
+	for (unsigned int& dropped : sliceDropped)
+		dropped = 0;
+	for (std::vector<float>* bounds : { &clusterMinX, &clusterMinY, &clusterMinZ, &clusterMaxX, &clusterMaxY, &clusterMaxZ,
+		&clusterCenterX, &clusterCenterY, &clusterCenterZ, &clusterRadius })
+		bounds->resize(CLUSTER_COUNT);
+	clusterCounts.resize(CLUSTER_COUNT);
+	clusterSlots.resize(static_cast<size_t>(CLUSTER_COUNT) * MAX_LIGHTS_PER_CLUSTER);
+
+	createTextureBuffer(lightData, GL_RGBA32F, 1024 * TEXELS_PER_LIGHT * sizeof(glm::vec4), "cluster light data");
+	createTextureBuffer(clusterRanges, GL_RG32UI, CLUSTER_COUNT * 2 * sizeof(uint32_t), "cluster ranges");
+	createTextureBuffer(clusterLights, GL_R16UI, 64 * 1024 * sizeof(uint16_t), "cluster light indices");
+	// Every cluster starts out empty
+	std::vector<uint32_t> emptyRanges(CLUSTER_COUNT * 2, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterRanges.buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, emptyRanges.size() * sizeof(uint32_t), emptyRanges.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	uploadedEmpty = true;
+}
+
+ME::LightClusters::~LightClusters() {
+	for (TextureBuffer* textureBuffer : { &lightData, &clusterRanges, &clusterLights }) {
+		glDeleteTextures(1, &textureBuffer->texture);
+		glDeleteBuffers(1, &textureBuffer->buffer);
+		ResourceRegistry::remove(textureBuffer->memoryID);
+	}
+}
+
+void ME::LightClusters::createTextureBuffer(TextureBuffer& textureBuffer, GLenum format, size_t capacity, const char* name) {
+	glGenBuffers(1, &textureBuffer.buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, textureBuffer.buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	glGenTextures(1, &textureBuffer.texture);
+	glBindTexture(GL_TEXTURE_BUFFER, textureBuffer.texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, textureBuffer.buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	textureBuffer.capacity = capacity;
+	textureBuffer.memoryID = ResourceRegistry::add(ResourceRegistry::Category::BUFFER, name, capacity, format);
+}
+
+void ME::LightClusters::uploadTextureBuffer(TextureBuffer& textureBuffer, const void* data, size_t size, GLState& glState) {
+	glState.bindBuffer(GL_TEXTURE_BUFFER, textureBuffer.buffer);
+	if (size > textureBuffer.capacity) {
+		textureBuffer.capacity = std::max(size, textureBuffer.capacity * 2);
+		ResourceRegistry::resize(textureBuffer.memoryID, textureBuffer.capacity);
+	}
+	// Orphaned, so the driver doesn't wait for last frame's draws to finish reading
+	glBufferData(GL_TEXTURE_BUFFER, textureBuffer.capacity, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+void ME::LightClusters::updateClusterBounds(const glm::mat4& projection) {
+	glm::vec4 key(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+	if (key == boundsProjection)
+		return;
+	boundsProjection = key;
+	// Back out of glm::perspective
+	nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	for (int slice = 0; slice <= SLICES; slice++)
+		sliceNear[slice] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / SLICES);
+	for (int slice = 0; slice < SLICES; slice++) {
+		float zNear = sliceNear[slice];
+		float zFar = sliceNear[slice + 1];
+		for (int y = 0; y < TILES_Y; y++) {
+			float bottom = -1.0f + 2.0f * y / TILES_Y;
+			float top = -1.0f + 2.0f * (y + 1) / TILES_Y;
+			for (int x = 0; x < TILES_X; x++) {
+				float left = -1.0f + 2.0f * x / TILES_X;
+				float right = -1.0f + 2.0f * (x + 1) / TILES_X;
+				int cluster = x + TILES_X * (y + TILES_Y * slice);
+				// The tile's edges spread out with the depth
+				glm::vec3 min(std::min(left * zNear, left * zFar) / projection[0][0],
+					std::min(bottom * zNear, bottom * zFar) / projection[1][1], -zFar);
+				glm::vec3 max(std::max(right * zNear, right * zFar) / projection[0][0],
+					std::max(top * zNear, top * zFar) / projection[1][1], -zNear);
+				glm::vec3 center = (min + max) * .5f;
+				clusterMinX[cluster] = min.x;
+				clusterMinY[cluster] = min.y;
+				clusterMinZ[cluster] = min.z;
+				clusterMaxX[cluster] = max.x;
+				clusterMaxY[cluster] = max.y;
+				clusterMaxZ[cluster] = max.z;
+				clusterCenterX[cluster] = center.x;
+				clusterCenterY[cluster] = center.y;
+				clusterCenterZ[cluster] = center.z;
+				clusterRadius[cluster] = glm::length(max - center);
+			}
+		}
+	}
+}
+
+void ME::LightClusters::assignSlice(int slice, size_t lightCount) {
+	// Lights whose sphere reaches into the slice's depth range
+	float zNear = sliceNear[slice];
+	float zFar = sliceNear[slice + 1];
+	uint32_t* candidates = &sliceCandidates[slice * lightCount];
+	size_t candidateCount = 0;
+	for (size_t i = 0; i < lightCount; i++) {
+		float depth = -lightZ[i];
+		candidates[candidateCount] = static_cast<uint32_t>(i);
+		candidateCount += (depth + lightRange[i] > zNear && depth - lightRange[i] < zFar) ? 1 : 0;
+	}
+
+	int first = slice * TILES_PER_SLICE;
+	std::fill(clusterCounts.begin() + first, clusterCounts.begin() + first + TILES_PER_SLICE, 0u);
+	unsigned int dropped = 0;
+	const Lanes::Float zero = Lanes::set(0.f);
+	for (size_t c = 0; c < candidateCount; c++) {
+		uint32_t light = candidates[c];
+		Lanes::Float x = Lanes::set(lightX[light]);
+		Lanes::Float y = Lanes::set(lightY[light]);
+		Lanes::Float z = Lanes::set(lightZ[light]);
+		Lanes::Float range = Lanes::set(lightRange[light]);
+		Lanes::Float rangeSquared = Lanes::mul(range, range);
+		bool spot = lightIsSpot[light] != 0;
+		for (int block = first; block < first + TILES_PER_SLICE; block += Lanes::WIDTH) {
+			// Distance from the light to the closest point of each box
+			Lanes::Float dx = Lanes::add(Lanes::max(Lanes::sub(Lanes::load(&clusterMinX[block]), x), zero),
+				Lanes::max(Lanes::sub(x, Lanes::load(&clusterMaxX[block])), zero));
+			Lanes::Float dy = Lanes::add(Lanes::max(Lanes::sub(Lanes::load(&clusterMinY[block]), y), zero),
+				Lanes::max(Lanes::sub(y, Lanes::load(&clusterMaxY[block])), zero));
+			Lanes::Float dz = Lanes::add(Lanes::max(Lanes::sub(Lanes::load(&clusterMinZ[block]), z), zero),
+				Lanes::max(Lanes::sub(z, Lanes::load(&clusterMaxZ[block])), zero));
+			Lanes::Float distanceSquared = Lanes::add(Lanes::add(Lanes::mul(dx, dx), Lanes::mul(dy, dy)), Lanes::mul(dz, dz));
+			Lanes::Float inside = Lanes::lessEqual(distanceSquared, rangeSquared);
+			if (Lanes::mask(inside) == 0)
+				continue;
+			if (spot) {
+				// Cone against the sphere around the cluster: off to the side,
+				// beyond the range or behind the light
+				Lanes::Float radius = Lanes::load(&clusterRadius[block]);
+				Lanes::Float vx = Lanes::sub(Lanes::load(&clusterCenterX[block]), x);
+				Lanes::Float vy = Lanes::sub(Lanes::load(&clusterCenterY[block]), y);
+				Lanes::Float vz = Lanes::sub(Lanes::load(&clusterCenterZ[block]), z);
+				Lanes::Float lengthSquared = Lanes::add(Lanes::add(Lanes::mul(vx, vx), Lanes::mul(vy, vy)), Lanes::mul(vz, vz));
+				Lanes::Float along = Lanes::add(Lanes::add(Lanes::mul(vx, Lanes::set(lightDirectionX[light])),
+					Lanes::mul(vy, Lanes::set(lightDirectionY[light]))), Lanes::mul(vz, Lanes::set(lightDirectionZ[light])));
+				Lanes::Float across = Lanes::sqrt(Lanes::max(Lanes::sub(lengthSquared, Lanes::mul(along, along)), zero));
+				Lanes::Float closest = Lanes::sub(Lanes::mul(Lanes::set(coneCos[light]), across),
+					Lanes::mul(Lanes::set(coneSin[light]), along));
+				inside = Lanes::both(inside, Lanes::lessEqual(closest, radius));
+				inside = Lanes::both(inside, Lanes::lessEqual(along, Lanes::add(radius, range)));
+				inside = Lanes::both(inside, Lanes::lessEqual(Lanes::sub(zero, radius), along));
+			}
+			int mask = Lanes::mask(inside);
+			for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+				if ((mask & 1) == 0)
+					continue;
+				uint32_t& count = clusterCounts[block + lane];
+				if (count < MAX_LIGHTS_PER_CLUSTER)
+					clusterSlots[static_cast<size_t>(block + lane) * MAX_LIGHTS_PER_CLUSTER + count++] = static_cast<uint16_t>(light);
+				else
+					dropped++;
+			}
+		}
+	}
+	sliceDropped[slice] = dropped;
+}
+
+void ME::LightClusters::assign(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+	int width, int height, FrameArena& arena, LightClusterPacket& packet) {
+	auto start = std::chrono::steady_clock::now();
+	updateClusterBounds(projection);
+	packet = LightClusterPacket();
+	packet.screenScale = glm::vec2(static_cast<float>(TILES_X) / width, static_cast<float>(TILES_Y) / height);
+	float logDepthRange = std::log(farPlane / nearPlane);
+	packet.depthScale = glm::vec2(SLICES / logDepthRange, -SLICES * std::log(nearPlane) / logDepthRange);
+	stats = Stats();
+	size_t lightCount = std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS));
+	if (lightCount == 0)
+		return;
+
+	// Into view space, where the clusters are boxes. The arrays only grow.
+	for (std::vector<float>* component : { &lightX, &lightY, &lightZ, &lightRange, &lightDirectionX,
+		&lightDirectionY, &lightDirectionZ, &coneCos, &coneSin })
+		component->resize(lightCount);
+	lightIsSpot.resize(lightCount);
+	sliceCandidates.resize(SLICES * lightCount);
+	glm::mat3 rotation(view);
+	for (size_t i = 0; i < lightCount; i++) {
+		const Light& light = lights[i];
+		glm::vec4 position = view * glm::vec4(light.position, 1.0f);
+		lightX[i] = position.x;
+		lightY[i] = position.y;
+		lightZ[i] = position.z;
+		lightRange[i] = light.range;
+		// The cone test assumes cones narrower than a half space
+		lightIsSpot[i] = light.type == Light::Type::SPOT && light.outerCutOff > 0;
+		glm::vec3 direction = rotation * light.direction;
+		lightDirectionX[i] = direction.x;
+		lightDirectionY[i] = direction.y;
+		lightDirectionZ[i] = direction.z;
+		coneCos[i] = light.outerCutOff;
+		coneSin[i] = std::sqrt(std::max(1.0f - light.outerCutOff * light.outerCutOff, 0.0f));
+	}
+
+	auto job = [&](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; slice++)
+			assignSlice(static_cast<int>(slice), lightCount);
+	};
+	if (pool != nullptr)
+		pool->parallelFor(SLICES, 1, job);
+	else
+		job(0, SLICES);
+
+	// Pack the fixed size per-cluster slots into one list
+	uint32_t* ranges = arena.allocateArray<uint32_t>(CLUSTER_COUNT * 2);
+	size_t indexCount = 0;
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		ranges[cluster * 2] = static_cast<uint32_t>(indexCount);
+		ranges[cluster * 2 + 1] = clusterCounts[cluster];
+		indexCount += clusterCounts[cluster];
+		stats.busiestCluster = std::max(stats.busiestCluster, clusterCounts[cluster]);
+	}
+	uint16_t* indices = arena.allocateArray<uint16_t>(std::max<size_t>(indexCount, 1));
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		std::memcpy(indices + ranges[cluster * 2], &clusterSlots[static_cast<size_t>(cluster) * MAX_LIGHTS_PER_CLUSTER],
+			clusterCounts[cluster] * sizeof(uint16_t));
+	}
+	// World space for the shader, which lights in world space
+	glm::vec4* lightTexels = arena.allocateArray<glm::vec4>(lightCount * TEXELS_PER_LIGHT);
+	for (size_t i = 0; i < lightCount; i++) {
+		const Light& light = lights[i];
+		bool spot = light.type == Light::Type::SPOT;
+		// A point light is a spot light whose cone always passes
+		glm::vec4* texels = lightTexels + i * TEXELS_PER_LIGHT;
+		texels[0] = glm::vec4(light.position, light.range);
+		texels[1] = glm::vec4(light.color, spot ? light.cutOff : -1.0f);
+		texels[2] = glm::vec4(light.direction, spot ? light.outerCutOff : -2.0f);
+		texels[3] = glm::vec4(static_cast<float>(spot ? light.shadow : -1), 0.0f, 0.0f, 0.0f);
+	}
+	packet.lights = lightTexels;
+	packet.lightCount = lightCount;
+	packet.ranges = ranges;
+	packet.indices = indices;
+	packet.indexCount = indexCount;
+
+	stats.lights = static_cast<unsigned int>(lightCount);
+	stats.references = static_cast<unsigned int>(indexCount);
+	for (unsigned int dropped : sliceDropped)
+		stats.dropped += dropped;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	packet.milliseconds = stats.milliseconds;
+}
+
+void ME::LightClusters::upload(const LightClusterPacket& packet, GLState& glState) {
+	if (packet.lightCount == 0) {
+		if (uploadedEmpty)
+			return;
+		// Zeroed ranges, the light data doesn't matter then
+		glState.bindBuffer(GL_TEXTURE_BUFFER, clusterRanges.buffer);
+		glBufferData(GL_TEXTURE_BUFFER, clusterRanges.capacity, nullptr, GL_STREAM_DRAW);
+		uint32_t* ranges = static_cast<uint32_t*>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, CLUSTER_COUNT * 2 * sizeof(uint32_t),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+		if (ranges != nullptr) {
+			std::memset(ranges, 0, CLUSTER_COUNT * 2 * sizeof(uint32_t));
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+		}
+		uploadedEmpty = true;
+		return;
+	}
+	uploadTextureBuffer(lightData, packet.lights, packet.lightCount * TEXELS_PER_LIGHT * sizeof(glm::vec4), glState);
+	uploadTextureBuffer(clusterRanges, packet.ranges, CLUSTER_COUNT * 2 * sizeof(uint32_t), glState);
+	uploadTextureBuffer(clusterLights, packet.indices, std::max<size_t>(packet.indexCount, 1) * sizeof(uint16_t), glState);
+	uploadedEmpty = false;
+}
+
+void ME::LightClusters::bind(GLState& glState, unsigned int firstUnit) const {
+	glState.bindTexture(firstUnit, GL_TEXTURE_BUFFER, lightData.texture);
+	glState.bindTexture(firstUnit + 1, GL_TEXTURE_BUFFER, clusterRanges.texture);
+	glState.bindTexture(firstUnit + 2, GL_TEXTURE_BUFFER, clusterLights.texture);
+}
+
+const ME::LightClusters::Stats& ME::LightClusters::getStats() const {
+	return stats;
+}
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frameArena.h"
+#include "framePacket.h"
+#include "glState.h"
+#include "resourceRegistry.h"
+#include "threadPool.h"
+
+namespace ME {
+	// A light of the scene besides the camera's flashlight. Nothing beyond
+	// the range is lit, which is what lets it be sorted into clusters.
+	struct Light {
+		enum class Type {
+			POINT,
+			SPOT,
+		};
+		Type type = Type::POINT;
+		glm::vec3 position = glm::vec3(0.0f);
+		float range = 5;
+		glm::vec3 color = glm::vec3(1.0f);
+		// Spot lights only, cosines of the inner and outer cone angles
+		glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		float cutOff = 0;
+		float outerCutOff = 0;
+		// Tile in the ShadowAtlas, -1 casts no shadow
+		int shadow = -1;
+	};
+
+	// Clustered forward lighting. The view frustum is split into a grid of
+	// screen tiles and exponential depth slices, every light is sorted into
+	// the clusters it reaches, and the fragment shader only loops over the
+	// lights of its own cluster. assign() runs on the CPU side and writes
+	// everything the GPU needs into the frame's arena, upload() and bind()
+	// need the GL context and may run on a render thread.
+	class LightClusters {
+	public:
+		static const int TILES_X = 16;
+		static const int TILES_Y = 9;
+		static const int SLICES = 24;
+		static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+		// Lights beyond that in one cluster are dropped and counted
+		static const int MAX_LIGHTS_PER_CLUSTER = 256;
+		// Light indices are 16 bits on the GPU
+		static const size_t MAX_LIGHTS = 65535;
+		// Texels of lightData per light, see lighting.frag
+		static const int TEXELS_PER_LIGHT = 4;
+		struct Stats {
+			unsigned int lights = 0;
+			// Light indices over all clusters
+			unsigned int references = 0;
+			unsigned int busiestCluster = 0;
+			unsigned int dropped = 0;
+			double milliseconds = 0;
+		};
+		// Most a frame can take from the FrameArena with this many lights
+		static size_t getFrameBytes(size_t lightCount);
+	public:
+		// Needs a current context for the buffers
+		explicit LightClusters(ThreadPool* pool = nullptr);
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+		~LightClusters();
+		// Sorts the lights into the clusters of the view. The projection must
+		// be a symmetric perspective, as from Camera. Lights past MAX_LIGHTS
+		// are ignored.
+		void assign(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+			int width, int height, FrameArena& arena, LightClusterPacket& packet);
+		// Copies the packet's lists into the buffer textures
+		void upload(const LightClusterPacket& packet, GLState& glState);
+		// Binds lightData, clusterRanges and clusterLights to three texture
+		// units from firstUnit on
+		void bind(GLState& glState, unsigned int firstUnit) const;
+		const Stats& getStats() const;
+	private:
+		// A buffer and the buffer texture that reads it
+		struct TextureBuffer {
+			GLuint buffer;
+			GLuint texture;
+			size_t capacity;
+			ResourceRegistry::ID memoryID;
+		};
+		void createTextureBuffer(TextureBuffer& textureBuffer, GLenum format, size_t capacity, const char* name);
+		void uploadTextureBuffer(TextureBuffer& textureBuffer, const void* data, size_t size, GLState& glState);
+		void updateClusterBounds(const glm::mat4& projection);
+		void assignSlice(int slice, size_t lightCount);
+
+		ThreadPool* pool;
+		// What the cluster bounds were built for
+		glm::vec4 boundsProjection;
+		float nearPlane;
+		float farPlane;
+		float sliceNear[SLICES + 1];
+		// View space bounds of every cluster, structure-of-arrays, and the
+		// sphere around each box for the spot light cone test
+		std::vector<float> clusterMinX, clusterMinY, clusterMinZ;
+		std::vector<float> clusterMaxX, clusterMaxY, clusterMaxZ;
+		std::vector<float> clusterCenterX, clusterCenterY, clusterCenterZ, clusterRadius;
+		// The lights in view space
+		std::vector<float> lightX, lightY, lightZ, lightRange;
+		std::vector<float> lightDirectionX, lightDirectionY, lightDirectionZ, coneCos, coneSin;
+		std::vector<uint8_t> lightIsSpot;
+		// Lights reaching into each slice, lightCount entries per slice
+		std::vector<uint32_t> sliceCandidates;
+		std::vector<uint32_t> clusterCounts;
+		std::vector<uint16_t> clusterSlots;
+		unsigned int sliceDropped[SLICES];
+		TextureBuffer lightData;
+		TextureBuffer clusterRanges;
+		TextureBuffer clusterLights;
+		// Whether the GPU holds empty lists already, then nothing is uploaded
+		bool uploadedEmpty;
+		Stats stats;
+	};
+}
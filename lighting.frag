@@ -24,13 +24,77 @@ struct Light {
 in vec3 normal; 
 in vec3 fragPos;
 in vec2 textureCoordinate;
+in float viewDepth;
 
 uniform Material material;
 uniform Light light;
 uniform vec3 viewPos;
 
+// Clustered lights, see LightClusters. Four texels per light: position and
+// range, color and inner cone cosine, direction and outer cone cosine, and
+// the shadow tile.
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+uniform samplerBuffer lightData;
+// First index and count of every cluster's lights
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLights;
+// Clusters per pixel, and the scale and bias from log(depth) to slice
+uniform vec2 clusterScreenScale;
+uniform vec2 clusterDepthScale;
+
+// Spot light shadows, see ShadowAtlas. Tiles of -1 cast none.
+const float SHADOW_NORMAL_OFFSET = 0.02;
+uniform sampler2DShadow shadowAtlas;
+// World space to each tile's atlas coordinates and depth
+uniform mat4 shadowMatrices[16];
+uniform int flashlightShadow;
+
 out vec4 fragColor;
 
+float shadow(int tile, vec3 fragPos, vec3 norm)
+{
+    if (tile < 0)
+        return 1.0;
+    // Pushed off the surface along the normal against acne on steep slopes
+    vec4 atlasPos = shadowMatrices[tile] * vec4(fragPos + norm * SHADOW_NORMAL_OFFSET, 1.0);
+    // Behind the light or past its range, the cone or window is zero there anyway
+    if (atlasPos.w <= 0.0 || atlasPos.z > atlasPos.w)
+        return 1.0;
+    return textureProj(shadowAtlas, atlasPos);
+}
+
+vec3 clusteredLights(vec3 norm, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScreenScale), CLUSTER_GRID.xy - 1);
+    int slice = clamp(int(log(viewDepth) * clusterDepthScale.x + clusterDepthScale.y), 0, CLUSTER_GRID.z - 1);
+    int cluster = tile.x + CLUSTER_GRID.x * (tile.y + CLUSTER_GRID.y * slice);
+    uvec2 range = texelFetch(clusterRanges, cluster).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int first = int(texelFetch(clusterLights, int(range.x + i)).x) * 4;
+        vec4 positionRange = texelFetch(lightData, first);
+        vec4 colorCutOff = texelFetch(lightData, first + 1);
+        vec4 directionOuterCutOff = texelFetch(lightData, first + 2);
+        int shadowTile = int(texelFetch(lightData, first + 3).x);
+        vec3 toLight = positionRange.xyz - fragPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / dist;
+        // Falls to exactly zero at the range, so the clusters can skip the light
+        float window = clamp(1.0 - pow(dist / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+        float theta = dot(lightDir, -directionOuterCutOff.xyz);
+        float cone = clamp((theta - directionOuterCutOff.w) / (colorCutOff.w - directionOuterCutOff.w), 0.0, 1.0);
+        float diff = max(dot(norm, lightDir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), material.shininess);
+        float lit = attenuation * cone;
+        // Only lights that reach the fragment pay for the lookup
+        if (shadowTile >= 0 && lit > 0.0)
+            lit *= shadow(shadowTile, fragPos, norm);
+        result += colorCutOff.rgb * (diff * diffuseColor + spec * specularColor) * lit;
+    }
+    return result;
+}
+
 void main()
 {
     // Ambient
@@ -48,7 +112,7 @@ void main()
     // spotlight (soft edges)
     float theta = dot(lightDir, normalize(-light.direction)); 
     float epsilon = (light.cutOff - light.outerCutOff);
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0) * shadow(flashlightShadow, fragPos, norm);
     diffuse *= intensity;
     specular *= intensity;
     // attenuation
@@ -59,5 +123,7 @@ void main()
     specular *= attenuation;
     // result
     vec3 result = ambient + diffuse + specular;
+    result += clusteredLights(norm, viewDir, vec3(texture(material.diffuse, textureCoordinate)),
+        vec3(texture(material.specular, textureCoordinate)));
     fragColor = vec4(result, 1.0);
 }  
\ No newline at end of file
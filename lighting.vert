@@ -10,10 +10,13 @@ uniform mat4 projection;
 out vec3 fragPos;
 out vec3 normal;
 out vec2 textureCoordinate;
+out float viewDepth;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+    viewDepth = -viewPos.z;
     fragPos = vec3(model * vec4(aPos, 1.0));
     normal = mat3(transpose(inverse(model))) * aNormal;
     textureCoordinate = aTextureCoordinate;  
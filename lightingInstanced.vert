@@ -0,0 +1,27 @@
+﻿#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTextureCoordinate;
+// Per-draw model matrix, selected by the draw's base instance
+layout(location = 3) in mat4 aModel;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 fragPos;
+out vec3 normal;
+out vec2 textureCoordinate;
+// Distance along the view direction, picks the light cluster
+out float viewDepth;
+// Must match depthOnly.vert, see there
+invariant gl_Position;
+
+void main()
+{
+    vec4 viewPos = view * aModel * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+    viewDepth = -viewPos.z;
+    fragPos = vec3(aModel * vec4(aPos, 1.0));
+    normal = mat3(transpose(inverse(aModel))) * aNormal;
+    textureCoordinate = aTextureCoordinate;  
+} 
\ No newline at end of file
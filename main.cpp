@@ -6,28 +6,83 @@
 
 #include <iostream>
 #include <memory>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <algorithm>
+#include <vector>
 
+#include "allocTracker.h"
 #include "camera.h"
-#include "shader.h"
-#include "stb_image.h"
-#include "texture.h"
-#include "vertices.h"
+#include "frameReport.h"
+#include "frameStats.h"
+#include "framebuffer.h"
+#include "frameScheduler.h"
+#include "glExtensions.h"
+#include "headless.h"
+#include "inputLog.h"
+#include "profiler.h"
+#include "renderThread.h"
+#include "resourceRegistry.h"
+#include "sceneRenderer.h"
 
 const int WIDTH = 1920;
 const int HEIGHT = 1080;
+const char* TRACE_PATH = "trace.json";
+// Recordings only replay exactly with the same camera settings
+const float MOVEMENT_SPEED = 2;
+// What F4 aims for when --frame-budget doesn't say
+const double DEFAULT_FRAME_BUDGET = 1000.0 / 60.0;
+
+struct Options {
+	bool headless = false;
+	// Windowed frames are submitted by a render thread unless --single-thread
+	bool renderThread = true;
+	int width = WIDTH;
+	int height = HEIGHT;
+	int frames = 600;
+	int warmupFrames = 30;
+	size_t cubes = ME::SceneRenderer::BASE_CUBE_COUNT;
+	// Clustered lights besides the flashlight
+	size_t lights = 0;
+	ME::ShadingPath shading = ME::ShadingPath::FORWARD;
+	bool depthPrepass = false;
+	bool shadowCache = true;
+	bool occlusion = false;
+	// GPU milliseconds per frame the resolution adapts to, 0 for none
+	double frameBudget = 0.0;
+	std::string reportPath = "report.json";
+	std::string recordPath;
+	std::string replayPath;
+	double updateRate = 120.0;
+	double frameCap = 0.0;
+	// What an allocation inside an armed frame does, tracking builds only
+	ME::AllocTracker::Mode allocMode = ME::AllocTracker::Mode::LOG;
+};
 
 ME::Camera camera = ME::Camera();
+// Mouse and scroll events wait here until processInput applies them
+ME::InputFrame pendingInput;
+// The renderer sets the viewport from these, on whichever thread owns the context
+int framebufferWidth = WIDTH;
+int framebufferHeight = HEIGHT;
+// F2 to F5 flip these, the renderer picks them up with the next packet
+ME::ShadingPath shadingPath = ME::ShadingPath::FORWARD;
+bool depthPrepass = false;
+bool dynamicResolution = false;
+bool occlusionCulling = false;
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+	framebufferWidth = width;
+	framebufferHeight = height;
 }
 void mouseCallback(GLFWwindow* window, double xPos, double yPos)
 {
 	static float lastX, lastY;
-	static bool firstMouse;
+	static bool firstMouse = true;
 	if (firstMouse)
 	{
 		lastX = xPos;
@@ -39,58 +94,350 @@ void mouseCallback(GLFWwindow* window, double xPos, double yPos)
 	float yOffset = lastY - yPos;
 	lastX = xPos;
 	lastY = yPos;
-	camera.processMouseMovement(xOffset, yOffset);
+	pendingInput.events.push_back({ ME::InputFrame::Event::Type::MOUSE, glfwGetTime(), xOffset, yOffset });
 }
 void scrollCallback(GLFWwindow* window, double xOffset, double yOffset)
 {
-	camera.processZooming(yOffset);
+	pendingInput.events.push_back({ ME::InputFrame::Event::Type::SCROLL, glfwGetTime(), 0.0f, static_cast<float>(yOffset) });
 }
 
-void processInput(GLFWwindow* window) {
+// Handles the window keys and samples the movement keys for the coming updates
+void pollInput(GLFWwindow* window) {
+	ME_PROFILE_FUNCTION();
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
+#ifdef ME_ENABLE_PROFILING
+	// F9 dumps the trace so far and starts a new one
+	static bool traceKeyDown = false;
+	bool traceKey = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+	if (traceKey && !traceKeyDown) {
+		if (ME::Profiler::writeChromeTrace(TRACE_PATH))
+			std::cout << "Wrote " << TRACE_PATH << std::endl;
+		ME::Profiler::startCapture();
+	}
+	traceKeyDown = traceKey;
+#endif
+	// F10 prints where GPU and CPU memory goes
+	static bool memoryKeyDown = false;
+	bool memoryKey = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+	if (memoryKey && !memoryKeyDown)
+		ME::ResourceRegistry::dump(stdout);
+	memoryKeyDown = memoryKey;
+	// F2 switches between forward and deferred shading
+	static bool shadingKeyDown = false;
+	bool shadingKey = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+	if (shadingKey && !shadingKeyDown)
+		shadingPath = shadingPath == ME::ShadingPath::FORWARD ? ME::ShadingPath::DEFERRED : ME::ShadingPath::FORWARD;
+	shadingKeyDown = shadingKey;
+	// F3 toggles the depth pre-pass
+	static bool prepassKeyDown = false;
+	bool prepassKey = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+	if (prepassKey && !prepassKeyDown)
+		depthPrepass = !depthPrepass;
+	prepassKeyDown = prepassKey;
+	// F4 toggles dynamic resolution
+	static bool resolutionKeyDown = false;
+	bool resolutionKey = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+	if (resolutionKey && !resolutionKeyDown)
+		dynamicResolution = !dynamicResolution;
+	resolutionKeyDown = resolutionKey;
+	// F5 toggles occlusion culling
+	static bool occlusionKeyDown = false;
+	bool occlusionKey = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+	if (occlusionKey && !occlusionKeyDown)
+		occlusionCulling = !occlusionCulling;
+	occlusionKeyDown = occlusionKey;
 
-	// Handle camera movemont
+	pendingInput.time = glfwGetTime();
+	pendingInput.keys = 0;
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_FORWARD;
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_BACKWARD;
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_LEFT;
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_RIGHT;
+	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_DOWN;
+	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+		pendingInput.keys |= ME::InputFrame::KEY_UP;
+}
 
-	float currentTime = glfwGetTime();
-	static float lastTime = -1;
-	if (lastTime < 0) {
-		lastTime = currentTime;
+// One fixed update of the camera, from the live input or the next frame of a replay.
+// Returns false once the replay has run out.
+bool updateCamera(float stepDuration, ME::InputRecorder* recorder, ME::InputReplay* replay) {
+	if (replay != nullptr) {
+		// Live input is dropped, the log drives the camera
+		pendingInput.events.clear();
+		static ME::InputFrame replayInput;
+		if (!replay->next(replayInput))
+			return false;
+		replayInput.apply(camera);
+		replay->verify(camera);
+		return true;
 	}
-	float deltaTime = currentTime - lastTime;
-	lastTime = currentTime;
+	pendingInput.deltaTime = stepDuration;
+	pendingInput.apply(camera);
+	if (recorder != nullptr)
+		recorder->record(pendingInput, camera);
+	// Keys stay held for the remaining steps, events only happen once
+	pendingInput.events.clear();
+	return true;
+}
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::FORWARD, deltaTime);
+void printUsage() {
+	std::cout << "Usage: main [--headless] [--width W] [--height H] [--cubes N]\n"
+		"            [--lights N] [--shading forward|deferred] [--depth-prepass]\n"
+		"            [--shadow-cache on|off] [--frame-budget MS] [--occlusion on|off]\n"
+		"            [--frames N] [--warmup N] [--report report.json|report.csv]\n"
+		"            [--record input.bin] [--replay input.bin]\n"
+		"            [--update-rate HZ] [--fps-cap FPS] [--alloc-check count|log|abort]\n"
+		"            [--single-thread]\n"
+		"--headless renders N scripted frames offscreen and writes a report\n"
+		"--replay drives the camera from a recorded input log instead\n"
+		"--lights adds N moving point and spot lights, up to 65535\n"
+		"--shading picks the lighting path, F2 switches it in the window\n"
+		"--depth-prepass draws depth first so only visible fragments are shaded, F3 in the window\n"
+		"--shadow-cache off draws every shadow map from scratch each frame\n"
+		"--frame-budget lowers the resolution to keep GPU frames under MS, F4 in the window\n"
+		"--occlusion on drops cubes hidden behind the biggest ones on the CPU, F5 in the window\n"
+		"--fps-cap 0, the default, renders as fast as possible\n"
+		"--single-thread submits GL from the main thread instead of a render thread\n"
+		"--alloc-check decides what an allocation after warm-up does, needs ME_TRACK_ALLOCATIONS\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (std::strcmp(argument, "--headless") == 0) {
+			options.headless = true;
+			continue;
+		}
+		if (std::strcmp(argument, "--single-thread") == 0) {
+			options.renderThread = false;
+			continue;
+		}
+		if (std::strcmp(argument, "--depth-prepass") == 0) {
+			options.depthPrepass = true;
+			continue;
+		}
+		if (value == nullptr)
+			return false;
+		if (std::strcmp(argument, "--width") == 0)
+			options.width = std::atoi(value);
+		else if (std::strcmp(argument, "--height") == 0)
+			options.height = std::atoi(value);
+		else if (std::strcmp(argument, "--frames") == 0)
+			options.frames = std::atoi(value);
+		else if (std::strcmp(argument, "--warmup") == 0)
+			options.warmupFrames = std::atoi(value);
+		else if (std::strcmp(argument, "--cubes") == 0)
+			options.cubes = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(argument, "--lights") == 0)
+			options.lights = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(argument, "--report") == 0)
+			options.reportPath = value;
+		else if (std::strcmp(argument, "--record") == 0)
+			options.recordPath = value;
+		else if (std::strcmp(argument, "--replay") == 0)
+			options.replayPath = value;
+		else if (std::strcmp(argument, "--update-rate") == 0)
+			options.updateRate = std::atof(value);
+		else if (std::strcmp(argument, "--fps-cap") == 0)
+			options.frameCap = std::atof(value);
+		else if (std::strcmp(argument, "--frame-budget") == 0)
+			options.frameBudget = std::atof(value);
+		else if (std::strcmp(argument, "--shading") == 0) {
+			if (std::strcmp(value, "forward") == 0)
+				options.shading = ME::ShadingPath::FORWARD;
+			else if (std::strcmp(value, "deferred") == 0)
+				options.shading = ME::ShadingPath::DEFERRED;
+			else
+				return false;
+		}
+		else if (std::strcmp(argument, "--shadow-cache") == 0) {
+			if (std::strcmp(value, "on") == 0)
+				options.shadowCache = true;
+			else if (std::strcmp(value, "off") == 0)
+				options.shadowCache = false;
+			else
+				return false;
+		}
+		else if (std::strcmp(argument, "--occlusion") == 0) {
+			if (std::strcmp(value, "on") == 0)
+				options.occlusion = true;
+			else if (std::strcmp(value, "off") == 0)
+				options.occlusion = false;
+			else
+				return false;
+		}
+		else if (std::strcmp(argument, "--alloc-check") == 0) {
+			if (std::strcmp(value, "count") == 0)
+				options.allocMode = ME::AllocTracker::Mode::COUNT;
+			else if (std::strcmp(value, "log") == 0)
+				options.allocMode = ME::AllocTracker::Mode::LOG;
+			else if (std::strcmp(value, "abort") == 0)
+				options.allocMode = ME::AllocTracker::Mode::ABORT;
+			else
+				return false;
+		}
+		else
+			return false;
+		i++;
 	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::BACKWARD, deltaTime);
+	if (!options.recordPath.empty() && (options.headless || !options.replayPath.empty()))
+		return false;
+	return options.width > 0 && options.height > 0 && options.frames > 0 && options.warmupFrames >= 0
+		&& options.updateRate > 0 && options.frameCap >= 0 && options.frameBudget >= 0;
+}
+
+// Orbits the scene at a fixed rate per frame, so every run renders the same images
+void scriptCamera(ME::Camera& camera, int frame) {
+	const glm::vec3 center(0.0f, 0.0f, -10.0f);
+	const float radius = 16.0f;
+	float angle = frame * glm::radians(0.5f);
+	camera.setPosition(center + glm::vec3(std::sin(angle) * radius, 3.0f, std::cos(angle) * radius));
+	camera.setFront(center - camera.getPosition());
+}
+
+int runHeadless(const Options& options) {
+	std::unique_ptr<ME::HeadlessContext> context;
+	try {
+		context = std::make_unique<ME::HeadlessContext>();
 	}
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::LEFT, deltaTime);
+	catch (const ME::HeadlessException& e) {
+		std::cerr << "Error on creating headless context: " << e.what() << std::endl;
+		return -1;
 	}
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::RIGHT, deltaTime);
+	if (!gladLoadGLLoader(ME::HeadlessContext::getLoader())) {
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
 	}
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::DOWN, deltaTime);
+	ME::GLExtensions glExtensions;
+	glExtensions.load(ME::HeadlessContext::getLoader());
+	// GL objects go before the context does
+	try {
+		ME::Framebuffer target(options.width, options.height);
+		ME::FrameStats frameStats(0.0);
+		ME::SceneRenderer renderer(glExtensions, frameStats, options.cubes, options.lights);
+		renderer.setShadingPath(options.shading);
+		renderer.setDepthPrepass(options.depthPrepass);
+		renderer.setShadowCaching(options.shadowCache);
+		renderer.setFrameBudget(options.frameBudget);
+		renderer.setOcclusionCulling(options.occlusion);
+		ME::Camera camera;
+		camera.setViewport(options.width, options.height);
+		std::unique_ptr<ME::InputReplay> replay;
+		ME::InputFrame input;
+		if (!options.replayPath.empty()) {
+			replay = std::make_unique<ME::InputReplay>(options.replayPath);
+			camera.setMovementSpeed(MOVEMENT_SPEED);
+		}
+		ME::FrameReport report({ "frame", "frame ms", "gpu ms", "cull ms", "draws", "draw calls",
+			"state changes", "gl calls", "gl filtered", "culled", "allocs",
+			"lights ms", "light refs", "fragments", "shadow renders", "shadow casters", "resolution scale",
+			"occluded", "occluded %", "occlusion ms", "dropped draws" });
+		report.reserve(options.frames);
+		report.setMetadata("renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		report.setMetadata("version", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+		report.setMetadata("width", std::to_string(options.width));
+		report.setMetadata("height", std::to_string(options.height));
+		report.setMetadata("frames", std::to_string(options.frames));
+		report.setMetadata("warmup", std::to_string(options.warmupFrames));
+		report.setMetadata("cubes", std::to_string(renderer.getCubeCount()));
+		report.setMetadata("lights", std::to_string(renderer.getLightCount()));
+		report.setMetadata("shading", ME::SceneRenderer::getShadingPathName(options.shading));
+		report.setMetadata("depth prepass", options.depthPrepass ? "on" : "off");
+		report.setMetadata("shadow cache", options.shadowCache ? "on" : "off");
+		report.setMetadata("frame budget ms", std::to_string(options.frameBudget));
+		report.setMetadata("occlusion culling", options.occlusion ? ME::OcclusionCuller::getInstructionSet() : "off");
+		report.setMetadata("submission", renderer.isMultiDraw() ? "multi-draw indirect" : "instanced");
+		report.setMetadata("camera", replay ? options.replayPath : "orbit");
+		report.setMetadata("allocation tracking", ME::AllocTracker::isEnabled() ? "on" : "off");
+		ME::ResourceRegistry::Totals memory = ME::ResourceRegistry::getTotals();
+		report.setMetadata("gpu memory KB", std::to_string(memory.gpuBytes / 1024));
+		report.setMetadata("cpu memory KB", std::to_string(memory.cpuBytes / 1024));
+		int frames = options.frames;
+		for (int frame = -options.warmupFrames; frame < frames; frame++) {
+			ME_PROFILE_SCOPE("frame");
+			if (frame == 0)
+				ME::AllocTracker::arm();
+			auto begin = std::chrono::steady_clock::now();
+			uint64_t allocations = ME::AllocTracker::getTotal().allocations;
+			if (!replay) {
+				scriptCamera(camera, frame);
+			}
+			// Warmup frames look at the starting pose
+			else if (frame >= 0) {
+				if (!replay->next(input)) {
+					frames = frame;
+					break;
+				}
+				input.apply(camera);
+				replay->verify(camera);
+			}
+			target.bind();
+			{
+				ME::AllocFrameScope allocScope;
+				renderer.render(camera);
+			}
+			// Nothing presents the frame, so wait for it to be done instead
+			glFinish();
+			allocations = ME::AllocTracker::getTotal().allocations - allocations;
+			double frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			if (frame < 0)
+				continue;
+			const ME::SceneRenderer::Stats& stats = renderer.getStats();
+			double row[] = { static_cast<double>(frame), frameMilliseconds, stats.gpuMilliseconds, stats.cullMilliseconds,
+				static_cast<double>(stats.draws), static_cast<double>(stats.drawCalls), static_cast<double>(stats.stateChanges),
+				static_cast<double>(stats.glCalls), static_cast<double>(stats.glFiltered), static_cast<double>(stats.culled),
+				static_cast<double>(allocations), stats.lightMilliseconds, static_cast<double>(stats.lightReferences),
+				static_cast<double>(stats.shadedFragments), static_cast<double>(stats.shadowRenders),
+				static_cast<double>(stats.shadowCasters), stats.resolutionScale, static_cast<double>(stats.occluded),
+				stats.occludedFraction * 100.0, stats.occlusionMilliseconds, static_cast<double>(stats.droppedDraws) };
+			report.addRow(row);
+		}
+		report.write(options.reportPath);
+		ME::FrameStats::Summary frameTime = report.summarize(1);
+		if (replay)
+			std::printf("Replayed %d frames, %zu off the recorded path\n", frames, replay->getMismatches());
+		std::printf("%d frames at %dx%d: mean %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f ms, wrote %s\n",
+			frames, options.width, options.height, frameTime.mean, frameTime.p50, frameTime.p95,
+			frameTime.p99, frameTime.max, options.reportPath.c_str());
+		if (ME::AllocTracker::isEnabled())
+			std::printf("%zu allocations inside frames after warm-up\n", ME::AllocTracker::getViolations());
+		ME::ResourceRegistry::dump(stdout);
 	}
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-		camera.processCameraMovement(ME::Camera::Direction::UP, deltaTime);
+	catch (const ME::MyError& e) {
+		std::cerr << "Error on running headless: " << e.what() << std::endl;
+		return -1;
 	}
+	return 0;
 }
 
-int main() {
-	camera.setMovementSpeed(2);
+int runWindowed(const Options& options) {
+	camera.setMovementSpeed(MOVEMENT_SPEED);
+	shadingPath = options.shading;
+	depthPrepass = options.depthPrepass;
+	dynamicResolution = options.frameBudget > 0;
+	occlusionCulling = options.occlusion;
+	double frameBudget = options.frameBudget > 0 ? options.frameBudget : DEFAULT_FRAME_BUDGET;
 	// Initialization
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	// Create a window
-	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "LearnOpenGL", NULL, NULL);
+	// Create a window, preferring a 4.6 context for multi-draw indirect
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	GLFWwindow* window = glfwCreateWindow(options.width, options.height, "LearnOpenGL", NULL, NULL);
+	if (window == NULL) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(options.width, options.height, "LearnOpenGL", NULL, NULL);
+	}
 	if (window == NULL) {
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -102,159 +449,148 @@ int main() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	ME::GLExtensions glExtensions;
+	glExtensions.load((GLADloadproc)glfwGetProcAddress);
 
-	// Set the viewport
-	glViewport(0, 0, WIDTH, HEIGHT);
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+	// Room for a frame of an 8000 Hz mouse, so the callbacks don't allocate
+	pendingInput.events.reserve(1024);
 	glfwSetCursorPosCallback(window, mouseCallback);
 	glfwSetScrollCallback(window, scrollCallback);
-	// Set the rendering mode
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	// Enable depth testing
-	glEnable(GL_DEPTH_TEST);
 
-	// Setting up VBO
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	// Setting up light VAO
-	GLuint sceneVAO;
-	glGenVertexArrays(1, &sceneVAO);
-	glBindVertexArray(sceneVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	// Setting up cube VAO
-	GLuint lightCubeVAO;
-	glGenVertexArrays(1, &lightCubeVAO);
-	glBindVertexArray(lightCubeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+	// The renderer's GL objects have to go before glfwTerminate
+	{
+		std::unique_ptr<ME::SceneRenderer> renderer;
+		std::unique_ptr<ME::InputRecorder> recorder;
+		std::unique_ptr<ME::InputReplay> replay;
+		// Frame statistics, published to the title twice a second
+		ME::FrameStats frameStats(2.0);
+		try {
+			renderer = std::make_unique<ME::SceneRenderer>(glExtensions, frameStats, options.cubes, options.lights);
+			renderer->setShadowCaching(options.shadowCache);
+			if (!options.recordPath.empty())
+				recorder = std::make_unique<ME::InputRecorder>(options.recordPath);
+			if (!options.replayPath.empty())
+				replay = std::make_unique<ME::InputReplay>(options.replayPath);
+		}
+		catch (const ME::MyError& e) {
+			std::cerr << "Error on setting up the scene:\n" << e.what() << '\n';
+			glfwTerminate();
+			return -1;
+		}
+		// Declared after the renderer, so it stops and hands the context back first
+		std::unique_ptr<ME::RenderThread> renderThread;
+		if (options.renderThread)
+			renderThread = std::make_unique<ME::RenderThread>(window, *renderer);
+		const int updatesChannel = frameStats.addChannel("updates");
+		const int allocsChannel = frameStats.addChannel("allocs");
+		int frameCount = 0;
+		char title[512];
+		// Fixed rate camera updates, rendered in between
+		ME::FrameScheduler scheduler(options.updateRate, options.frameCap);
+		ME::Camera previousCamera = camera;
+		while (!glfwWindowShouldClose(window)) {
+			ME_PROFILE_SCOPE("frame");
+			if (frameCount++ == options.warmupFrames)
+				ME::AllocTracker::arm();
+			uint64_t allocations = ME::AllocTracker::getTotal().allocations;
+			int steps = scheduler.beginFrame();
+			pollInput(window);
+			renderer->setShadingPath(shadingPath);
+			renderer->setDepthPrepass(depthPrepass);
+			renderer->setFrameBudget(dynamicResolution ? frameBudget : 0.0);
+			renderer->setOcclusionCulling(occlusionCulling);
+			camera.setViewport(framebufferWidth, framebufferHeight);
+			// Title, swap and polling belong to GLFW and the driver, the rest must not allocate
+			ME::AllocTracker::enterFrameScope();
+			for (int step = 0; step < steps; step++) {
+				previousCamera = camera;
+				if (!updateCamera(static_cast<float>(scheduler.getStepDuration()), recorder.get(), replay.get())) {
+					glfwSetWindowShouldClose(window, true);
+					break;
+				}
+			}
+			frameStats.record(updatesChannel, steps);
+			// A camera at rest is rendered as is and keeps its cached matrices
+			ME::Camera interpolatedCamera;
+			const ME::Camera* renderCamera = &camera;
+			if (previousCamera.getVersion() != camera.getVersion()) {
+				interpolatedCamera = ME::Camera::interpolate(previousCamera, camera, static_cast<float>(scheduler.getAlpha()));
+				renderCamera = &interpolatedCamera;
+			}
+			// Pick what the crosshair looks at
+			ME::RayHit pickHit;
+			bool picked = renderer->pick({ renderCamera->getPosition(), renderCamera->getFront() }, pickHit);
+			ME::AllocTracker::leaveFrameScope();
+			if (frameStats.tick()) {
+				size_t length = frameStats.format(title, sizeof(title));
+				std::snprintf(title + length, sizeof(title) - length, " | %s%s%s | %d%% resolution | looking at: %d",
+					ME::SceneRenderer::getShadingPathName(shadingPath), depthPrepass ? " + depth pre-pass" : "",
+					occlusionCulling ? " + occlusion culling" : "",
+					static_cast<int>(std::lround(renderer->getResolutionScale() * 100.0f)), picked ? static_cast<int>(pickHit.object) : -1);
+				glfwSetWindowTitle(window, title);
+			}
+			// Nothing to draw into while minimized
+			bool visible = framebufferWidth > 0 && framebufferHeight > 0;
+			if (renderThread && visible) {
+				// Overlaps with the render thread drawing the previous packet
+				ME::FramePacket& packet = renderThread->beginPacket();
+				{
+					ME::AllocFrameScope allocScope;
+					renderer->prepare(*renderCamera, packet);
+				}
+				renderThread->publish();
+				ME::SceneRenderer::Stats renderStats;
+				if (renderThread->getStats(renderStats))
+					renderer->recordStats(renderStats);
+			}
+			else if (visible) {
+				ME::AllocFrameScope allocScope;
+				renderer->render(*renderCamera);
+			}
 
-	// Loading textures
-	std::unique_ptr<ME::Texture> diffuseTexture;
-	try {
-		std::unique_ptr<ME::Texture> tempTexure = std::make_unique<ME::Texture>("container2.png");
-		diffuseTexture = std::move(tempTexure);
-	}
-	catch (ME::MyError e) {
-		std::cerr << "Error on loading diffuse texture:" << e.what() << std::endl;
-	}
-	std::unique_ptr<ME::Texture> specularTexture;
-	try {
-		std::unique_ptr<ME::Texture> tempTexure = std::make_unique<ME::Texture>("container2_specular.png");
-		specularTexture = std::move(tempTexure);
-	}
-	catch (ME::MyError e) {
-		std::cerr << "Error on loading specular texture:" << e.what() << std::endl;
+			// Backprocessing
+			{
+				ME_PROFILE_SCOPE("frame cap");
+				scheduler.waitForNextFrame();
+			}
+			if (!renderThread) {
+				ME_PROFILE_SCOPE("swap");
+				glfwSwapBuffers(window);
+			}
+			{
+				ME_PROFILE_SCOPE("poll events");
+				glfwPollEvents();
+			}
+			frameStats.record(allocsChannel, static_cast<double>(ME::AllocTracker::getTotal().allocations - allocations));
+		}
+		if (recorder)
+			std::cout << "Recorded " << recorder->getFrameCount() << " frames to " << options.recordPath << std::endl;
+		if (replay)
+			std::cout << "Replay went off the recorded path on " << replay->getMismatches() << " frames" << std::endl;
+		if (ME::AllocTracker::isEnabled())
+			std::cout << ME::AllocTracker::getViolations() << " allocations inside frames after warm-up" << std::endl;
 	}
+	glfwTerminate();
+	return 0;
+}
 
-	// Create and compile shaders
-	std::unique_ptr<ME::Shader> lightingShader;
-	try {
-		lightingShader = std::make_unique<ME::Shader>("lighting.vert", "lighting.frag");
-	}
-	catch (const ME::ShaderException &e) {
-		std::cerr << "Error on creating shader:\n" << e.what() << '\n';
+int main(int argc, char** argv) {
+	ME_PROFILE_THREAD("main");
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
 		return -1;
 	}
-	std::unique_ptr<ME::Shader> lightCubeShader;
-	try {
-		lightCubeShader = std::make_unique<ME::Shader>("lightCube.vert", "lightCube.frag");
-	}
-	catch (const ME::ShaderException& e) {
-		std::cerr << "Error on creating shader:\n" << e.what() << '\n';
-		return -1;
-	}
-
-	lightingShader->use();
-	// Setting block materials
-	lightingShader->setFloat("material.shininess", 16.f);
-	// Setting light colors
-	lightingShader->setVec3("light.specular", glm::vec3(1.f, 1.f, 1.f)); 
-	// fps
-	int frameCount = 0;
-	double startTime = glfwGetTime();
-	// calculating light rotation
-	glm::vec3 rotateCenter(1.f, 2, .5f);
-	float rotateRadius = 2.0f;
-	float lastTime = glfwGetTime();
-	float rotateSpeed = 2;
-	float theta = 0;
-	while (!glfwWindowShouldClose(window)) {
-		// Calculate fps
-		frameCount++;
-		double fps = frameCount / (glfwGetTime() - startTime);
-		std::string title = std::string("fps: ") + std::to_string(fps);
-		glfwSetWindowTitle(window, title.c_str());
-		// Process input
-		processInput(window);
-		// Clear the screen	
-		glClearColor(0, 0, 0, 1);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Drawing triangles
-		// Setting view, and projection matrix
-		glm::mat4 view = camera.getViewMatrix();
-		glm::mat4 projection = camera.getProjectionMatrix(WIDTH, HEIGHT);
-		// 渲染场景模型
-		// Passing MVP matrices
-		lightingShader->use();
-		// Setting light properties
-		lightingShader->setVec3("light.position",  camera.pos);
-		lightingShader->setVec3("light.direction", camera.front);
-		lightingShader->setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
-		lightingShader->setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
-		glm::vec3 lightColor = glm::vec3(1.0f);
-		glm::vec3 diffuseColor = lightColor; 
-		glm::vec3 ambientColor = diffuseColor * .3f; 
-		lightingShader->setVec3("light.ambient", ambientColor);
-		lightingShader->setVec3("light.diffuse", diffuseColor);
-		lightingShader->setFloat("light.constant", 1.0f);
-        lightingShader->setFloat("light.linear", 0.09f);
-        lightingShader->setFloat("light.quadratic", 0.032f);
-		// Passing camera position and view and projection matrices
-		lightingShader->setVec3("viewPos", camera.pos); 
-		lightingShader->setMatrix4f("view", view);
-		lightingShader->setMatrix4f("projection", projection);
-		// Using texture
-		glBindVertexArray(sceneVAO);
-		// 为diffuse指定所使用的纹理单元（GL_TEXTURE0）
-		lightingShader->setInt("material.diffuse", 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuseTexture->getGlID());
-		// 为specular指定所使用的纹理单元（GL_TEXTURE1）
-		lightingShader->setInt("material.specular", 1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specularTexture->getGlID());
-		// Rendering
-		// 传递模型矩阵
-		for(unsigned int i = 0; i < 10; i++)
-		{
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			lightingShader->setMatrix4f("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-
-		// Backprocessing
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
-	glDeleteVertexArrays(1, &sceneVAO);
-	glDeleteVertexArrays(1, &lightCubeVAO);
-	glDeleteBuffers(1, &VBO);
-	glfwTerminate();
+	ME::AllocTracker::setMode(options.allocMode);
+	int result = options.headless ? runHeadless(options) : runWindowed(options);
+#ifdef ME_ENABLE_PROFILING
+	if (ME::Profiler::writeChromeTrace(TRACE_PATH))
+		std::cout << "Wrote " << TRACE_PATH << std::endl;
+#endif
 
 	std::cout << "terminated.";
-	return 0;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+﻿#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+// Same as simdAvx2.cpp, only these kernels are compiled for AVX2
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "occlusionKernels.h"
+
+namespace {
+	using namespace ME::occlusion;
+
+	// One row of a tile at a time: the eight pixels are tested against the
+	// edges at once and the covered ones masked into the buffer
+	void rasterize(const Polygon& polygon, int rowBegin, int rowEnd, float* depth) {
+		int minY = std::max(polygon.minY, rowBegin);
+		int maxY = std::min(polygon.maxY, rowEnd - 1);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 centers = _mm256_setr_ps(.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		__m256 edgeX[MAX_EDGES];
+		float cornerOffset[MAX_EDGES];
+		for (int edge = 0; edge < MAX_EDGES; edge++) {
+			edgeX[edge] = _mm256_set1_ps(polygon.edgeX[edge]);
+			cornerOffset[edge] = .5f * (std::abs(polygon.edgeX[edge]) + std::abs(polygon.edgeY[edge]));
+		}
+		const __m256 depthX = _mm256_set1_ps(polygon.depthX);
+		int firstTile = polygon.minX / TILE_SIZE;
+		int lastTile = polygon.maxX / TILE_SIZE;
+		for (int y = minY; y <= maxY; y++) {
+			float centerY = y + .5f;
+			// Edge functions at each pixel's worst corner
+			__m256 rowEdge[MAX_EDGES];
+			for (int edge = 0; edge < MAX_EDGES; edge++)
+				rowEdge[edge] = _mm256_set1_ps(polygon.edgeY[edge] * centerY + polygon.edgeConstant[edge] - cornerOffset[edge]);
+			__m256 rowDepth = _mm256_set1_ps(polygon.depthY * centerY + polygon.depthConstant);
+			for (int tile = firstTile; tile <= lastTile; tile++) {
+				__m256 x = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(tile * TILE_SIZE)), centers);
+				__m256 inside = _mm256_cmp_ps(_mm256_fmadd_ps(edgeX[0], x, rowEdge[0]), zero, _CMP_GE_OQ);
+				for (int edge = 1; edge < MAX_EDGES; edge++)
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edgeX[edge], x, rowEdge[edge]), zero, _CMP_GE_OQ));
+				if (_mm256_movemask_ps(inside) == 0)
+					continue;
+				float* row = depth + pixelIndex(tile * TILE_SIZE, y);
+				__m256 covered = _mm256_and_ps(inside, _mm256_fmadd_ps(depthX, x, rowDepth));
+				_mm256_storeu_ps(row, _mm256_max_ps(_mm256_loadu_ps(row), covered));
+			}
+		}
+	}
+
+	void reduceTiles(const float* depth, int tileBegin, int tileEnd, float* farthest) {
+		for (int tile = tileBegin; tile < tileEnd; tile++) {
+			const float* pixels = depth + tile * TILE_PIXELS;
+			__m256 least = _mm256_loadu_ps(pixels);
+			for (int row = 1; row < TILE_SIZE; row++)
+				least = _mm256_min_ps(least, _mm256_loadu_ps(pixels + row * TILE_SIZE));
+			__m128 half = _mm_min_ps(_mm256_castps256_ps128(least), _mm256_extractf128_ps(least, 1));
+			half = _mm_min_ps(half, _mm_movehl_ps(half, half));
+			half = _mm_min_ss(half, _mm_shuffle_ps(half, half, 1));
+			farthest[tile] = _mm_cvtss_f32(half);
+		}
+	}
+
+	bool isRectVisible(const float* depth, const float* farthest, int minX, int minY, int maxX, int maxY, float nearest) {
+		const __m256 object = _mm256_set1_ps(nearest);
+		for (int tileY = minY / TILE_SIZE; tileY <= maxY / TILE_SIZE; tileY++) {
+			int rowBegin = std::max(minY, tileY * TILE_SIZE);
+			int rowEnd = std::min(maxY, tileY * TILE_SIZE + TILE_SIZE - 1);
+			for (int tileX = minX / TILE_SIZE; tileX <= maxX / TILE_SIZE; tileX++) {
+				int tile = tileY * TILES_X + tileX;
+				// The whole tile is nearer than the object
+				if (farthest[tile] > nearest)
+					continue;
+				int columnBegin = std::max(minX, tileX * TILE_SIZE) - tileX * TILE_SIZE;
+				int columnEnd = std::min(maxX, tileX * TILE_SIZE + TILE_SIZE - 1) - tileX * TILE_SIZE;
+				int columns = ((1 << (columnEnd + 1)) - 1) & ~((1 << columnBegin) - 1);
+				for (int y = rowBegin; y <= rowEnd; y++) {
+					__m256 row = _mm256_loadu_ps(depth + pixelIndex(tileX * TILE_SIZE, y));
+					if (_mm256_movemask_ps(_mm256_cmp_ps(row, object, _CMP_LE_OQ)) & columns)
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const ME::occlusion::Kernels& ME::occlusion::getAvx2Kernels() {
+	static const Kernels kernels = { rasterize, reduceTiles, isRectVisible };
+	return kernels;
+}
+#endif
@@ -0,0 +1,312 @@
+﻿#include "occlusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "simd.h"
+
+namespace {
+	using namespace ME::occlusion;
+
+	// Objects with a corner this close to the camera plane are kept
+	const float MIN_W = 1e-4f;
+
+	const glm::vec4 CUBE_CORNERS[8] = {
+		glm::vec4(-.5f, -.5f, -.5f, 1.0f), glm::vec4(.5f, -.5f, -.5f, 1.0f),
+		glm::vec4(.5f, .5f, -.5f, 1.0f), glm::vec4(-.5f, .5f, -.5f, 1.0f),
+		glm::vec4(-.5f, -.5f, .5f, 1.0f), glm::vec4(.5f, -.5f, .5f, 1.0f),
+		glm::vec4(.5f, .5f, .5f, 1.0f), glm::vec4(-.5f, .5f, .5f, 1.0f),
+	};
+	// Counter-clockwise seen from outside. Whole faces rather than triangle
+	// pairs, which would leave the pixels along each diagonal uncovered.
+	const int CUBE_FACES[6][4] = {
+		{ 4, 5, 6, 7 },
+		{ 0, 3, 2, 1 },
+		{ 1, 2, 6, 5 },
+		{ 0, 4, 7, 3 },
+		{ 3, 7, 6, 2 },
+		{ 0, 1, 5, 4 },
+	};
+
+	void rasterize(const Polygon& polygon, int rowBegin, int rowEnd, float* depth) {
+		int minY = std::max(polygon.minY, rowBegin);
+		int maxY = std::min(polygon.maxY, rowEnd - 1);
+		float cornerOffset[MAX_EDGES];
+		for (int edge = 0; edge < MAX_EDGES; edge++)
+			cornerOffset[edge] = .5f * (std::abs(polygon.edgeX[edge]) + std::abs(polygon.edgeY[edge]));
+		for (int y = minY; y <= maxY; y++) {
+			float centerY = y + .5f;
+			for (int x = polygon.minX; x <= polygon.maxX; x++) {
+				float centerX = x + .5f;
+				// Edge functions at the pixel's worst corner
+				bool inside = true;
+				for (int edge = 0; edge < MAX_EDGES; edge++)
+					inside &= polygon.edgeX[edge] * centerX + polygon.edgeY[edge] * centerY + polygon.edgeConstant[edge] >= cornerOffset[edge];
+				if (!inside)
+					continue;
+				float& pixel = depth[pixelIndex(x, y)];
+				pixel = std::max(pixel, polygon.depthX * centerX + polygon.depthY * centerY + polygon.depthConstant);
+			}
+		}
+	}
+
+	void reduceTiles(const float* depth, int tileBegin, int tileEnd, float* farthest) {
+		for (int tile = tileBegin; tile < tileEnd; tile++) {
+			const float* pixels = depth + tile * TILE_PIXELS;
+			farthest[tile] = *std::min_element(pixels, pixels + TILE_PIXELS);
+		}
+	}
+
+	bool isRectVisible(const float* depth, const float* farthest, int minX, int minY, int maxX, int maxY, float nearest) {
+		for (int tileY = minY / TILE_SIZE; tileY <= maxY / TILE_SIZE; tileY++) {
+			for (int tileX = minX / TILE_SIZE; tileX <= maxX / TILE_SIZE; tileX++) {
+				if (farthest[tileY * TILES_X + tileX] > nearest)
+					continue;
+				int rowEnd = std::min(maxY, tileY * TILE_SIZE + TILE_SIZE - 1);
+				int columnEnd = std::min(maxX, tileX * TILE_SIZE + TILE_SIZE - 1);
+				for (int y = std::max(minY, tileY * TILE_SIZE); y <= rowEnd; y++) {
+					for (int x = std::max(minX, tileX * TILE_SIZE); x <= columnEnd; x++) {
+						if (depth[pixelIndex(x, y)] <= nearest)
+							return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	// Edge functions of a convex counter-clockwise polygon and its pixel
+	// bounds. False when it is entirely off the buffer.
+	bool setEdges(Polygon& polygon, const float* x, const float* y, int count) {
+		polygon.minX = std::max(0, static_cast<int>(std::floor(*std::min_element(x, x + count))));
+		polygon.minY = std::max(0, static_cast<int>(std::floor(*std::min_element(y, y + count))));
+		polygon.maxX = std::min(WIDTH - 1, static_cast<int>(std::floor(*std::max_element(x, x + count))));
+		polygon.maxY = std::min(HEIGHT - 1, static_cast<int>(std::floor(*std::max_element(y, y + count))));
+		if (polygon.minX > polygon.maxX || polygon.minY > polygon.maxY)
+			return false;
+		for (int edge = 0; edge < MAX_EDGES; edge++) {
+			if (edge >= count) {
+				polygon.edgeX[edge] = 0;
+				polygon.edgeY[edge] = 0;
+				polygon.edgeConstant[edge] = 1;
+				continue;
+			}
+			int next = (edge + 1) % count;
+			polygon.edgeX[edge] = y[edge] - y[next];
+			polygon.edgeY[edge] = x[next] - x[edge];
+			polygon.edgeConstant[edge] = -(polygon.edgeX[edge] * x[edge] + polygon.edgeY[edge] * y[edge]);
+		}
+		return true;
+	}
+
+	// Counter-clockwise convex hull of up to 8 points by monotone chain,
+	// returns its vertex count
+	int convexHull(const float* x, const float* y, int count, float* hullX, float* hullY) {
+		int order[8];
+		for (int i = 0; i < count; i++)
+			order[i] = i;
+		std::sort(order, order + count, [&](int a, int b) { return x[a] < x[b] || (x[a] == x[b] && y[a] < y[b]); });
+		auto turn = [&](int origin, int a, int b) {
+			return (x[a] - x[origin]) * (y[b] - y[origin]) - (y[a] - y[origin]) * (x[b] - x[origin]);
+		};
+		int hull[16];
+		int size = 0;
+		for (int i = 0; i < count; i++) {
+			while (size >= 2 && turn(hull[size - 2], hull[size - 1], order[i]) <= 0)
+				size--;
+			hull[size++] = order[i];
+		}
+		for (int i = count - 2, lower = size + 1; i >= 0; i--) {
+			while (size >= lower && turn(hull[size - 2], hull[size - 1], order[i]) <= 0)
+				size--;
+			hull[size++] = order[i];
+		}
+		// The last point closes the loop
+		size--;
+		for (int i = 0; i < size; i++) {
+			hullX[i] = x[hull[i]];
+			hullY[i] = y[hull[i]];
+		}
+		return size;
+	}
+}
+
+const ME::occlusion::Kernels& ME::occlusion::getScalarKernels() {
+	static const Kernels kernels = { rasterize, reduceTiles, isRectVisible };
+	return kernels;
+}
+
+ME::OcclusionCuller::OcclusionCuller(ThreadPool* pool) : pool(pool) {
+	viewProjection = glm::mat4(1.0f);
+	depth.assign(WIDTH * HEIGHT, 0.0f);
+	farthest.assign(TILES_X * TILES_Y, 0.0f);
+}
+
+const ME::occlusion::Kernels& ME::OcclusionCuller::getKernels() {
+	// AVX-512 has nothing more to offer on 8-wide tile rows
+#if defined(ME_OCCLUSION_X86)
+	if (simd::getInstructionSet() >= simd::InstructionSet::AVX2)
+		return occlusion::getAvx2Kernels();
+#endif
+	return occlusion::getScalarKernels();
+}
+
+const char* ME::OcclusionCuller::getInstructionSet() {
+	return &getKernels() == &occlusion::getScalarKernels() ? "scalar" : "AVX2";
+}
+
+void ME::OcclusionCuller::addCube(const glm::mat4& modelViewProjection) {
+	glm::vec4 clip[8];
+	for (int corner = 0; corner < 8; corner++) {
+		clip[corner] = modelViewProjection * CUBE_CORNERS[corner];
+		if (clip[corner].z < -clip[corner].w || clip[corner].z > clip[corner].w || clip[corner].w < MIN_W)
+			return;
+	}
+	float screenX[8], screenY[8], inverseW[8];
+	for (int corner = 0; corner < 8; corner++) {
+		inverseW[corner] = 1.0f / clip[corner].w;
+		screenX[corner] = (clip[corner].x * inverseW[corner] * .5f + .5f) * WIDTH;
+		screenY[corner] = (clip[corner].y * inverseW[corner] * .5f + .5f) * HEIGHT;
+	}
+	stats.occluders++;
+	for (const int* index : CUBE_FACES) {
+		float x[4], y[4], z[4];
+		for (int vertex = 0; vertex < 4; vertex++) {
+			x[vertex] = screenX[index[vertex]];
+			y[vertex] = screenY[index[vertex]];
+			z[vertex] = inverseW[index[vertex]];
+		}
+		// Back faces and slivers cover nothing the front faces don't. The
+		// depth plane comes from the bigger half, which has at least half the area.
+		float firstArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		float secondArea = (x[2] - x[0]) * (y[3] - y[0]) - (x[3] - x[0]) * (y[2] - y[0]);
+		if (firstArea + secondArea <= 0)
+			continue;
+		Polygon polygon;
+		if (!setEdges(polygon, x, y, 4))
+			continue;
+		int second = firstArea >= secondArea ? 1 : 2;
+		int third = second + 1;
+		float area = std::max(firstArea, secondArea);
+		polygon.depthX = ((z[second] - z[0]) * (y[third] - y[0]) - (z[third] - z[0]) * (y[second] - y[0])) / area;
+		polygon.depthY = ((z[third] - z[0]) * (x[second] - x[0]) - (z[second] - z[0]) * (x[third] - x[0])) / area;
+		// Sampled at pixel centres, so half a pixel of slope lower is the
+		// farthest the face gets anywhere in the pixel
+		polygon.depthConstant = z[0] - polygon.depthX * x[0] - polygon.depthY * y[0] -
+			.5f * (std::abs(polygon.depthX) + std::abs(polygon.depthY));
+		polygons.push_back(polygon);
+	}
+	// Pixels across an edge between two front faces lie in neither one
+	// entirely. The outline covers them at the cube's farthest corner, no
+	// point of the cube is farther than that.
+	float outlineX[8], outlineY[8];
+	int outlineCount = convexHull(screenX, screenY, 8, outlineX, outlineY);
+	Polygon outline;
+	if (outlineCount < 3 || outlineCount > MAX_EDGES || !setEdges(outline, outlineX, outlineY, outlineCount))
+		return;
+	outline.depthX = 0;
+	outline.depthY = 0;
+	outline.depthConstant = *std::min_element(inverseW, inverseW + 8);
+	polygons.push_back(outline);
+}
+
+void ME::OcclusionCuller::renderOccluders(const glm::mat4& viewProjection, const glm::mat4* models, size_t count) {
+	auto start = std::chrono::steady_clock::now();
+	this->viewProjection = viewProjection;
+	stats.occluders = 0;
+	polygons.clear();
+	for (size_t i = 0; i < count; i++)
+		addCube(viewProjection * models[i]);
+	stats.polygons = static_cast<unsigned int>(polygons.size());
+
+	const occlusion::Kernels& kernels = getKernels();
+	// A band is a few rows of tiles, contiguous in memory, so workers never
+	// share a tile
+	auto job = [&](size_t begin, size_t end) {
+		int tileBegin = static_cast<int>(begin) * BAND_TILES * TILES_X;
+		int tileEnd = static_cast<int>(std::min(end * BAND_TILES, static_cast<size_t>(TILES_Y))) * TILES_X;
+		int rowBegin = static_cast<int>(begin) * BAND_TILES * TILE_SIZE;
+		int rowEnd = tileEnd / TILES_X * TILE_SIZE;
+		std::fill(depth.begin() + tileBegin * TILE_PIXELS, depth.begin() + tileEnd * TILE_PIXELS, 0.0f);
+		for (const Polygon& polygon : polygons) {
+			if (polygon.maxY >= rowBegin && polygon.minY < rowEnd)
+				kernels.rasterize(polygon, rowBegin, rowEnd, depth.data());
+		}
+		kernels.reduceTiles(depth.data(), tileBegin, tileEnd, farthest.data());
+	};
+	size_t bands = (TILES_Y + BAND_TILES - 1) / BAND_TILES;
+	if (pool != nullptr)
+		pool->parallelFor(bands, 1, job);
+	else
+		job(0, bands);
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool ME::OcclusionCuller::isVisible(const occlusion::Kernels& kernels, float x, float y, float z, float radius) const {
+	// The corners of the box around the sphere bound its projection
+	glm::vec4 center = viewProjection * glm::vec4(x, y, z, 1.0f);
+	glm::vec4 axes[3] = { viewProjection[0] * radius, viewProjection[1] * radius, viewProjection[2] * radius };
+	float minX = static_cast<float>(WIDTH), minY = static_cast<float>(HEIGHT);
+	float maxX = 0, maxY = 0;
+	float nearest = 0;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec4 clip = center;
+		for (int axis = 0; axis < 3; axis++)
+			clip = (corner >> axis) & 1 ? clip + axes[axis] : clip - axes[axis];
+		if (clip.w < MIN_W)
+			return true;
+		float inverseW = 1.0f / clip.w;
+		float screenX = (clip.x * inverseW * .5f + .5f) * WIDTH;
+		float screenY = (clip.y * inverseW * .5f + .5f) * HEIGHT;
+		minX = std::min(minX, screenX);
+		minY = std::min(minY, screenY);
+		maxX = std::max(maxX, screenX);
+		maxY = std::max(maxY, screenY);
+		nearest = std::max(nearest, inverseW);
+	}
+	// Off screen it is the frustum's call
+	if (minX >= WIDTH || minY >= HEIGHT || maxX < 0 || maxY < 0)
+		return true;
+	int pixelMinX = std::max(0, static_cast<int>(std::floor(minX)) - 1);
+	int pixelMinY = std::max(0, static_cast<int>(std::floor(minY)) - 1);
+	int pixelMaxX = std::min(WIDTH - 1, static_cast<int>(std::floor(maxX)) + 1);
+	int pixelMaxY = std::min(HEIGHT - 1, static_cast<int>(std::floor(maxY)) + 1);
+	return kernels.isRectVisible(depth.data(), farthest.data(), pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, nearest);
+}
+
+size_t ME::OcclusionCuller::cull(const BoundingSpheres& spheres, uint32_t* objects, size_t count) {
+	auto start = std::chrono::steady_clock::now();
+	const occlusion::Kernels& kernels = getKernels();
+	visibleFlags.resize(count);
+	auto job = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t object = objects[i];
+			visibleFlags[i] = isVisible(kernels, spheres.x[object], spheres.y[object], spheres.z[object],
+				spheres.radius[object]) ? 1 : 0;
+		}
+	};
+	if (stats.polygons == 0) {
+		std::fill(visibleFlags.begin(), visibleFlags.end(), static_cast<uint8_t>(1));
+	}
+	else if (pool != nullptr) {
+		pool->parallelFor(count, CHUNK_SIZE, job);
+	}
+	else {
+		job(0, count);
+	}
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < count; i++) {
+		objects[visibleCount] = objects[i];
+		visibleCount += visibleFlags[i];
+	}
+
+	stats.tested = static_cast<unsigned int>(count);
+	stats.occluded = static_cast<unsigned int>(count - visibleCount);
+	stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return visibleCount;
+}
+
+const ME::OcclusionCuller::Stats& ME::OcclusionCuller::getStats() const {
+	return stats;
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "culling.h"
+#include "occlusionKernels.h"
+#include "threadPool.h"
+
+namespace ME {
+	// Software occlusion culling. A frame's biggest occluders are rasterized
+	// on the CPU into a 256x128 depth buffer over the viewport, with the
+	// farthest depth of every 8x8 tile kept on top so most tests end there.
+	// Objects whose screen bounds are behind that depth everywhere are
+	// dropped before anything is submitted.
+	//
+	// Both sides are conservative: occluders only cover the pixels they lie
+	// over entirely, with the farthest depth in there, and objects are tested
+	// with the nearest corner of their box and a rectangle grown by a pixel.
+	// Rasterizing runs in bands of tile rows and testing in chunks of
+	// objects, both on the pool, with AVX2 kernels when ME::simd allows them.
+	class OcclusionCuller {
+	public:
+		// Number of objects handed to one worker at a time
+		static const size_t CHUNK_SIZE = 1024;
+		// Tile rows rasterized by one worker at a time
+		static const int BAND_TILES = 2;
+		struct Stats {
+			unsigned int occluders = 0;
+			unsigned int polygons = 0;
+			unsigned int tested = 0;
+			unsigned int occluded = 0;
+			// Rendering the occluders and testing together
+			double milliseconds = 0;
+		};
+	public:
+		explicit OcclusionCuller(ThreadPool* pool = nullptr);
+		// Clears the buffer and draws a unit cube under every model. Cubes
+		// reaching past the near or far plane are left out, the GPU clips them.
+		void renderOccluders(const glm::mat4& viewProjection, const glm::mat4* models, size_t count);
+		// Keeps the objects that may be visible behind the occluders, in
+		// order, and returns how many. Uses the last renderOccluders.
+		size_t cull(const BoundingSpheres& spheres, uint32_t* objects, size_t count);
+		const Stats& getStats() const;
+		// Name of the instruction set the kernels run on right now
+		static const char* getInstructionSet();
+	private:
+		static const occlusion::Kernels& getKernels();
+		void addCube(const glm::mat4& modelViewProjection);
+		bool isVisible(const occlusion::Kernels& kernels, float x, float y, float z, float radius) const;
+
+		ThreadPool* pool;
+		glm::mat4 viewProjection;
+		std::vector<float> depth;
+		std::vector<float> farthest;
+		std::vector<occlusion::Polygon> polygons;
+		std::vector<uint8_t> visibleFlags;
+		Stats stats;
+	};
+}
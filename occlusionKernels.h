@@ -0,0 +1,69 @@
+﻿#pragma once
+
+// Internal to occlusionCuller.cpp and occlusionAvx2.cpp, which compiles its
+// kernels for AVX2 the same way as simdAvx2.cpp. engineBench.cpp checks one
+// against the other.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ME_OCCLUSION_X86
+#endif
+
+namespace ME {
+	namespace occlusion {
+		// The depth buffer is stored tile after tile and row after row inside
+		// a tile, so one row of a tile is one AVX2 register. Depth is 1 / w:
+		// linear across the screen, larger when nearer, 0 where nothing was
+		// drawn.
+		const int TILE_SIZE = 8;
+		const int TILES_X = 32;
+		const int TILES_Y = 16;
+		const int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+		const int WIDTH = TILES_X * TILE_SIZE;
+		const int HEIGHT = TILES_Y * TILE_SIZE;
+
+		const int MAX_EDGES = 6;
+
+		// A convex counter-clockwise polygon in pixel coordinates, a cube face
+		// or a cube's outline. A pixel is covered only when it lies entirely
+		// inside, i.e. every edge function is at least 0 at the pixel's worst
+		// corner: its value at the centre less half of |edgeX| + |edgeY|.
+		// Partly covered pixels could hide what shows through a gap. Unused
+		// edges are 0x + 0y + 1, true everywhere.
+		struct Polygon {
+			float edgeX[MAX_EDGES];
+			float edgeY[MAX_EDGES];
+			float edgeConstant[MAX_EDGES];
+			// Plane of 1 / w, at most the farthest value over a pixel
+			float depthX;
+			float depthY;
+			float depthConstant;
+			// Inclusive pixel bounds, inside the buffer
+			int minX;
+			int minY;
+			int maxX;
+			int maxY;
+		};
+
+		struct Kernels {
+			// Keeps the nearer of the buffer and the polygon in the pixel rows [rowBegin, rowEnd)
+			void (*rasterize)(const Polygon& polygon, int rowBegin, int rowEnd, float* depth);
+			// Farthest depth of every tile in [tileBegin, tileEnd)
+			void (*reduceTiles)(const float* depth, int tileBegin, int tileEnd, float* farthest);
+			// Whether some pixel of the inclusive rectangle is no nearer than
+			// nearest, so an object at that depth could show there
+			bool (*isRectVisible)(const float* depth, const float* farthest, int minX, int minY, int maxX, int maxY, float nearest);
+		};
+		const Kernels& getScalarKernels();
+#if defined(ME_OCCLUSION_X86)
+		const Kernels& getAvx2Kernels();
+#endif
+	}
+}
+
+// Anonymous for the same reason as the kernel templates in simdKernels.h
+namespace {
+	inline int pixelIndex(int x, int y) {
+		using namespace ME::occlusion;
+		int tile = (y / TILE_SIZE) * TILES_X + x / TILE_SIZE;
+		return tile * TILE_PIXELS + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+	}
+}
@@ -0,0 +1,171 @@
+﻿#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+	struct ProfileEvent {
+		const char* name;
+		int64_t begin;
+		int64_t end;
+	};
+
+	struct ThreadBuffer {
+		ProfileEvent events[ME::Profiler::EVENTS_PER_THREAD];
+		// Only the owning thread writes these, the exporter reads them
+		std::atomic<size_t> count;
+		std::atomic<size_t> dropped;
+		std::atomic<unsigned int> capture;
+		std::atomic<const char*> name;
+	};
+
+	// Buffers are never removed while the program runs, a thread id is its slot
+	struct Registry {
+		std::atomic<ThreadBuffer*> buffers[ME::Profiler::MAX_THREADS];
+		std::atomic<int> bufferCount;
+		std::atomic<unsigned int> capture;
+		std::atomic<bool> capturing;
+		std::chrono::steady_clock::time_point epoch;
+
+		Registry() {
+			for (auto& buffer : buffers)
+				buffer = nullptr;
+			bufferCount = 0;
+			capture = 0;
+			capturing = true;
+			epoch = std::chrono::steady_clock::now();
+		}
+		~Registry() {
+			for (auto& buffer : buffers)
+				delete buffer.load();
+		}
+	};
+
+	Registry registry;
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+	thread_local bool outOfSlots = false;
+
+	ThreadBuffer* getThreadBuffer() {
+		if (threadBuffer != nullptr || outOfSlots)
+			return threadBuffer;
+		int slot = registry.bufferCount.fetch_add(1);
+		if (slot >= ME::Profiler::MAX_THREADS) {
+			outOfSlots = true;
+			return nullptr;
+		}
+		ThreadBuffer* buffer = new ThreadBuffer();
+		buffer->count = 0;
+		buffer->dropped = 0;
+		buffer->capture = registry.capture.load();
+		buffer->name = nullptr;
+		registry.buffers[slot].store(buffer, std::memory_order_release);
+		threadBuffer = buffer;
+		return buffer;
+	}
+
+	void writeJsonString(std::FILE* file, const char* string) {
+		std::fputc('"', file);
+		for (const char* c = string; *c; c++) {
+			if (*c == '"' || *c == '\\')
+				std::fputc('\\', file);
+			if (static_cast<unsigned char>(*c) >= 0x20)
+				std::fputc(*c, file);
+		}
+		std::fputc('"', file);
+	}
+}
+
+int64_t ME::Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry.epoch).count();
+}
+
+void ME::Profiler::setThreadName(const char* name) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer != nullptr)
+		buffer->name.store(name, std::memory_order_release);
+}
+
+void ME::Profiler::record(const char* name, int64_t begin, int64_t end) {
+	if (!registry.capturing.load(std::memory_order_relaxed))
+		return;
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer == nullptr)
+		return;
+	// The owner notices a new capture on its next event and starts over
+	unsigned int capture = registry.capture.load(std::memory_order_acquire);
+	if (buffer->capture.load(std::memory_order_relaxed) != capture) {
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->capture.store(capture, std::memory_order_release);
+	}
+	size_t count = buffer->count.load(std::memory_order_relaxed);
+	if (count >= EVENTS_PER_THREAD) {
+		buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	buffer->events[count] = { name, begin, end };
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+void ME::Profiler::startCapture() {
+	registry.capture.fetch_add(1, std::memory_order_acq_rel);
+	registry.capturing.store(true, std::memory_order_relaxed);
+}
+
+void ME::Profiler::stopCapture() {
+	registry.capturing.store(false, std::memory_order_relaxed);
+}
+
+bool ME::Profiler::isCapturing() {
+	return registry.capturing.load(std::memory_order_relaxed);
+}
+
+bool ME::Profiler::writeChromeTrace(const char* path) {
+	std::FILE* file = std::fopen(path, "w");
+	if (file == nullptr)
+		return false;
+	unsigned int capture = registry.capture.load(std::memory_order_acquire);
+	int bufferCount = std::min(registry.bufferCount.load(), static_cast<int>(MAX_THREADS));
+	std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"MyOpenGLApp\"}}", file);
+	for (int slot = 0; slot < bufferCount; slot++) {
+		ThreadBuffer* buffer = registry.buffers[slot].load(std::memory_order_acquire);
+		if (buffer == nullptr)
+			continue;
+		int tid = slot + 1;
+		const char* name = buffer->name.load(std::memory_order_acquire);
+		if (name != nullptr) {
+			std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", tid);
+			writeJsonString(file, name);
+			std::fputs("}}", file);
+		}
+		// Threads that haven't recorded since the capture started still hold the old one
+		if (buffer->capture.load(std::memory_order_acquire) != capture)
+			continue;
+		// Events past this count may still be in flight, they are left out
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const ProfileEvent& event = buffer->events[i];
+			std::fputs(",\n{\"name\":", file);
+			writeJsonString(file, event.name);
+			std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				tid, event.begin / 1e3, (event.end - event.begin) / 1e3);
+		}
+	}
+	std::fputs("\n]}\n", file);
+	return std::fclose(file) == 0;
+}
+
+size_t ME::Profiler::getDroppedEvents() {
+	size_t dropped = 0;
+	unsigned int capture = registry.capture.load(std::memory_order_acquire);
+	int bufferCount = std::min(registry.bufferCount.load(), static_cast<int>(MAX_THREADS));
+	for (int slot = 0; slot < bufferCount; slot++) {
+		ThreadBuffer* buffer = registry.buffers[slot].load(std::memory_order_acquire);
+		if (buffer != nullptr && buffer->capture.load(std::memory_order_acquire) == capture)
+			dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
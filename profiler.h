@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ME {
+	// CPU scope timings for the Chrome trace viewer and Perfetto. Every thread
+	// appends to its own fixed buffer, so recording takes no locks and, after
+	// a thread's first event, never allocates. A full buffer drops events
+	// until the next capture. Use the ME_PROFILE_* macros, which compile to
+	// nothing unless ME_ENABLE_PROFILING is defined.
+	class Profiler {
+	public:
+		static const size_t EVENTS_PER_THREAD = 1 << 16;
+		static const int MAX_THREADS = 64;
+	public:
+		// Nanoseconds since the profiler's epoch
+		static int64_t now();
+		// Names the calling thread in the trace, the name must outlive the profiler
+		static void setThreadName(const char* name);
+		static void record(const char* name, int64_t begin, int64_t end);
+		// Drops everything recorded so far and starts recording again
+		static void startCapture();
+		static void stopCapture();
+		static bool isCapturing();
+		// Writes the current capture as Chrome trace JSON. Call from the thread
+		// that starts captures.
+		static bool writeChromeTrace(const char* path);
+		// Events that did not fit into their thread's buffer
+		static size_t getDroppedEvents();
+	};
+
+	class ProfileScope {
+	public:
+		explicit ProfileScope(const char* name) : name(name), begin(Profiler::now()) {}
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+		~ProfileScope() { Profiler::record(name, begin, Profiler::now()); }
+	private:
+		const char* name;
+		int64_t begin;
+	};
+}
+
+#ifdef ME_ENABLE_PROFILING
+#define ME_PROFILE_CONCAT_INNER(a, b) a##b
+#define ME_PROFILE_CONCAT(a, b) ME_PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope, name must be a string literal
+#define ME_PROFILE_SCOPE(name) ::ME::ProfileScope ME_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define ME_PROFILE_FUNCTION() ME_PROFILE_SCOPE(__func__)
+#define ME_PROFILE_THREAD(name) ::ME::Profiler::setThreadName(name)
+#else
+#define ME_PROFILE_SCOPE(name) ((void)0)
+#define ME_PROFILE_FUNCTION() ((void)0)
+#define ME_PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,162 @@
+﻿#include "renderQueue.h"
+
+#include <algorithm>
+
+uint64_t ME::RenderQueue::makeSortKey(Pass pass, uint32_t shader, uint32_t material, uint32_t vao, float depth) {
+	depth = std::min(std::max(depth, 0.f), 1.f);
+	uint64_t quantizedDepth = static_cast<uint64_t>(depth * 0xFFFFFF);
+	return (static_cast<uint64_t>(pass) & 0xF) << 60 |
+		(static_cast<uint64_t>(shader) & 0x3FF) << 50 |
+		(static_cast<uint64_t>(material) & 0x3FFF) << 36 |
+		(static_cast<uint64_t>(vao) & 0xFFF) << 24 |
+		quantizedDepth;
+}
+
+ME::RenderQueue::RenderQueue() {
+	reserve(256);
+}
+
+void ME::RenderQueue::reserve(size_t count) {
+	packets.reserve(count);
+	transforms.reserve(count);
+	items.reserve(count);
+	scratch.reserve(count);
+}
+
+void ME::RenderQueue::submit(uint64_t key, const DrawPacket& packet, const glm::mat4& model) {
+	uint32_t index = static_cast<uint32_t>(packets.size());
+	packets.push_back(packet);
+	packets.back().transformIndex = static_cast<uint32_t>(transforms.size());
+	transforms.push_back(model);
+	items.push_back({ key, index });
+}
+
+size_t ME::RenderQueue::size() const {
+	return packets.size();
+}
+
+void ME::RenderQueue::resetStats() {
+	stats = Stats();
+}
+
+const ME::RenderQueue::Stats& ME::RenderQueue::getStats() const {
+	return stats;
+}
+
+void ME::RenderQueue::sort() {
+	// LSD radix sort, one byte per pass. All eight histograms are built in a
+	// single sweep, and passes where every key shares the same byte are skipped.
+	size_t n = items.size();
+	if (n < 2)
+		return;
+	scratch.resize(n);
+	size_t histograms[8][256] = {};
+	for (const SortItem& item : items) {
+		for (int pass = 0; pass < 8; pass++) {
+			histograms[pass][(item.key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+	SortItem* source = items.data();
+	SortItem* destination = scratch.data();
+	for (int pass = 0; pass < 8; pass++) {
+		size_t* histogram = histograms[pass];
+		if (histogram[(source[0].key >> (pass * 8)) & 0xFF] == n)
+			continue;
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			size_t count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += count;
+		}
+		for (size_t i = 0; i < n; i++) {
+			destination[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+	if (source != items.data())
+		std::copy(source, source + n, items.data());
+}
+
+bool ME::RenderQueue::sharesState(const DrawPacket& a, const DrawPacket& b) {
+	if (a.program != b.program || a.vao != b.vao || a.mode != b.mode)
+		return false;
+	for (int unit = 0; unit < DrawPacket::MAX_TEXTURES; unit++) {
+		if (a.textures[unit] != b.textures[unit])
+			return false;
+	}
+	return true;
+}
+
+void ME::RenderQueue::bind(GLState& state, const DrawPacket& packet, BoundState& bound) {
+	if (packet.program != bound.program) {
+		state.useProgram(packet.program);
+		bound.program = packet.program;
+		stats.programChanges++;
+	}
+	if (packet.vao != bound.vao) {
+		state.bindVertexArray(packet.vao);
+		bound.vao = packet.vao;
+		stats.vaoChanges++;
+	}
+	for (int unit = 0; unit < DrawPacket::MAX_TEXTURES; unit++) {
+		if (packet.textures[unit] == 0 || packet.textures[unit] == bound.textures[unit])
+			continue;
+		state.bindTexture(unit, GL_TEXTURE_2D, packet.textures[unit]);
+		bound.textures[unit] = packet.textures[unit];
+		stats.textureChanges++;
+	}
+}
+
+void ME::RenderQueue::draw(const DrawPacket& packet) {
+	if (packet.modelLocation >= 0)
+		glUniformMatrix4fv(packet.modelLocation, 1, GL_FALSE, glm::value_ptr(transforms[packet.transformIndex]));
+	if (packet.indexed) {
+		uintptr_t indexOffset = sizeof(GLuint) * packet.first;
+		glDrawElementsBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, (void*)indexOffset, packet.baseVertex);
+	}
+	else {
+		glDrawArrays(packet.mode, packet.first, packet.count);
+	}
+	stats.draws++;
+}
+
+void ME::RenderQueue::clear() {
+	packets.clear();
+	transforms.clear();
+	items.clear();
+}
+
+void ME::RenderQueue::flush(GLState& state) {
+	sort();
+	BoundState bound;
+	for (const SortItem& item : items) {
+		const DrawPacket& packet = packets[item.index];
+		bind(state, packet, bound);
+		draw(packet);
+	}
+	clear();
+}
+
+void ME::RenderQueue::flush(GLState& state, IndirectRenderer& indirect) {
+	sort();
+	BoundState bound;
+	const DrawPacket* bucket = nullptr;
+	for (const SortItem& item : items) {
+		const DrawPacket& packet = packets[item.index];
+		if (bucket != nullptr && (!packet.indexed || !sharesState(*bucket, packet))) {
+			indirect.submitBucket(state, bucket->mode);
+			bucket = nullptr;
+		}
+		bind(state, packet, bound);
+		if (!packet.indexed) {
+			draw(packet);
+			continue;
+		}
+		bucket = &packet;
+		indirect.addDraw(packet.count, packet.first, packet.baseVertex, transforms[packet.transformIndex]);
+		stats.draws++;
+	}
+	if (bucket != nullptr)
+		indirect.submitBucket(state, bucket->mode);
+	clear();
+}
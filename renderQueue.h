@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "glState.h"
+#include "indirectRenderer.h"
+
+namespace ME {
+	// Everything needed to issue one draw call. Packets carry no pointers so
+	// the queue can reorder them freely.
+	struct DrawPacket {
+		static const int MAX_TEXTURES = 2;
+		GLuint program = 0;
+		GLuint vao = 0;
+		// Bound to GL_TEXTURE0 + i, 0 means "leave the unit alone"
+		GLuint textures[MAX_TEXTURES] = {};
+		GLint modelLocation = -1;
+		GLenum mode = GL_TRIANGLES;
+		// Indexed packets read GL_UNSIGNED_INT indices from the VAO's element
+		// buffer, first is then the first index
+		bool indexed = false;
+		GLint first = 0;
+		GLsizei count = 0;
+		GLint baseVertex = 0;
+		uint32_t transformIndex = 0;
+	};
+
+	class RenderQueue {
+	public:
+		enum class Pass : uint32_t
+		{
+			// Not OPAQUE and TRANSPARENT, <wingdi.h> defines both as macros
+			DEPTH, OPAQUE_GEOMETRY, TRANSLUCENT
+		};
+		struct Stats {
+			unsigned int draws = 0;
+			unsigned int programChanges = 0;
+			unsigned int vaoChanges = 0;
+			unsigned int textureChanges = 0;
+		};
+		// Key layout, most significant first:
+		// pass(4) | shader(10) | material(14) | vao(12) | depth(24)
+		// Ids are masked to their field width, depth is clamped to [0, 1].
+		static uint64_t makeSortKey(Pass pass, uint32_t shader, uint32_t material, uint32_t vao, float depth);
+	public:
+		RenderQueue();
+		// Room for this many packets, so a frame that reaches a new maximum
+		// does not grow the queue
+		void reserve(size_t count);
+		void submit(uint64_t key, const DrawPacket& packet, const glm::mat4& model);
+		// Sorts the recorded packets, issues them through the state cache and
+		// empties the queue
+		void flush(GLState& state);
+		// Same, but consecutive indexed packets sharing program, VAO and
+		// textures are handed to the indirect renderer as one bucket
+		void flush(GLState& state, IndirectRenderer& indirect);
+		size_t size() const;
+		// Flushes add to the stats until the next reset, so a frame that
+		// flushes once per pass sees all of them
+		void resetStats();
+		const Stats& getStats() const;
+	private:
+		struct SortItem {
+			uint64_t key;
+			uint32_t index;
+		};
+		struct BoundState {
+			GLuint program = 0;
+			GLuint vao = 0;
+			GLuint textures[DrawPacket::MAX_TEXTURES] = {};
+		};
+		static bool sharesState(const DrawPacket& a, const DrawPacket& b);
+		void sort();
+		void bind(GLState& state, const DrawPacket& packet, BoundState& bound);
+		void draw(const DrawPacket& packet);
+		void clear();
+		std::vector<DrawPacket> packets;
+		std::vector<glm::mat4> transforms;
+		std::vector<SortItem> items;
+		std::vector<SortItem> scratch;
+		Stats stats;
+	};
+}
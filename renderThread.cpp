@@ -0,0 +1,76 @@
+﻿#include "renderThread.h"
+
+#include <GLFW/glfw3.h>
+
+#include "profiler.h"
+
+ME::RenderThread::RenderThread(GLFWwindow* window, SceneRenderer& renderer) : window(window), renderer(renderer) {
+	stopping = false;
+	glfwMakeContextCurrent(nullptr);
+	thread = std::thread(&RenderThread::run, this);
+}
+
+ME::RenderThread::~RenderThread() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+	glfwMakeContextCurrent(window);
+}
+
+ME::FramePacket& ME::RenderThread::beginPacket() {
+	ME_PROFILE_SCOPE("wait for render thread");
+	std::unique_lock<std::mutex> lock(mutex);
+	wake.wait(lock, [this]() { return !packets.hasUnread(); });
+	return packets.getWriteBuffer();
+}
+
+void ME::RenderThread::publish() {
+	packets.publish();
+	// An empty critical section, so the render thread can't miss the wakeup
+	// between checking for a packet and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	wake.notify_all();
+}
+
+bool ME::RenderThread::getStats(SceneRenderer::Stats& stats) {
+	if (!this->stats.acquire())
+		return false;
+	stats = this->stats.getReadBuffer();
+	return true;
+}
+
+void ME::RenderThread::run() {
+	ME_PROFILE_THREAD("render");
+	glfwMakeContextCurrent(window);
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || packets.hasUnread(); });
+			// The last packet still gets drawn
+			if (stopping && !packets.hasUnread())
+				break;
+		}
+		packets.acquire();
+		// The producer may start on the next packet now
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+		}
+		wake.notify_all();
+		{
+			ME_PROFILE_SCOPE("render");
+			renderer.render(packets.getReadBuffer());
+		}
+		stats.getWriteBuffer() = renderer.getStats();
+		stats.publish();
+		{
+			ME_PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
+	}
+	glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "framePacket.h"
+#include "sceneRenderer.h"
+#include "tripleBuffer.h"
+
+struct GLFWwindow;
+
+namespace ME {
+	// Owns the window's GL context on a thread of its own. The main thread
+	// builds frame N + 1 while frame N is submitted here. Packets and the
+	// resulting stats cross over through triple buffers. The producer only
+	// starts a packet once the previous one was picked up, so the packet's
+	// arena memory stays valid while it is drawn.
+	class RenderThread {
+	public:
+		// Takes the context away from the calling thread
+		RenderThread(GLFWwindow* window, SceneRenderer& renderer);
+		RenderThread(const RenderThread&) = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+		// Finishes the frame in flight and makes the context current on the
+		// calling thread again
+		~RenderThread();
+		// Waits until the render thread has taken the last packet, then
+		// returns the one to fill
+		FramePacket& beginPacket();
+		void publish();
+		// Stats of the newest frame the render thread finished, false when
+		// none arrived since the last call
+		bool getStats(SceneRenderer::Stats& stats);
+	private:
+		void run();
+
+		GLFWwindow* window;
+		SceneRenderer& renderer;
+		TripleBuffer<FramePacket> packets;
+		TripleBuffer<SceneRenderer::Stats> stats;
+		// Only for sleeping, handing data over never takes the lock
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+		std::thread thread;
+	};
+}
@@ -0,0 +1,75 @@
+﻿#include "resolutionScaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+const float ME::ResolutionScaler::MIN_SCALE = .5f;
+const float ME::ResolutionScaler::MAX_SCALE = 1.0f;
+const float ME::ResolutionScaler::STEP = .05f;
+
+namespace {
+	// Weight of the newest frame in the smoothed time
+	const double SMOOTHING = .2;
+	// Aim a little under the budget, so noise doesn't push frames over it
+	const double TARGET = .9;
+	// Grows back only with this much room left, otherwise it would flip
+	// between two steps
+	const double GROW_BELOW = .75;
+}
+
+ME::ResolutionScaler::ResolutionScaler(double budgetMilliseconds) {
+	budget = -1;
+	scale = MAX_SCALE;
+	frameMilliseconds = 0;
+	settleFrames = 0;
+	setBudget(budgetMilliseconds);
+}
+
+void ME::ResolutionScaler::setBudget(double budgetMilliseconds) {
+	budgetMilliseconds = std::max(budgetMilliseconds, 0.0);
+	// Setting the same budget every frame keeps what was learned
+	if (budgetMilliseconds == budget)
+		return;
+	budget = budgetMilliseconds;
+	if (budget == 0)
+		scale = MAX_SCALE;
+	frameMilliseconds = 0;
+	settleFrames = 0;
+}
+
+double ME::ResolutionScaler::getBudget() const {
+	return budget;
+}
+
+void ME::ResolutionScaler::update(double gpuMilliseconds, double cpuMilliseconds) {
+	double measured = gpuMilliseconds > 0 ? gpuMilliseconds : cpuMilliseconds;
+	if (budget == 0 || measured <= 0)
+		return;
+	if (settleFrames > 0) {
+		settleFrames--;
+		return;
+	}
+	frameMilliseconds = frameMilliseconds == 0 ? measured : frameMilliseconds + SMOOTHING * (measured - frameMilliseconds);
+	bool over = frameMilliseconds > budget;
+	if (!over && frameMilliseconds >= budget * GROW_BELOW)
+		return;
+	float wanted = scale * static_cast<float>(std::sqrt(budget * TARGET / frameMilliseconds));
+	// At least one step, or a frame just over the budget would stay there
+	wanted = over ? std::min(wanted, scale - STEP) : std::max(wanted, scale + STEP);
+	wanted = std::round(wanted / STEP) * STEP;
+	wanted = std::min(std::max(wanted, MIN_SCALE), MAX_SCALE);
+	if (std::abs(wanted - scale) < STEP * .5f)
+		return;
+	// What the new scale should take, until measurements catch up
+	frameMilliseconds *= (wanted * wanted) / (scale * scale);
+	scale = wanted;
+	settleFrames = SETTLE_FRAMES;
+}
+
+float ME::ResolutionScaler::getScale() const {
+	return scale;
+}
+
+double ME::ResolutionScaler::getFrameMilliseconds() const {
+	return frameMilliseconds;
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+namespace ME {
+	// Picks the fraction of the output resolution the scene is rendered at,
+	// so frames fit a time budget. A feedback controller on the measured
+	// frame time: shading cost follows the pixel count, so the scale moves
+	// by the square root of how far the time is off, but only once it leaves
+	// a band around the budget. Scales come in steps and every change waits
+	// for the GPU timings to catch up, so targets aren't resized every frame
+	// and the controller doesn't chase its own latency.
+	class ResolutionScaler {
+	public:
+		static const float MIN_SCALE;
+		static const float MAX_SCALE;
+		static const float STEP;
+		// Frames ignored after a change, GPU times come back late, see GpuProfiler
+		static const int SETTLE_FRAMES = 6;
+	public:
+		// A budget of 0 keeps the full resolution
+		explicit ResolutionScaler(double budgetMilliseconds = 0);
+		// A new budget starts the measurements over
+		void setBudget(double budgetMilliseconds);
+		double getBudget() const;
+		// Feeds the last frame's times. The GPU time is what resolution
+		// changes, the CPU time stands in while there is none.
+		void update(double gpuMilliseconds, double cpuMilliseconds);
+		// Per axis, between MIN_SCALE and MAX_SCALE
+		float getScale() const;
+		// Smoothed frame time the controller works on
+		double getFrameMilliseconds() const;
+	private:
+		double budget;
+		float scale;
+		double frameMilliseconds;
+		int settleFrames;
+	};
+}
@@ -0,0 +1,231 @@
+﻿#include "resourceRegistry.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+	struct Registry {
+		std::mutex mutex;
+		std::unordered_map<ME::ResourceRegistry::ID, ME::ResourceRegistry::Entry> entries;
+		ME::ResourceRegistry::ID nextID = 1;
+	};
+
+	// Resources can be created during static initialization
+	Registry& getRegistry() {
+		static Registry registry;
+		return registry;
+	}
+
+	const char* getFormatName(GLenum format) {
+		switch (format) {
+		case GL_NONE: return "-";
+		case GL_RED: return "RED";
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGB: return "RGB";
+		case GL_RGB8: return "RGB8";
+		case GL_RGBA: return "RGBA";
+		case GL_RGBA8: return "RGBA8";
+		case GL_R16F: return "R16F";
+		case GL_RG16F: return "RG16F";
+		case GL_RGB16F: return "RGB16F";
+		case GL_RGBA16F: return "RGBA16F";
+		case GL_R32F: return "R32F";
+		case GL_RG32F: return "RG32F";
+		case GL_RGBA32F: return "RGBA32F";
+		case GL_R16UI: return "R16UI";
+		case GL_RG32UI: return "RG32UI";
+		case GL_R11F_G11F_B10F: return "R11F_G11F_B10F";
+		case GL_RGB10_A2: return "RGB10_A2";
+		case GL_DEPTH_COMPONENT24: return "DEPTH24";
+		case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+		case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+		default: return nullptr;
+		}
+	}
+
+	double toKilobytes(size_t bytes) {
+		return bytes / 1024.0;
+	}
+}
+
+ME::ResourceRegistry::ID ME::ResourceRegistry::add(Category category, const std::string& name, size_t bytes, GLenum format) {
+	Entry entry;
+	entry.category = category;
+	entry.name = name;
+	entry.format = format;
+	entry.levels = 1;
+	entry.levelBytes[0] = bytes;
+	entry.bytes = bytes;
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	entry.id = registry.nextID++;
+	registry.entries[entry.id] = entry;
+	return entry.id;
+}
+
+ME::ResourceRegistry::ID ME::ResourceRegistry::addTexture(const std::string& name, GLenum internalFormat, GLsizei width, GLsizei height, int levels) {
+	Entry entry;
+	entry.category = Category::TEXTURE;
+	entry.name = name;
+	entry.format = internalFormat;
+	entry.levels = levels < MAX_LEVELS ? levels : MAX_LEVELS;
+	size_t bytesPerPixel = getBytesPerPixel(internalFormat);
+	for (int level = 0; level < entry.levels; level++) {
+		size_t levelWidth = std::max<GLsizei>(1, width >> level);
+		size_t levelHeight = std::max<GLsizei>(1, height >> level);
+		entry.levelBytes[level] = levelWidth * levelHeight * bytesPerPixel;
+		entry.bytes += entry.levelBytes[level];
+	}
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	entry.id = registry.nextID++;
+	registry.entries[entry.id] = entry;
+	return entry.id;
+}
+
+void ME::ResourceRegistry::resize(ID id, size_t bytes) {
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	auto found = registry.entries.find(id);
+	if (found == registry.entries.end())
+		return;
+	Entry& entry = found->second;
+	entry.levels = 1;
+	entry.levelBytes[0] = bytes;
+	entry.bytes = bytes;
+}
+
+void ME::ResourceRegistry::remove(ID id) {
+	if (id == 0)
+		return;
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.entries.erase(id);
+}
+
+ME::ResourceRegistry::Totals ME::ResourceRegistry::getTotals() {
+	Totals totals;
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (const auto& pair : registry.entries) {
+		const Entry& entry = pair.second;
+		int category = static_cast<int>(entry.category);
+		totals.bytes[category] += entry.bytes;
+		totals.count[category]++;
+		if (entry.category == Category::CPU)
+			totals.cpuBytes += entry.bytes;
+		else
+			totals.gpuBytes += entry.bytes;
+	}
+	return totals;
+}
+
+std::vector<ME::ResourceRegistry::Entry> ME::ResourceRegistry::getLargest(size_t count) {
+	std::vector<Entry> entries;
+	{
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		entries.reserve(registry.entries.size());
+		for (const auto& pair : registry.entries)
+			entries.push_back(pair.second);
+	}
+	// Ties keep creation order, so dumps are stable between runs
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.bytes != b.bytes ? a.bytes > b.bytes : a.id < b.id;
+	});
+	if (entries.size() > count)
+		entries.resize(count);
+	return entries;
+}
+
+void ME::ResourceRegistry::dump(std::FILE* file, size_t top) {
+	Totals totals = getTotals();
+	std::fprintf(file, "Resource memory: %.1f KB GPU, %.1f KB CPU\n", toKilobytes(totals.gpuBytes), toKilobytes(totals.cpuBytes));
+	for (int category = 0; category < CATEGORY_COUNT; category++) {
+		if (totals.count[category] == 0)
+			continue;
+		std::fprintf(file, "  %-14s %5zu objects %12.1f KB\n", getCategoryName(static_cast<Category>(category)),
+			totals.count[category], toKilobytes(totals.bytes[category]));
+	}
+	std::vector<Entry> entries = getLargest(static_cast<size_t>(-1));
+	// Ordered maps keep the dump stable
+	std::map<GLenum, size_t> formatBytes;
+	size_t levelBytes[MAX_LEVELS] = {};
+	int maxLevels = 0;
+	for (const Entry& entry : entries) {
+		if (entry.format != GL_NONE)
+			formatBytes[entry.format] += entry.bytes;
+		if (entry.category != Category::TEXTURE)
+			continue;
+		for (int level = 0; level < entry.levels; level++)
+			levelBytes[level] += entry.levelBytes[level];
+		maxLevels = std::max(maxLevels, entry.levels);
+	}
+	if (!formatBytes.empty())
+		std::fprintf(file, "By format:\n");
+	for (const auto& pair : formatBytes) {
+		const char* name = getFormatName(pair.first);
+		if (name != nullptr)
+			std::fprintf(file, "  %-16s %12.1f KB\n", name, toKilobytes(pair.second));
+		else
+			std::fprintf(file, "  0x%-14x %12.1f KB\n", pair.first, toKilobytes(pair.second));
+	}
+	if (maxLevels > 0)
+		std::fprintf(file, "Textures by mip level:\n");
+	for (int level = 0; level < maxLevels; level++)
+		std::fprintf(file, "  level %-10d %12.1f KB\n", level, toKilobytes(levelBytes[level]));
+	if (entries.size() > top)
+		entries.resize(top);
+	std::fprintf(file, "Largest %zu:\n", entries.size());
+	for (const Entry& entry : entries) {
+		std::fprintf(file, "  %12.1f KB  %-12s %s\n", toKilobytes(entry.bytes),
+			getCategoryName(entry.category), entry.name.c_str());
+	}
+}
+
+const char* ME::ResourceRegistry::getCategoryName(Category category) {
+	switch (category) {
+	case Category::TEXTURE: return "texture";
+	case Category::RENDERBUFFER: return "renderbuffer";
+	case Category::BUFFER: return "buffer";
+	case Category::VERTEX_ARRAY: return "vertex array";
+	case Category::PROGRAM: return "program";
+	case Category::CPU: return "cpu";
+	}
+	return "unknown";
+}
+
+size_t ME::ResourceRegistry::getBytesPerPixel(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_RED:
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_R16UI:
+		return 2;
+	case GL_RGB16F:
+	case GL_RGBA16F:
+	case GL_RG32F:
+	case GL_RG32UI:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		// RGB8, RGBA8, RGB10_A2, R32F, RG16F, R11F_G11F_B10F and the depth formats
+		return 4;
+	}
+}
+
+int ME::ResourceRegistry::getMipLevelCount(GLsizei width, GLsizei height) {
+	int levels = 1;
+	GLsizei size = std::max(width, height);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
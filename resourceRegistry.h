@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ME {
+	// Memory held by GL objects and large CPU-side buffers. Every allocation
+	// path reports here, so capacity planning can see where memory goes. GL
+	// sizes are estimated from the format, drivers add padding on top.
+	class ResourceRegistry {
+	public:
+		enum class Category { TEXTURE, RENDERBUFFER, BUFFER, VERTEX_ARRAY, PROGRAM, CPU };
+		static const int CATEGORY_COUNT = 6;
+		static const int MAX_LEVELS = 16;
+		// 0 is never handed out, remove() ignores it
+		typedef uint32_t ID;
+		struct Entry {
+			ID id = 0;
+			Category category = Category::CPU;
+			std::string name;
+			GLenum format = GL_NONE;
+			// Bytes per mip level, anything that isn't a texture has one level
+			int levels = 0;
+			size_t levelBytes[MAX_LEVELS] = {};
+			size_t bytes = 0;
+		};
+		struct Totals {
+			size_t bytes[CATEGORY_COUNT] = {};
+			size_t count[CATEGORY_COUNT] = {};
+			size_t gpuBytes = 0;
+			size_t cpuBytes = 0;
+		};
+	public:
+		static ID add(Category category, const std::string& name, size_t bytes, GLenum format = GL_NONE);
+		// A 2D texture with a full or partial mip chain
+		static ID addTexture(const std::string& name, GLenum internalFormat, GLsizei width, GLsizei height, int levels = 1);
+		static void resize(ID id, size_t bytes);
+		static void remove(ID id);
+		static Totals getTotals();
+		// The biggest consumers, largest first
+		static std::vector<Entry> getLargest(size_t count);
+		// Totals by category, format and mip level, then the top consumers
+		static void dump(std::FILE* file, size_t top = 10);
+
+		static const char* getCategoryName(Category category);
+		// Estimated storage, 3 channel formats are padded to 4 by most drivers
+		static size_t getBytesPerPixel(GLenum internalFormat);
+		static int getMipLevelCount(GLsizei width, GLsizei height);
+	};
+}
@@ -0,0 +1,927 @@
+﻿#include "sceneRenderer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+#include "profiler.h"
+#include "vertices.h"
+
+namespace {
+	const uint32_t CONTAINER_MATERIAL = 1;
+	// Texture units of the clustered light buffers, after the material's
+	const unsigned int LIGHT_CLUSTER_UNIT = 2;
+	// The G-buffer's color targets take the material's units in the lighting pass
+	const unsigned int GBUFFER_DEPTH_UNIT = LIGHT_CLUSTER_UNIT + 3;
+	const unsigned int SHADOW_ATLAS_UNIT = GBUFFER_DEPTH_UNIT + 1;
+	// Atlas key of the flashlight, the spot lights use their index
+	const uint64_t FLASHLIGHT_SHADOW_KEY = UINT64_MAX;
+	// Bounding sphere of the unit cube, whatever its rotation
+	const float CUBE_RADIUS = .8660254f;
+	const glm::vec3 CUBE_AXIS = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+	// Degrees per second the hand-placed cubes spin at
+	const float CUBE_SPIN = 50.0f;
+
+	// Small deterministic generator, so every run scatters the same scene
+	float nextRandom(uint32_t& seed) {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	bool sphereInFrustum(const ME::Frustum& frustum, const glm::vec3& center, float radius) {
+		for (const glm::vec4& plane : frustum.planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)
+				return false;
+		}
+		return true;
+	}
+}
+
+const float ME::SceneRenderer::FLASHLIGHT_SHADOW_RANGE = 50.0f;
+const float ME::SceneRenderer::MIN_OCCLUDER_SIZE = .05f;
+
+ME::SceneRenderer::SceneRenderer(const GLExtensions& extensions, FrameStats& frameStats, size_t cubeCount, size_t lightCount)
+	: frameStats(frameStats),
+	// The view's visible list, a caster list per shadow tile and the occluder candidates
+	frameArena(64 * 1024 + cubeCount * sizeof(uint32_t) * (1 + ShadowPacket::MAX_TILES) +
+		cubeCount * sizeof(std::pair<float, uint32_t>) + MAX_OCCLUDERS * sizeof(glm::mat4) +
+		LightClusters::getFrameBytes(lightCount)),
+	frustumCuller(&threadPool),
+	shadowCuller(&threadPool),
+	occlusionCuller(&threadPool) {
+	frameNumber = 0;
+	uniformVersion = 0;
+	uniformWidth = 0;
+	uniformHeight = 0;
+	shadowUniformVersion = 0;
+	shadingPath = ShadingPath::FORWARD;
+	depthPrepass = false;
+	shadowCaching = true;
+	occlusionCulling = false;
+	staticSceneVersion = 1;
+	shadowVersion = 0;
+	flashlightTile = -1;
+	createGeometry();
+
+	// Loading textures
+	diffuseTexture = std::make_unique<Texture>("container2.png");
+	specularTexture = std::make_unique<Texture>("container2_specular.png");
+	// Create and compile shaders
+	lightingShader = std::make_unique<Shader>("lightingInstanced.vert", "lighting.frag");
+	lightCubeShader = std::make_unique<Shader>("lightCube.vert", "lightCube.frag");
+	gBufferShader = std::make_unique<Shader>("lightingInstanced.vert", "gBuffer.frag");
+	deferredLightingShader = std::make_unique<Shader>("deferredLighting.vert", "deferredLighting.frag");
+	depthShader = std::make_unique<Shader>("depthOnly.vert", "depthOnly.frag");
+	shadowShader = std::make_unique<Shader>("depthOnly.vert", "depthOnly.frag");
+	upscaleShader = std::make_unique<Shader>("upscale.vert", "upscale.frag");
+	lightClusters = std::make_unique<LightClusters>(&threadPool);
+	shadowAtlas = std::make_unique<ShadowAtlas>();
+	// Setup above went around the state cache
+	glState.invalidate();
+
+	glState.useProgram(lightingShader->ID);
+	// 为diffuse指定所使用的纹理单元（GL_TEXTURE0）
+	lightingShader->setInt("material.diffuse", 0);
+	// 为specular指定所使用的纹理单元（GL_TEXTURE1）
+	lightingShader->setInt("material.specular", 1);
+	lightingShader->setInt("lightData", LIGHT_CLUSTER_UNIT);
+	lightingShader->setInt("clusterRanges", LIGHT_CLUSTER_UNIT + 1);
+	lightingShader->setInt("clusterLights", LIGHT_CLUSTER_UNIT + 2);
+	lightingShader->setInt("shadowAtlas", SHADOW_ATLAS_UNIT);
+	// Setting block materials
+	lightingShader->setFloat("material.shininess", 16.f);
+	// Setting light colors
+	lightingShader->setVec3("light.specular", glm::vec3(1.f, 1.f, 1.f));
+	glState.useProgram(gBufferShader->ID);
+	gBufferShader->setInt("material.diffuse", 0);
+	gBufferShader->setInt("material.specular", 1);
+	glState.useProgram(deferredLightingShader->ID);
+	deferredLightingShader->setInt("gAlbedoSpecular", 0);
+	deferredLightingShader->setInt("gNormal", 1);
+	deferredLightingShader->setInt("gDepth", GBUFFER_DEPTH_UNIT);
+	deferredLightingShader->setInt("lightData", LIGHT_CLUSTER_UNIT);
+	deferredLightingShader->setInt("clusterRanges", LIGHT_CLUSTER_UNIT + 1);
+	deferredLightingShader->setInt("clusterLights", LIGHT_CLUSTER_UNIT + 2);
+	deferredLightingShader->setInt("shadowAtlas", SHADOW_ATLAS_UNIT);
+	deferredLightingShader->setFloat("material.shininess", 16.f);
+	deferredLightingShader->setVec3("light.specular", glm::vec3(1.f, 1.f, 1.f));
+	// Tiles carry the light's whole view-projection
+	glState.useProgram(shadowShader->ID);
+	shadowShader->setMatrix4f("view", glm::mat4(1.0f));
+	glState.useProgram(upscaleShader->ID);
+	upscaleShader->setInt("frame", 0);
+	// Set the rendering mode
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	// Enable depth testing
+	glState.enable(GL_DEPTH_TEST);
+
+	// Draw submission
+	if (cubeCount < BASE_CUBE_COUNT)
+		cubeCount = BASE_CUBE_COUNT;
+	// With the depth pre-pass every cube is drawn twice a frame, and each
+	// shadow tile may draw every cube again when the cache is off, same
+	// bound as the caster lists in the frame arena
+	GLsizei maxDraws = static_cast<GLsizei>(cubeCount * (2 + ShadowPacket::MAX_TILES));
+	indirectRenderer = std::make_unique<IndirectRenderer>(extensions, glState, maxDraws);
+	indirectRenderer->attachInstanceAttributes(glState, sceneVAO, 3);
+	indirectRenderer->attachInstanceAttributes(glState, depthVAO, 3);
+	fragmentCounter = std::make_unique<FragmentCounter>(extensions);
+	cubePacket.program = lightingShader->ID;
+	cubePacket.vao = sceneVAO;
+	cubePacket.textures[0] = diffuseTexture->getGlID();
+	cubePacket.textures[1] = specularTexture->getGlID();
+	cubePacket.mode = GL_TRIANGLES;
+	cubePacket.indexed = true;
+	cubePacket.first = 0;
+	cubePacket.count = 36;
+	gBufferPacket = cubePacket;
+	gBufferPacket.program = gBufferShader->ID;
+	// No textures, so the whole pre-pass shares one bucket
+	depthPacket = cubePacket;
+	depthPacket.program = depthShader->ID;
+	depthPacket.vao = depthVAO;
+	depthPacket.textures[0] = 0;
+	depthPacket.textures[1] = 0;
+	shadowPacket = depthPacket;
+	shadowPacket.program = shadowShader->ID;
+	createScene(cubeCount);
+	createLights(lightCount);
+	// Every flush holds a single pass, over every cube at most
+	renderQueue.reserve(cubeCount);
+
+	drawsChannel = frameStats.addChannel("draws");
+	stateChangesChannel = frameStats.addChannel("state changes");
+	glIssuedChannel = frameStats.addChannel("gl calls");
+	glFilteredChannel = frameStats.addChannel("gl filtered");
+	drawCallsChannel = frameStats.addChannel(indirectRenderer->isMultiDraw() ? "multi-draw calls" : "instanced calls");
+	droppedDrawsChannel = frameStats.addChannel("dropped draws");
+	culledChannel = frameStats.addChannel("culled");
+	cullTimeChannel = frameStats.addChannel("cull", "ms");
+	occludedChannel = frameStats.addChannel("occluded", "%");
+	occlusionTimeChannel = frameStats.addChannel("occlusion", "ms");
+	arenaChannel = frameStats.addChannel("arena", "KB");
+	// Recorded here rather than by the profiler, which may live on the render thread
+	gpuFrameChannel = frameStats.addChannel("gpu frame", "ms");
+	gpuLightingChannel = frameStats.addChannel("gpu lighting", "ms");
+	gpuGeometryChannel = frameStats.addChannel("gpu geometry", "ms");
+	gpuDepthChannel = frameStats.addChannel("gpu depth", "ms");
+	gpuShadowChannel = frameStats.addChannel("gpu shadows", "ms");
+	shadowRendersChannel = frameStats.addChannel("shadow renders");
+	shadowCastersChannel = frameStats.addChannel("shadow casters");
+	fragmentsChannel = frameStats.addChannel("fragments", "K");
+	lightReferencesChannel = frameStats.addChannel("light refs");
+	lightTimeChannel = frameStats.addChannel("light assign", "ms");
+	resolutionChannel = frameStats.addChannel("resolution", "%");
+	cpuTimeChannel = frameStats.addChannel("render cpu", "ms");
+	gpuFramePass = gpuProfiler.addPass("gpu frame");
+	gpuLightingPass = gpuProfiler.addPass("gpu lighting");
+	gpuGeometryPass = gpuProfiler.addPass("gpu geometry");
+	gpuDepthPass = gpuProfiler.addPass("gpu depth");
+	gpuShadowPass = gpuProfiler.addPass("gpu shadows");
+
+	typedef ResourceRegistry::Category Category;
+	memoryIDs.push_back(ResourceRegistry::add(Category::BUFFER, "cube vertices", sizeof(vertices)));
+	memoryIDs.push_back(ResourceRegistry::add(Category::BUFFER, "cube indices", 36 * sizeof(GLuint)));
+	memoryIDs.push_back(ResourceRegistry::add(Category::BUFFER, "cube positions", 36 * 3 * sizeof(float)));
+	memoryIDs.push_back(ResourceRegistry::add(Category::VERTEX_ARRAY, "scene VAO", 0));
+	memoryIDs.push_back(ResourceRegistry::add(Category::VERTEX_ARRAY, "light cube VAO", 0));
+	memoryIDs.push_back(ResourceRegistry::add(Category::VERTEX_ARRAY, "screen VAO", 0));
+	memoryIDs.push_back(ResourceRegistry::add(Category::VERTEX_ARRAY, "depth VAO", 0));
+	memoryIDs.push_back(ResourceRegistry::add(Category::CPU, "cube transforms and bounds",
+		cubeModels.capacity() * sizeof(glm::mat4) + cubeBounds.size() * 4 * sizeof(float)));
+	memoryIDs.push_back(ResourceRegistry::add(Category::CPU, "lights",
+		lights.capacity() * sizeof(Light) + lightAnchors.capacity() * sizeof(glm::vec3) +
+		shadowCandidates.capacity() * sizeof(std::pair<float, size_t>)));
+	// The arena double buffers
+	memoryIDs.push_back(ResourceRegistry::add(Category::CPU, "frame arena", frameArena.getCapacity() * 2));
+}
+
+ME::SceneRenderer::~SceneRenderer() {
+	indirectRenderer.reset();
+	fragmentCounter.reset();
+	gBuffer.reset();
+	sceneTarget.reset();
+	shadowAtlas.reset();
+	glDeleteVertexArrays(1, &sceneVAO);
+	glDeleteVertexArrays(1, &lightCubeVAO);
+	glDeleteVertexArrays(1, &screenVAO);
+	glDeleteVertexArrays(1, &depthVAO);
+	glDeleteBuffers(1, &positionVBO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	for (ResourceRegistry::ID id : memoryIDs)
+		ResourceRegistry::remove(id);
+}
+
+void ME::SceneRenderer::createGeometry() {
+	// Setting up VBO
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// Setting up scene VAO
+	glGenVertexArrays(1, &sceneVAO);
+	glBindVertexArray(sceneVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	// Indirect draws need indices, the cube's are trivial
+	GLuint cubeIndices[36];
+	for (GLuint i = 0; i < 36; i++)
+		cubeIndices[i] = i;
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+	// Setting up light cube VAO
+	glGenVertexArrays(1, &lightCubeVAO);
+	glBindVertexArray(lightCubeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// Core profiles draw nothing without a VAO, even with no attributes
+	glGenVertexArrays(1, &screenVAO);
+	// Setting up the depth pre-pass VAO, positions only and the same indices
+	float positions[36 * 3];
+	for (int i = 0; i < 36; i++) {
+		for (int axis = 0; axis < 3; axis++)
+			positions[i * 3 + axis] = vertices[i * 8 + axis];
+	}
+	glGenBuffers(1, &positionVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+	glGenVertexArrays(1, &depthVAO);
+	glBindVertexArray(depthVAO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+}
+
+void ME::SceneRenderer::createScene(size_t cubeCount) {
+	uint32_t seed = 1;
+	// Composed as one batch, with many cubes this is most of the startup
+	simd::TransformBatch transforms;
+	transforms.reserve(cubeCount);
+	BoundingBoxes localBoxes;
+	localBoxes.reserve(cubeCount);
+	for (size_t i = 0; i < cubeCount; i++) {
+		glm::vec3 position;
+		if (i < BASE_CUBE_COUNT) {
+			position = cubePositions[i];
+		}
+		else {
+			position.x = nextRandom(seed) * 60.0f - 30.0f;
+			position.y = nextRandom(seed) * 30.0f - 15.0f;
+			position.z = nextRandom(seed) * -60.0f - 5.0f;
+		}
+		float angle = 20.0f * i;
+		transforms.add(position, glm::angleAxis(glm::radians(angle), CUBE_AXIS));
+		localBoxes.add(glm::vec3(-.5f), glm::vec3(.5f));
+	}
+	simd::MatrixBatch models;
+	simd::composeTRS(transforms, models);
+	BoundingBoxes worldBoxes;
+	simd::transformBounds(models, localBoxes, worldBoxes);
+
+	cubeModels.resize(cubeCount);
+	cubeBounds.reserve(cubeCount);
+	std::vector<AABB> cubeBoxes(cubeCount);
+	for (size_t i = 0; i < cubeCount; i++) {
+		cubeModels[i] = models.get(i);
+		// Unit cube, rotation doesn't matter for the sphere
+		cubeBounds.add(glm::vec3(cubeModels[i][3]), CUBE_RADIUS);
+		glm::vec3 center(worldBoxes.centerX[i], worldBoxes.centerY[i], worldBoxes.centerZ[i]);
+		glm::vec3 extent(worldBoxes.extentX[i], worldBoxes.extentY[i], worldBoxes.extentZ[i]);
+		// The spinning cubes get a box around the sphere, so it holds at any angle
+		if (i < BASE_CUBE_COUNT)
+			extent = glm::vec3(CUBE_RADIUS);
+		cubeBoxes[i] = { center - extent, center + extent };
+	}
+	sceneBVH.build(cubeBoxes);
+}
+
+void ME::SceneRenderer::createLights(size_t lightCount) {
+	uint32_t seed = 7;
+	lights.resize(lightCount);
+	lightAnchors.resize(lightCount);
+	shadowCandidates.reserve(lightCount);
+	shadowedLights.reserve(ShadowPacket::MAX_TILES);
+	for (size_t i = 0; i < lightCount; i++) {
+		// The first few hang over the hand-placed cubes, the rest fill the field
+		if (i < BASE_CUBE_COUNT) {
+			lightAnchors[i] = cubePositions[i] + glm::vec3(0.0f, 1.5f, 0.0f);
+		}
+		else {
+			lightAnchors[i].x = nextRandom(seed) * 60.0f - 30.0f;
+			lightAnchors[i].y = nextRandom(seed) * 30.0f - 15.0f;
+			lightAnchors[i].z = nextRandom(seed) * -60.0f - 5.0f;
+		}
+		Light& light = lights[i];
+		// Every fourth one is a spot light shining down. Those stay put, so
+		// their shadows can be cached.
+		light.type = i % 4 == 3 ? Light::Type::SPOT : Light::Type::POINT;
+		light.range = 4.0f + nextRandom(seed) * 3.0f;
+		glm::vec3 color(nextRandom(seed), nextRandom(seed), nextRandom(seed));
+		light.color = color / std::max(color.x, std::max(color.y, color.z)) * 3.0f;
+		light.cutOff = glm::cos(glm::radians(20.0f));
+		light.outerCutOff = glm::cos(glm::radians(30.0f));
+		light.position = lightAnchors[i];
+	}
+	animateLights(0);
+}
+
+void ME::SceneRenderer::animateLights(uint64_t frame) {
+	float time = frame / 60.0f;
+	for (size_t i = 0; i < lights.size(); i++) {
+		if (lights[i].type == Light::Type::SPOT)
+			continue;
+		float phase = i * 2.39996f;
+		float angle = time + phase;
+		lights[i].position = lightAnchors[i] + glm::vec3(std::cos(angle) * 2.0f, std::sin(angle * 1.7f) * .5f, std::sin(angle) * 2.0f);
+	}
+}
+
+void ME::SceneRenderer::animateCubes(FramePacket& packet) {
+	float time = packet.frame / 60.0f;
+	glm::mat4* models = frameArena.allocateArray<glm::mat4>(BASE_CUBE_COUNT);
+	for (size_t i = 0; i < BASE_CUBE_COUNT; i++) {
+		float angle = 20.0f * i + CUBE_SPIN * time;
+		models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), cubePositions[i]), glm::radians(angle), CUBE_AXIS);
+	}
+	packet.dynamicModels = models;
+	packet.dynamicCount = BASE_CUBE_COUNT;
+}
+
+const glm::mat4& ME::SceneRenderer::getCubeModel(const FramePacket& packet, uint32_t cube) const {
+	return cube < packet.dynamicCount ? packet.dynamicModels[cube] : cubeModels[cube];
+}
+
+void ME::SceneRenderer::setLightUniforms(const Shader& shader, const FramePacket& packet) {
+	// Setting light properties
+	const SpotLight& light = packet.light;
+	shader.setVec3("light.position", light.position);
+	shader.setVec3("light.direction", light.direction);
+	shader.setFloat("light.cutOff", light.cutOff);
+	shader.setFloat("light.outerCutOff", light.outerCutOff);
+	shader.setVec3("light.ambient", light.ambient);
+	shader.setVec3("light.diffuse", light.diffuse);
+	shader.setFloat("light.constant", light.constant);
+	shader.setFloat("light.linear", light.linear);
+	shader.setFloat("light.quadratic", light.quadratic);
+	shader.setVec3("viewPos", packet.cameraPosition);
+	// Both only change with the viewport and projection
+	shader.setVec2("clusterScreenScale", packet.lightClusters.screenScale);
+	shader.setVec2("clusterDepthScale", packet.lightClusters.depthScale);
+}
+
+void ME::SceneRenderer::setUniforms(const FramePacket& packet) {
+	// 渲染场景模型
+	// Passing MVP matrices
+	glState.useProgram(lightingShader->ID);
+	setLightUniforms(*lightingShader, packet);
+	// Passing view and projection matrices
+	lightingShader->setMatrix4f("view", packet.view);
+	lightingShader->setMatrix4f("projection", packet.projection);
+	// Both paths are kept current, so switching needs no special case
+	glState.useProgram(gBufferShader->ID);
+	gBufferShader->setMatrix4f("view", packet.view);
+	gBufferShader->setMatrix4f("projection", packet.projection);
+	glState.useProgram(depthShader->ID);
+	depthShader->setMatrix4f("view", packet.view);
+	depthShader->setMatrix4f("projection", packet.projection);
+	glState.useProgram(deferredLightingShader->ID);
+	setLightUniforms(*deferredLightingShader, packet);
+	deferredLightingShader->setMatrix4f("inverseProjection", glm::inverse(packet.projection));
+	deferredLightingShader->setMatrix4f("inverseView", glm::inverse(packet.view));
+	deferredLightingShader->setVec2("frameSize", glm::vec2(packet.width, packet.height));
+}
+
+void ME::SceneRenderer::setShadowUniforms(const Shader& shader, const ShadowPacket& shadows) {
+	shader.setMatrix4fArray("shadowMatrices", shadows.atlasMatrices, ShadowPacket::MAX_TILES);
+	shader.setInt("flashlightShadow", shadows.flashlightTile);
+}
+
+void ME::SceneRenderer::prepare(const Camera& camera, FramePacket& packet) {
+	ME_PROFILE_FUNCTION();
+	frameArena.beginFrame();
+	packet.frame = frameNumber++;
+	packet.outputWidth = camera.getViewportWidth();
+	packet.outputHeight = camera.getViewportHeight();
+	// The projection keeps the output's aspect, both axes scale alike
+	packet.resolutionScale = resolutionScaler.getScale();
+	packet.width = std::max(1, static_cast<int>(std::lround(packet.outputWidth * packet.resolutionScale)));
+	packet.height = std::max(1, static_cast<int>(std::lround(packet.outputHeight * packet.resolutionScale)));
+	// Setting view, and projection matrix
+	packet.cameraVersion = camera.getVersion();
+	packet.view = camera.getViewMatrix();
+	packet.projection = camera.getProjectionMatrix();
+	packet.cameraPosition = camera.getPosition();
+	packet.cameraFront = camera.getFront();
+	packet.shadingPath = shadingPath;
+	packet.depthPrepass = depthPrepass;
+	packet.occlusionCulling = occlusionCulling;
+	// The flashlight follows the camera
+	SpotLight& light = packet.light;
+	light.position = camera.getPosition();
+	light.direction = camera.getFront();
+	light.cutOff = glm::cos(glm::radians(12.5f));
+	light.outerCutOff = glm::cos(glm::radians(17.5f));
+	glm::vec3 lightColor = glm::vec3(1.0f);
+	light.diffuse = lightColor;
+	light.ambient = light.diffuse * .3f;
+	light.constant = 1.0f;
+	light.linear = 0.09f;
+	light.quadratic = 0.032f;
+	// Record the visible cubes
+	uint32_t* visibleCubes = frameArena.allocateArray<uint32_t>(cubeBounds.size());
+	{
+		ME_PROFILE_SCOPE("cull");
+		packet.visibleCount = frustumCuller.cull(camera.getFrustum(), cubeBounds, visibleCubes);
+	}
+	packet.culled = frustumCuller.getStats().culled;
+	packet.cullMilliseconds = frustumCuller.getStats().milliseconds;
+	// The occluders need this frame's models
+	animateCubes(packet);
+	packet.occluded = 0;
+	packet.occludedFraction = 0;
+	packet.occlusionMilliseconds = 0;
+	if (packet.occlusionCulling)
+		cullOccluded(packet, visibleCubes);
+	packet.visible = visibleCubes;
+	{
+		ME_PROFILE_SCOPE("lights");
+		animateLights(packet.frame);
+		// The spot lights' tiles go into the cluster data
+		prepareShadows(camera, packet);
+		lightClusters->assign(lights, packet.view, packet.projection, packet.width, packet.height,
+			frameArena, packet.lightClusters);
+	}
+}
+
+void ME::SceneRenderer::cullOccluded(FramePacket& packet, uint32_t* visibleCubes) {
+	ME_PROFILE_SCOPE("occlusion");
+	// The cubes covering the most screen hide the most
+	typedef std::pair<float, uint32_t> Candidate;
+	Candidate* candidates = frameArena.allocateArray<Candidate>(packet.visibleCount);
+	size_t candidateCount = 0;
+	for (size_t i = 0; i < packet.visibleCount; i++) {
+		uint32_t cube = visibleCubes[i];
+		float radius = cubeBounds.radius[cube];
+		glm::vec3 center(cubeBounds.x[cube], cubeBounds.y[cube], cubeBounds.z[cube]);
+		float depth = glm::dot(center - packet.cameraPosition, packet.cameraFront);
+		if (depth <= radius || radius < MIN_OCCLUDER_SIZE * depth)
+			continue;
+		candidates[candidateCount++] = Candidate(radius / depth, cube);
+	}
+	size_t occluderCount = std::min(candidateCount, static_cast<size_t>(MAX_OCCLUDERS));
+	std::partial_sort(candidates, candidates + occluderCount, candidates + candidateCount, std::greater<Candidate>());
+	glm::mat4* models = frameArena.allocateArray<glm::mat4>(occluderCount);
+	for (size_t i = 0; i < occluderCount; i++)
+		models[i] = getCubeModel(packet, candidates[i].second);
+	occlusionCuller.renderOccluders(packet.projection * packet.view, models, occluderCount);
+	size_t tested = packet.visibleCount;
+	packet.visibleCount = occlusionCuller.cull(cubeBounds, visibleCubes, packet.visibleCount);
+	packet.occluded = occlusionCuller.getStats().occluded;
+	packet.occludedFraction = tested > 0 ? static_cast<float>(packet.occluded) / tested : 0.0f;
+	packet.occlusionMilliseconds = occlusionCuller.getStats().milliseconds;
+}
+
+void ME::SceneRenderer::prepareShadows(const Camera& camera, FramePacket& packet) {
+	ME_PROFILE_SCOPE("shadows");
+	ShadowPacket& shadows = packet.shadows;
+	shadows = ShadowPacket();
+	if (!shadowCaching)
+		shadowAtlas->invalidate();
+	shadowAtlas->beginFrame(staticSceneVersion);
+	bool changed = false;
+	// The flashlight first, so it always has a tile
+	ShadowAtlas::SpotShadow flashlight;
+	flashlight.position = packet.light.position;
+	flashlight.direction = packet.light.direction;
+	flashlight.outerCutOff = packet.light.outerCutOff;
+	flashlight.range = FLASHLIGHT_SHADOW_RANGE;
+	shadows.flashlightTile = addShadowTile(FLASHLIGHT_SHADOW_KEY, flashlight, packet);
+	changed |= shadows.flashlightTile != flashlightTile;
+	flashlightTile = shadows.flashlightTile;
+	// Then the spot lights that reach into the view, nearest first
+	for (size_t i : shadowedLights)
+		lights[i].shadow = -1;
+	shadowedLights.clear();
+	shadowCandidates.clear();
+	const Frustum& frustum = camera.getFrustum();
+	for (size_t i = 0; i < lights.size(); i++) {
+		const Light& light = lights[i];
+		if (light.type != Light::Type::SPOT || !sphereInFrustum(frustum, light.position, light.range))
+			continue;
+		glm::vec3 offset = light.position - packet.cameraPosition;
+		shadowCandidates.push_back({ glm::dot(offset, offset), i });
+	}
+	size_t count = std::min<size_t>(shadowCandidates.size(), ShadowPacket::MAX_TILES - 1);
+	std::partial_sort(shadowCandidates.begin(), shadowCandidates.begin() + count, shadowCandidates.end());
+	for (size_t c = 0; c < count; c++) {
+		Light& light = lights[shadowCandidates[c].second];
+		ShadowAtlas::SpotShadow spot;
+		spot.position = light.position;
+		spot.direction = light.direction;
+		spot.outerCutOff = light.outerCutOff;
+		spot.range = light.range;
+		light.shadow = addShadowTile(shadowCandidates[c].second, spot, packet);
+		if (light.shadow < 0)
+			break;
+		shadowedLights.push_back(shadowCandidates[c].second);
+	}
+	for (const ShadowTile& tile : shadows.tiles)
+		changed |= tile.renderStatic;
+	// Matrices only change with a tile's light, so a still scene sets them once
+	if (changed)
+		shadowVersion++;
+	shadows.version = shadowVersion;
+}
+
+int ME::SceneRenderer::addShadowTile(uint64_t key, const ShadowAtlas::SpotShadow& light, FramePacket& packet) {
+	bool stale = false;
+	int index = shadowAtlas->request(key, light, stale);
+	if (index < 0)
+		return -1;
+	ShadowPacket& shadows = packet.shadows;
+	ShadowTile& tile = shadows.tiles[index];
+	tile.active = true;
+	tile.viewProjection = shadowAtlas->getViewProjection(index);
+	shadows.atlasMatrices[index] = shadowAtlas->getAtlasMatrix(index);
+	Frustum frustum = Frustum::fromMatrix(tile.viewProjection);
+	uint32_t dynamicCount = static_cast<uint32_t>(packet.dynamicCount);
+	if (stale) {
+		// Everything the light sees. The list is ascending, so the spinning
+		// cubes come first and the static ones follow.
+		uint32_t* casters = frameArena.allocateArray<uint32_t>(cubeBounds.size());
+		size_t count = shadowCuller.cull(frustum, cubeBounds, casters);
+		size_t split = std::lower_bound(casters, casters + count, dynamicCount) - casters;
+		tile.renderStatic = true;
+		tile.staticCasters = casters + split;
+		tile.staticCount = count - split;
+		tile.dynamicCasters = casters;
+		tile.dynamicCount = split;
+		shadowAtlas->markCached(index);
+		shadows.staticRenders++;
+	}
+	else {
+		// The static depth is cached, only the spinning cubes are looked at
+		uint32_t* casters = frameArena.allocateArray<uint32_t>(dynamicCount);
+		for (uint32_t i = 0; i < dynamicCount; i++) {
+			if (sphereInFrustum(frustum, glm::vec3(packet.dynamicModels[i][3]), CUBE_RADIUS))
+				casters[tile.dynamicCount++] = i;
+		}
+		tile.dynamicCasters = casters;
+	}
+	if (tile.dynamicCount > 0)
+		shadows.dynamicRenders++;
+	shadows.casters += static_cast<unsigned int>(tile.staticCount + tile.dynamicCount);
+	return index;
+}
+
+void ME::SceneRenderer::submitCubes(const FramePacket& packet, const uint32_t* cubes, size_t count,
+	const DrawPacket& drawPacket, RenderQueue::Pass pass) {
+	// Let the queue sort the cubes by state and depth
+	ME_PROFILE_SCOPE("submit");
+	for (size_t c = 0; c < count; c++) {
+		const glm::mat4& model = getCubeModel(packet, cubes[c]);
+		glm::vec3 position = glm::vec3(model[3]);
+		float depth = glm::dot(position - packet.cameraPosition, packet.cameraFront) / Camera::FAR_PLANE;
+		uint64_t key = RenderQueue::makeSortKey(pass,
+			drawPacket.program, CONTAINER_MATERIAL, drawPacket.vao, depth);
+		renderQueue.submit(key, drawPacket, model);
+	}
+}
+
+void ME::SceneRenderer::renderShadows(const FramePacket& packet) {
+	const ShadowPacket& shadows = packet.shadows;
+	if (shadows.version != shadowUniformVersion) {
+		glState.useProgram(lightingShader->ID);
+		setShadowUniforms(*lightingShader, shadows);
+		glState.useProgram(deferredLightingShader->ID);
+		setShadowUniforms(*deferredLightingShader, shadows);
+		shadowUniformVersion = shadows.version;
+	}
+	ME_PROFILE_SCOPE("shadows");
+	gpuProfiler.beginPass(gpuShadowPass);
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	// Slope scaled, against acne where the light grazes a face
+	glState.enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	glState.useProgram(shadowShader->ID);
+	// Up to two flushes a tile, all of them counted in the frame's draws
+	for (int i = 0; i < ShadowPacket::MAX_TILES; i++) {
+		const ShadowTile& tile = shadows.tiles[i];
+		if (!tile.active)
+			continue;
+		shadowShader->setMatrix4f("projection", tile.viewProjection);
+		if (tile.renderStatic) {
+			shadowAtlas->beginStatic(i, glState);
+			submitCubes(packet, tile.staticCasters, tile.staticCount, shadowPacket, RenderQueue::Pass::DEPTH);
+			renderQueue.flush(glState, *indirectRenderer);
+		}
+		if (shadowAtlas->beginLive(i, tile.renderStatic, tile.dynamicCount > 0, glState)) {
+			submitCubes(packet, tile.dynamicCasters, tile.dynamicCount, shadowPacket, RenderQueue::Pass::DEPTH);
+			renderQueue.flush(glState, *indirectRenderer);
+		}
+	}
+	shadowAtlas->end(glState);
+	glState.disable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	gpuProfiler.endPass(gpuShadowPass);
+}
+
+void ME::SceneRenderer::renderDepthPrepass(const FramePacket& packet) {
+	// Front to back within the one bucket, like the opaque pass
+	submitCubes(packet, packet.visible, packet.visibleCount, depthPacket, RenderQueue::Pass::DEPTH);
+	ME_PROFILE_SCOPE("depth prepass");
+	gpuProfiler.beginPass(gpuDepthPass);
+	glState.colorMask(false);
+	renderQueue.flush(glState, *indirectRenderer);
+	glState.colorMask(true);
+	gpuProfiler.endPass(gpuDepthPass);
+}
+
+void ME::SceneRenderer::setDepthEqual(bool enabled) {
+	glState.depthFunc(enabled ? GL_EQUAL : GL_LESS);
+	glState.depthMask(!enabled);
+}
+
+void ME::SceneRenderer::renderForward(const FramePacket& packet) {
+	glViewport(0, 0, packet.width, packet.height);
+	// Clear the screen
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (packet.depthPrepass)
+		renderDepthPrepass(packet);
+	submitCubes(packet, packet.visible, packet.visibleCount, cubePacket, RenderQueue::Pass::OPAQUE_GEOMETRY);
+	{
+		ME_PROFILE_SCOPE("flush");
+		gpuProfiler.beginPass(gpuLightingPass);
+		lightClusters->upload(packet.lightClusters, glState);
+		lightClusters->bind(glState, LIGHT_CLUSTER_UNIT);
+		glState.bindTexture(SHADOW_ATLAS_UNIT, GL_TEXTURE_2D, shadowAtlas->getTexture());
+		setDepthEqual(packet.depthPrepass);
+		fragmentCounter->begin();
+		renderQueue.flush(glState, *indirectRenderer);
+		fragmentCounter->end();
+		setDepthEqual(false);
+		gpuProfiler.endPass(gpuLightingPass);
+	}
+}
+
+void ME::SceneRenderer::renderDeferred(const FramePacket& packet) {
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	// Sized to the output like sceneTarget, a scaled frame is drawn into its
+	// corner, so only a new viewport reallocates. Both go around the state cache.
+	if (!gBuffer) {
+		gBuffer = std::make_unique<GBuffer>(packet.outputWidth, packet.outputHeight);
+		glState.invalidate();
+	}
+	else if (gBuffer->getWidth() != packet.outputWidth || gBuffer->getHeight() != packet.outputHeight) {
+		gBuffer->resize(packet.outputWidth, packet.outputHeight);
+		glState.invalidate();
+	}
+	gBuffer->bind();
+	glViewport(0, 0, packet.width, packet.height);
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (packet.depthPrepass)
+		renderDepthPrepass(packet);
+	submitCubes(packet, packet.visible, packet.visibleCount, gBufferPacket, RenderQueue::Pass::OPAQUE_GEOMETRY);
+	{
+		ME_PROFILE_SCOPE("flush");
+		gpuProfiler.beginPass(gpuGeometryPass);
+		setDepthEqual(packet.depthPrepass);
+		fragmentCounter->begin();
+		renderQueue.flush(glState, *indirectRenderer);
+		fragmentCounter->end();
+		setDepthEqual(false);
+		gpuProfiler.endPass(gpuGeometryPass);
+	}
+	// The scene's depth goes to the target as well, it keeps later passes
+	// working and lets the lighting pass skip the empty background
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer->getID());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(0, 0, packet.width, packet.height, 0, 0, packet.width, packet.height,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, packet.width, packet.height);
+	glClear(GL_COLOR_BUFFER_BIT);
+	{
+		ME_PROFILE_SCOPE("lighting");
+		gpuProfiler.beginPass(gpuLightingPass);
+		lightClusters->upload(packet.lightClusters, glState);
+		lightClusters->bind(glState, LIGHT_CLUSTER_UNIT);
+		glState.useProgram(deferredLightingShader->ID);
+		glState.bindTexture(0, GL_TEXTURE_2D, gBuffer->getAlbedoSpecularTexture());
+		glState.bindTexture(1, GL_TEXTURE_2D, gBuffer->getNormalTexture());
+		glState.bindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, gBuffer->getDepthTexture());
+		glState.bindTexture(SHADOW_ATLAS_UNIT, GL_TEXTURE_2D, shadowAtlas->getTexture());
+		glState.bindVertexArray(screenVAO);
+		// The triangle lies on the far plane, so only pixels with geometry pass
+		glState.depthFunc(GL_GREATER);
+		glState.depthMask(false);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glState.depthMask(true);
+		glState.depthFunc(GL_LESS);
+		gpuProfiler.endPass(gpuLightingPass);
+	}
+}
+
+void ME::SceneRenderer::upscale(const FramePacket& packet, GLint target) {
+	ME_PROFILE_SCOPE("upscale");
+	// A textured triangle rather than a scaling blit, which some drivers
+	// run on a much slower path. Only color goes over.
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, packet.outputWidth, packet.outputHeight);
+	float textureWidth = static_cast<float>(sceneTarget->getWidth());
+	float textureHeight = static_cast<float>(sceneTarget->getHeight());
+	glState.useProgram(upscaleShader->ID);
+	upscaleShader->setVec2("frameScale", glm::vec2(packet.width / textureWidth, packet.height / textureHeight));
+	upscaleShader->setVec2("frameLimit", glm::vec2((packet.width - .5f) / textureWidth, (packet.height - .5f) / textureHeight));
+	glState.bindTexture(0, GL_TEXTURE_2D, sceneTarget->getColorTexture());
+	glState.bindVertexArray(screenVAO);
+	glState.disable(GL_DEPTH_TEST);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glState.enable(GL_DEPTH_TEST);
+}
+
+void ME::SceneRenderer::render(const FramePacket& packet) {
+	auto start = std::chrono::steady_clock::now();
+	glState.resetStats();
+	renderQueue.resetStats();
+	indirectRenderer->beginFrame();
+	gpuProfiler.beginFrame();
+	gpuProfiler.beginPass(gpuFramePass);
+	// Every uniform follows the camera and the frame size, so a camera at
+	// rest needs none
+	if (packet.cameraVersion != uniformVersion || packet.width != uniformWidth || packet.height != uniformHeight) {
+		ME_PROFILE_SCOPE("uniforms");
+		setUniforms(packet);
+		uniformVersion = packet.cameraVersion;
+		uniformWidth = packet.width;
+		uniformHeight = packet.height;
+	}
+	bool scaled = packet.width != packet.outputWidth || packet.height != packet.outputHeight;
+	GLint target = 0;
+	if (scaled) {
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+		if (!sceneTarget || sceneTarget->getWidth() != packet.outputWidth || sceneTarget->getHeight() != packet.outputHeight) {
+			sceneTarget.reset();
+			sceneTarget = std::make_unique<Framebuffer>(packet.outputWidth, packet.outputHeight);
+			// Went around the state cache
+			glState.invalidate();
+		}
+		sceneTarget->bind();
+	}
+	renderShadows(packet);
+	if (packet.shadingPath == ShadingPath::DEFERRED)
+		renderDeferred(packet);
+	else
+		renderForward(packet);
+	if (scaled)
+		upscale(packet, target);
+	indirectRenderer->endFrame();
+	gpuProfiler.endPass(gpuFramePass);
+	gpuProfiler.endFrame();
+
+	const RenderQueue::Stats& queueStats = renderQueue.getStats();
+	stats.draws = queueStats.draws;
+	stats.stateChanges = queueStats.programChanges + queueStats.vaoChanges + queueStats.textureChanges;
+	stats.glCalls = glState.getStats().issued;
+	stats.glFiltered = glState.getStats().filtered;
+	stats.drawCalls = indirectRenderer->getStats().drawCalls;
+	stats.droppedDraws = indirectRenderer->getStats().droppedDraws;
+	stats.culled = packet.culled;
+	stats.cullMilliseconds = packet.cullMilliseconds;
+	stats.occluded = packet.occluded;
+	stats.occludedFraction = packet.occludedFraction;
+	stats.occlusionMilliseconds = packet.occlusionMilliseconds;
+	stats.gpuMilliseconds = gpuProfiler.getLastTime(gpuFramePass);
+	stats.gpuLightingMilliseconds = gpuProfiler.getLastTime(gpuLightingPass);
+	stats.gpuGeometryMilliseconds = gpuProfiler.getLastTime(gpuGeometryPass);
+	stats.gpuDepthMilliseconds = gpuProfiler.getLastTime(gpuDepthPass);
+	stats.gpuShadowMilliseconds = gpuProfiler.getLastTime(gpuShadowPass);
+	stats.shadowRenders = packet.shadows.staticRenders;
+	stats.shadowCasters = packet.shadows.casters;
+	stats.shadedFragments = fragmentCounter->getLastCount();
+	stats.lightReferences = static_cast<unsigned int>(packet.lightClusters.indexCount);
+	stats.lightMilliseconds = packet.lightClusters.milliseconds;
+	stats.resolutionScale = packet.resolutionScale;
+	stats.cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ME::SceneRenderer::render(const Camera& camera) {
+	prepare(camera, packet);
+	render(packet);
+	recordStats(stats);
+}
+
+void ME::SceneRenderer::recordStats(const Stats& stats) {
+	frameStats.record(drawsChannel, stats.draws);
+	frameStats.record(stateChangesChannel, stats.stateChanges);
+	frameStats.record(glIssuedChannel, stats.glCalls);
+	frameStats.record(glFilteredChannel, stats.glFiltered);
+	frameStats.record(drawCallsChannel, stats.drawCalls);
+	frameStats.record(droppedDrawsChannel, stats.droppedDraws);
+	frameStats.record(culledChannel, stats.culled);
+	frameStats.record(cullTimeChannel, stats.cullMilliseconds);
+	frameStats.record(occludedChannel, stats.occludedFraction * 100.0);
+	frameStats.record(occlusionTimeChannel, stats.occlusionMilliseconds);
+	frameStats.record(arenaChannel, frameArena.getStats().used / 1024.0);
+	frameStats.record(gpuFrameChannel, stats.gpuMilliseconds);
+	frameStats.record(gpuLightingChannel, stats.gpuLightingMilliseconds);
+	frameStats.record(gpuGeometryChannel, stats.gpuGeometryMilliseconds);
+	frameStats.record(gpuDepthChannel, stats.gpuDepthMilliseconds);
+	frameStats.record(gpuShadowChannel, stats.gpuShadowMilliseconds);
+	frameStats.record(shadowRendersChannel, stats.shadowRenders);
+	frameStats.record(shadowCastersChannel, stats.shadowCasters);
+	frameStats.record(fragmentsChannel, stats.shadedFragments / 1000.0);
+	frameStats.record(lightReferencesChannel, stats.lightReferences);
+	frameStats.record(lightTimeChannel, stats.lightMilliseconds);
+	frameStats.record(resolutionChannel, stats.resolutionScale * 100.0);
+	frameStats.record(cpuTimeChannel, stats.cpuMilliseconds);
+	resolutionScaler.update(stats.gpuMilliseconds, stats.cpuMilliseconds);
+}
+
+void ME::SceneRenderer::setShadingPath(ShadingPath path) {
+	shadingPath = path;
+}
+
+ME::ShadingPath ME::SceneRenderer::getShadingPath() const {
+	return shadingPath;
+}
+
+const char* ME::SceneRenderer::getShadingPathName(ShadingPath path) {
+	switch (path)
+	{
+	case ShadingPath::FORWARD: return "forward";
+	case ShadingPath::DEFERRED: return "deferred";
+	default: return "unknown";
+	}
+}
+
+void ME::SceneRenderer::setDepthPrepass(bool enabled) {
+	depthPrepass = enabled;
+}
+
+bool ME::SceneRenderer::isDepthPrepass() const {
+	return depthPrepass;
+}
+
+void ME::SceneRenderer::setOcclusionCulling(bool enabled) {
+	occlusionCulling = enabled;
+}
+
+bool ME::SceneRenderer::isOcclusionCulling() const {
+	return occlusionCulling;
+}
+
+void ME::SceneRenderer::setShadowCaching(bool enabled) {
+	shadowCaching = enabled;
+}
+
+bool ME::SceneRenderer::isShadowCaching() const {
+	return shadowCaching;
+}
+
+void ME::SceneRenderer::setFrameBudget(double milliseconds) {
+	resolutionScaler.setBudget(milliseconds);
+}
+
+double ME::SceneRenderer::getFrameBudget() const {
+	return resolutionScaler.getBudget();
+}
+
+float ME::SceneRenderer::getResolutionScale() const {
+	return resolutionScaler.getScale();
+}
+
+bool ME::SceneRenderer::pick(const Ray& ray, RayHit& hit) const {
+	return sceneBVH.raycast(ray, Camera::FAR_PLANE, hit);
+}
+
+size_t ME::SceneRenderer::getCubeCount() const {
+	return cubeModels.size();
+}
+
+size_t ME::SceneRenderer::getLightCount() const {
+	return lights.size();
+}
+
+bool ME::SceneRenderer::isMultiDraw() const {
+	return indirectRenderer->isMultiDraw();
+}
+
+const ME::SceneRenderer::Stats& ME::SceneRenderer::getStats() const {
+	return stats;
+}
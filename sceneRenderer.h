@@ -0,0 +1,275 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "bvh.h"
+#include "camera.h"
+#include "culling.h"
+#include "frameArena.h"
+#include "framePacket.h"
+#include "frameStats.h"
+#include "fragmentCounter.h"
+#include "framebuffer.h"
+#include "gBuffer.h"
+#include "glExtensions.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "indirectRenderer.h"
+#include "lightClusters.h"
+#include "occlusionCuller.h"
+#include "renderQueue.h"
+#include "resolutionScaler.h"
+#include "resourceRegistry.h"
+#include "shader.h"
+#include "shadowAtlas.h"
+#include "simd.h"
+#include "texture.h"
+#include "threadPool.h"
+
+namespace ME {
+	// The container scene and everything needed to draw it. Shared by the
+	// window and the headless benchmark, draws into whatever framebuffer is
+	// bound. Owns GL objects, so it must be destroyed while the context is
+	// still current. A frame is prepared into a FramePacket on the CPU and
+	// then rendered, the two halves may run on different threads.
+	class SceneRenderer {
+	public:
+		// The hand-placed cubes, anything beyond that is scattered behind them.
+		// They spin, everything else is static.
+		static const size_t BASE_CUBE_COUNT = 10;
+		// How far the flashlight's shadow reaches
+		static const float FLASHLIGHT_SHADOW_RANGE;
+		// Visible cubes drawn into the occlusion buffer, the biggest on screen
+		// first, and the smallest one worth drawing as radius over view depth
+		static const size_t MAX_OCCLUDERS = 64;
+		static const float MIN_OCCLUDER_SIZE;
+		// Counters of the last rendered frame
+		struct Stats {
+			// Over every flush of the frame: shadow tiles, depth pre-pass and shading
+			unsigned int draws = 0;
+			unsigned int stateChanges = 0;
+			unsigned int glCalls = 0;
+			unsigned int glFiltered = 0;
+			unsigned int drawCalls = 0;
+			// Draws that didn't fit the indirect buffers and were skipped, should stay 0
+			unsigned int droppedDraws = 0;
+			unsigned int culled = 0;
+			double cullMilliseconds = 0;
+			// Cubes dropped behind the occluders, also as a fraction of the
+			// ones the frustum kept
+			unsigned int occluded = 0;
+			float occludedFraction = 0;
+			double occlusionMilliseconds = 0;
+			// Lag a few frames behind, see GpuProfiler
+			double gpuMilliseconds = 0;
+			double gpuLightingMilliseconds = 0;
+			// G-buffer fill, deferred only
+			double gpuGeometryMilliseconds = 0;
+			double gpuDepthMilliseconds = 0;
+			// Shadow tiles whose static depth was drawn again, and casters
+			// drawn into the atlas over all tiles
+			unsigned int shadowRenders = 0;
+			unsigned int shadowCasters = 0;
+			double gpuShadowMilliseconds = 0;
+			// Fragment shader runs of the pass shading the cubes, forward
+			// lighting or the G-buffer fill. 0 without pipeline statistics.
+			uint64_t shadedFragments = 0;
+			// Clustered lights
+			unsigned int lightReferences = 0;
+			double lightMilliseconds = 0;
+			// Fraction of the output resolution per axis, and the CPU time
+			// render() took to submit the frame
+			float resolutionScale = 1;
+			double cpuMilliseconds = 0;
+		};
+	public:
+		// Throws ME::MyError when textures or shaders fail to load
+		SceneRenderer(const GLExtensions& extensions, FrameStats& frameStats, size_t cubeCount = BASE_CUBE_COUNT,
+			size_t lightCount = 0);
+		SceneRenderer(const SceneRenderer&) = delete;
+		SceneRenderer& operator=(const SceneRenderer&) = delete;
+		~SceneRenderer();
+		// Fills in the matrices, light and visible cubes. Only touches CPU
+		// state, so it may run while another thread renders the previous packet.
+		// The viewport comes from the camera.
+		void prepare(const Camera& camera, FramePacket& packet);
+		// Draws a prepared packet, needs the GL context
+		void render(const FramePacket& packet);
+		// Prepares, renders and records the stats on the calling thread
+		void render(const Camera& camera);
+		// Publishes stats into the FrameStats and feeds the frame times to the
+		// resolution controller. With a render thread, call it on the thread
+		// that owns the FrameStats with the stats sent back.
+		void recordStats(const Stats& stats);
+		// Takes effect from the next prepared packet
+		void setShadingPath(ShadingPath path);
+		ShadingPath getShadingPath() const;
+		// Also takes effect from the next prepared packet
+		void setDepthPrepass(bool enabled);
+		bool isDepthPrepass() const;
+		// Without caching every shadow tile is drawn from scratch each frame,
+		// for comparison. Also from the next prepared packet.
+		void setShadowCaching(bool enabled);
+		bool isShadowCaching() const;
+		// Software occlusion culling after the frustum, see OcclusionCuller.
+		// From the next prepared packet as well.
+		void setOcclusionCulling(bool enabled);
+		bool isOcclusionCulling() const;
+		// GPU frame time to render within, lowering the resolution as needed.
+		// 0 always renders at the full viewport.
+		void setFrameBudget(double milliseconds);
+		double getFrameBudget() const;
+		float getResolutionScale() const;
+		static const char* getShadingPathName(ShadingPath path);
+		// Closest cube along the ray
+		bool pick(const Ray& ray, RayHit& hit) const;
+		size_t getCubeCount() const;
+		size_t getLightCount() const;
+		bool isMultiDraw() const;
+		const Stats& getStats() const;
+	private:
+		void createGeometry();
+		void createScene(size_t cubeCount);
+		void createLights(size_t lightCount);
+		// Moves the lights along their paths, by frame so every run is the same
+		void animateLights(uint64_t frame);
+		// Models of the spinning cubes for this frame, into the arena
+		void animateCubes(FramePacket& packet);
+		const glm::mat4& getCubeModel(const FramePacket& packet, uint32_t cube) const;
+		// Drops the visible cubes hidden behind the biggest visible ones
+		void cullOccluded(FramePacket& packet, uint32_t* visibleCubes);
+		// Hands out atlas tiles to the flashlight and the nearest spot lights
+		// in view, with the casters each one has to draw
+		void prepareShadows(const Camera& camera, FramePacket& packet);
+		// Returns the tile, -1 when the atlas is full
+		int addShadowTile(uint64_t key, const ShadowAtlas::SpotShadow& light, FramePacket& packet);
+		void setUniforms(const FramePacket& packet);
+		void setLightUniforms(const Shader& shader, const FramePacket& packet);
+		void setShadowUniforms(const Shader& shader, const ShadowPacket& shadows);
+		// Queues the listed cubes with the given program's draw packet
+		void submitCubes(const FramePacket& packet, const uint32_t* cubes, size_t count, const DrawPacket& drawPacket,
+			RenderQueue::Pass pass);
+		// Brings the atlas up to date, then rebinds the framebuffer that was bound
+		void renderShadows(const FramePacket& packet);
+		// Fills the depth buffer, the following pass then tests with GL_EQUAL
+		void renderDepthPrepass(const FramePacket& packet);
+		// Sets the depth test for the pass after the pre-pass, or back
+		void setDepthEqual(bool enabled);
+		void renderForward(const FramePacket& packet);
+		// Fills the G-buffer, then lights it into the framebuffer that was bound
+		void renderDeferred(const FramePacket& packet);
+		// Stretches the scaled frame over the target's viewport
+		void upscale(const FramePacket& packet, GLint target);
+
+		FrameStats& frameStats;
+		// Transient per-frame data such as the visible list. Packets point
+		// into it, two buffers keep the one being rendered alive while the
+		// next is prepared.
+		FrameArena frameArena;
+		uint64_t frameNumber;
+		// Camera version and frame size the lighting uniforms were last set for
+		uint64_t uniformVersion;
+		int uniformWidth;
+		int uniformHeight;
+		// Shadow version the shadow matrices were last set for
+		uint64_t shadowUniformVersion;
+		// For rendering on a single thread
+		FramePacket packet;
+		GLState glState;
+		GLuint VBO;
+		GLuint EBO;
+		GLuint sceneVAO;
+		// Positions only, tightly packed for the depth pre-pass
+		GLuint positionVBO;
+		GLuint depthVAO;
+		GLuint lightCubeVAO;
+		// Attribute-less, for the full screen triangle
+		GLuint screenVAO;
+		std::unique_ptr<Texture> diffuseTexture;
+		std::unique_ptr<Texture> specularTexture;
+		std::unique_ptr<Shader> lightingShader;
+		std::unique_ptr<Shader> lightCubeShader;
+		std::unique_ptr<Shader> gBufferShader;
+		std::unique_ptr<Shader> deferredLightingShader;
+		std::unique_ptr<Shader> depthShader;
+		// Depth only as well, with each tile's light as the camera
+		std::unique_ptr<Shader> shadowShader;
+		std::unique_ptr<Shader> upscaleShader;
+		ShadingPath shadingPath;
+		bool depthPrepass;
+		bool shadowCaching;
+		bool occlusionCulling;
+		std::unique_ptr<FragmentCounter> fragmentCounter;
+		// Created by the first deferred frame, follows the viewport size
+		std::unique_ptr<GBuffer> gBuffer;
+		ResolutionScaler resolutionScaler;
+		// Frames below the full resolution are drawn into its corner, then
+		// upscaled. Sized to the output, so a new scale needs no new target.
+		std::unique_ptr<Framebuffer> sceneTarget;
+		RenderQueue renderQueue;
+		std::unique_ptr<IndirectRenderer> indirectRenderer;
+		DrawPacket cubePacket;
+		DrawPacket gBufferPacket;
+		DrawPacket depthPacket;
+		DrawPacket shadowPacket;
+		ThreadPool threadPool;
+		FrustumCuller frustumCuller;
+		// Separate, so the view's cull stats stay its own
+		FrustumCuller shadowCuller;
+		OcclusionCuller occlusionCuller;
+		std::vector<glm::mat4> cubeModels;
+		BoundingSpheres cubeBounds;
+		BVH sceneBVH;
+		// The lights besides the flashlight, and where each one circles around
+		std::vector<Light> lights;
+		std::vector<glm::vec3> lightAnchors;
+		std::unique_ptr<LightClusters> lightClusters;
+		std::unique_ptr<ShadowAtlas> shadowAtlas;
+		// Bumped when a static cube moves, which makes every cached tile stale
+		uint64_t staticSceneVersion;
+		// Bumped when any tile's matrices or the flashlight's tile change
+		uint64_t shadowVersion;
+		int flashlightTile;
+		// Spot lights holding a tile, and the candidates for one with their distance
+		std::vector<size_t> shadowedLights;
+		std::vector<std::pair<float, size_t>> shadowCandidates;
+		GpuProfiler gpuProfiler;
+		int gpuFramePass;
+		int gpuLightingPass;
+		int gpuGeometryPass;
+		int gpuDepthPass;
+		int gpuShadowPass;
+		int drawsChannel;
+		int stateChangesChannel;
+		int glIssuedChannel;
+		int glFilteredChannel;
+		int drawCallsChannel;
+		int droppedDrawsChannel;
+		int culledChannel;
+		int cullTimeChannel;
+		int occludedChannel;
+		int occlusionTimeChannel;
+		int arenaChannel;
+		int gpuFrameChannel;
+		int gpuLightingChannel;
+		int gpuGeometryChannel;
+		int gpuDepthChannel;
+		int gpuShadowChannel;
+		int shadowRendersChannel;
+		int shadowCastersChannel;
+		int fragmentsChannel;
+		int lightReferencesChannel;
+		int lightTimeChannel;
+		int resolutionChannel;
+		int cpuTimeChannel;
+		Stats stats;
+		// Everything above that reports to the ResourceRegistry itself
+		std::vector<ResourceRegistry::ID> memoryIDs;
+	};
+}
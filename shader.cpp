@@ -1,5 +1,7 @@
 ﻿#include "shader.h"
 
+#include "glExtensions.h"
+
 namespace ME {
 	Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 		std::ifstream vertexFile;
@@ -73,10 +75,19 @@ namespace ME {
 		}
 
 		ID = shaderProgram;
+		// The linked binary is the closest thing to the program's footprint, only 4.1 can tell
+		GLint major = 0, minor = 0, binaryLength = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major > 4 || (major == 4 && minor >= 1))
+			glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		memoryID = ResourceRegistry::add(ResourceRegistry::Category::PROGRAM,
+			std::string(vertexPath) + " + " + fragmentPath, static_cast<size_t>(binaryLength));
 	}
 
 	Shader::~Shader() {
 		glDeleteProgram(ID);
+		ResourceRegistry::remove(memoryID);
 	}
 
 	void Shader::use() const{
@@ -84,23 +95,55 @@ namespace ME {
 	}
 
 	void Shader::setBool(const std::string &name, bool value) const{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+		setBool(name.c_str(), value);
 	}
 
 	void Shader::setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		setInt(name.c_str(), value);
 	}
 
 	void Shader::setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		setFloat(name.c_str(), value);
+	}
+
+	void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
+		setVec2(name.c_str(), value);
 	}
 
 	void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+		setVec3(name.c_str(), value);
 	}
 
 	void Shader::setMatrix4f(const std::string& name, const glm::f32mat4& value) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+		setMatrix4f(name.c_str(), value);
+	}
+
+	void Shader::setBool(const char* name, bool value) const {
+		glUniform1i(glGetUniformLocation(ID, name), static_cast<int>(value));
+	}
+
+	void Shader::setInt(const char* name, int value) const {
+		glUniform1i(glGetUniformLocation(ID, name), value);
+	}
+
+	void Shader::setFloat(const char* name, float value) const {
+		glUniform1f(glGetUniformLocation(ID, name), value);
+	}
+
+	void Shader::setVec2(const char* name, const glm::vec2& value) const {
+		glUniform2f(glGetUniformLocation(ID, name), value.x, value.y);
+	}
+
+	void Shader::setVec3(const char* name, const glm::vec3& value) const {
+		glUniform3f(glGetUniformLocation(ID, name), value.x, value.y, value.z);
+	}
+
+	void Shader::setMatrix4f(const char* name, const glm::f32mat4& value) const {
+		glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void Shader::setMatrix4fArray(const char* name, const glm::f32mat4* values, GLsizei count) const {
+		glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, glm::value_ptr(values[0]));
 	}
 
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include "resourceRegistry.h"
 #include "util.h"
 
 namespace ME {
@@ -24,8 +25,20 @@ namespace ME {
 		void setBool(const std::string& name, bool value) const;
 		void setFloat(const std::string& name, float value) const;
 		void setInt(const std::string& name, int value) const;
+		void setVec2(const std::string& name, const glm::vec2& value) const;
 		void setVec3(const std::string& name, const glm::vec3& value) const;
 		void setMatrix4f(const std::string& name, const glm::f32mat4& value) const;
+		// Same without building a std::string, for per-frame calls with literals
+		void setBool(const char* name, bool value) const;
+		void setInt(const char* name, int value) const;
+		void setFloat(const char* name, float value) const;
+		void setVec2(const char* name, const glm::vec2& value) const;
+		void setVec3(const char* name, const glm::vec3& value) const;
+		void setMatrix4f(const char* name, const glm::f32mat4& value) const;
+		// Sets count elements of a uniform array, starting at the first
+		void setMatrix4fArray(const char* name, const glm::f32mat4* values, GLsizei count) const;
+	private:
+		ResourceRegistry::ID memoryID;
 	};
 
 	class ShaderException : public ME::MyError {
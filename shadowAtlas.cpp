@@ -0,0 +1,198 @@
+﻿#include "shadowAtlas.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+#include "framebuffer.h"
+
+const float ME::ShadowAtlas::NEAR_PLANE = 0.1f;
+
+namespace {
+	// Cone edges stay inside the tile
+	const float FOV_MARGIN = 1.1f;
+
+	GLuint createDepthFramebuffer(GLenum attachmentTarget, GLuint attachment) {
+		GLuint fbo;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		if (attachmentTarget == GL_RENDERBUFFER)
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, attachment);
+		else
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachment, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			glDeleteFramebuffers(1, &fbo);
+			throw ME::FramebufferException("Shadow atlas incomplete, status " + std::to_string(status));
+		}
+		return fbo;
+	}
+}
+
+ME::ShadowAtlas::ShadowAtlas() {
+	frame = 0;
+	staticVersion = 0;
+	for (int i = 0; i < TILE_COUNT; i++) {
+		tiles[i].key = 0;
+		tiles[i].staticVersion = 0;
+		tiles[i].cached = false;
+		tiles[i].usedFrame = 0;
+		tiles[i].viewProjection = glm::mat4(1.0f);
+		tiles[i].atlasMatrix = glm::mat4(1.0f);
+		liveMatchesCache[i] = false;
+	}
+	glGenTextures(1, &atlasTexture);
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SIZE, SIZE, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	// Linear with comparison gives 2x2 percentage closer filtering for free
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glGenRenderbuffers(1, &cacheRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, cacheRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SIZE, SIZE);
+	try {
+		atlasFBO = createDepthFramebuffer(GL_TEXTURE_2D, atlasTexture);
+		cacheFBO = createDepthFramebuffer(GL_RENDERBUFFER, cacheRenderbuffer);
+	}
+	catch (...) {
+		glDeleteTextures(1, &atlasTexture);
+		glDeleteRenderbuffers(1, &cacheRenderbuffer);
+		throw;
+	}
+	atlasMemoryID = ResourceRegistry::addTexture("shadow atlas", GL_DEPTH_COMPONENT24, SIZE, SIZE);
+	cacheMemoryID = ResourceRegistry::add(ResourceRegistry::Category::RENDERBUFFER, "shadow cache",
+		static_cast<size_t>(SIZE) * SIZE * ResourceRegistry::getBytesPerPixel(GL_DEPTH_COMPONENT24), GL_DEPTH_COMPONENT24);
+}
+
+ME::ShadowAtlas::~ShadowAtlas() {
+	glDeleteFramebuffers(1, &atlasFBO);
+	glDeleteFramebuffers(1, &cacheFBO);
+	glDeleteTextures(1, &atlasTexture);
+	glDeleteRenderbuffers(1, &cacheRenderbuffer);
+	ResourceRegistry::remove(atlasMemoryID);
+	ResourceRegistry::remove(cacheMemoryID);
+}
+
+bool ME::ShadowAtlas::sameLight(const SpotShadow& a, const SpotShadow& b) {
+	return a.position == b.position && a.direction == b.direction &&
+		a.outerCutOff == b.outerCutOff && a.range == b.range;
+}
+
+void ME::ShadowAtlas::beginFrame(uint64_t staticVersion) {
+	// Frame 0 marks tiles that were never used
+	frame++;
+	this->staticVersion = staticVersion;
+}
+
+int ME::ShadowAtlas::request(uint64_t key, const SpotShadow& light, bool& stale) {
+	int found = -1;
+	int oldest = -1;
+	for (int i = 0; i < TILE_COUNT; i++) {
+		if (tiles[i].usedFrame == frame)
+			continue;
+		if (tiles[i].key == key && tiles[i].usedFrame != 0) {
+			found = i;
+			break;
+		}
+		if (oldest < 0 || tiles[i].usedFrame < tiles[oldest].usedFrame)
+			oldest = i;
+	}
+	if (found < 0) {
+		if (oldest < 0)
+			return -1;
+		found = oldest;
+		tiles[found].cached = false;
+	}
+	Tile& tile = tiles[found];
+	tile.key = key;
+	tile.usedFrame = frame;
+	stale = !tile.cached || tile.staticVersion != staticVersion || !sameLight(tile.light, light);
+	if (!stale)
+		return found;
+	tile.cached = false;
+	tile.light = light;
+	float angle = std::acos(glm::clamp(light.outerCutOff, -1.0f, 1.0f));
+	float fov = glm::min(2.0f * angle * FOV_MARGIN, glm::radians(170.0f));
+	// Any up vector that isn't along the light
+	glm::vec3 up = std::abs(light.direction.y) > .99f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(light.position, light.position + light.direction, up);
+	glm::mat4 projection = glm::perspective(fov, 1.0f, NEAR_PLANE, light.range);
+	tile.viewProjection = projection * view;
+	// Clip space to the tile's corner of the atlas, depth to [0, 1]
+	float scale = 1.0f / TILES_PER_ROW;
+	glm::mat4 bias(1.0f);
+	bias[0][0] = .5f * scale;
+	bias[1][1] = .5f * scale;
+	bias[2][2] = .5f;
+	bias[3][0] = .5f * scale + (found % TILES_PER_ROW) * scale;
+	bias[3][1] = .5f * scale + (found / TILES_PER_ROW) * scale;
+	bias[3][2] = .5f;
+	tile.atlasMatrix = bias * tile.viewProjection;
+	return found;
+}
+
+void ME::ShadowAtlas::markCached(int tile) {
+	tiles[tile].cached = true;
+	tiles[tile].staticVersion = staticVersion;
+}
+
+void ME::ShadowAtlas::invalidate() {
+	for (Tile& tile : tiles)
+		tile.cached = false;
+}
+
+const glm::mat4& ME::ShadowAtlas::getViewProjection(int tile) const {
+	return tiles[tile].viewProjection;
+}
+
+const glm::mat4& ME::ShadowAtlas::getAtlasMatrix(int tile) const {
+	return tiles[tile].atlasMatrix;
+}
+
+void ME::ShadowAtlas::setTile(int tile, GLState& glState) const {
+	GLint x = (tile % TILES_PER_ROW) * TILE_SIZE;
+	GLint y = (tile / TILES_PER_ROW) * TILE_SIZE;
+	glViewport(x, y, TILE_SIZE, TILE_SIZE);
+	glScissor(x, y, TILE_SIZE, TILE_SIZE);
+	glState.enable(GL_SCISSOR_TEST);
+}
+
+void ME::ShadowAtlas::beginStatic(int tile, GLState& glState) {
+	glBindFramebuffer(GL_FRAMEBUFFER, cacheFBO);
+	setTile(tile, glState);
+	glState.depthMask(true);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+bool ME::ShadowAtlas::beginLive(int tile, bool staticChanged, bool hasDynamic, GLState& glState) {
+	// Blits are clipped by the scissor too, so it goes to this tile first
+	setTile(tile, glState);
+	if (staticChanged || hasDynamic || !liveMatchesCache[tile]) {
+		GLint x = (tile % TILES_PER_ROW) * TILE_SIZE;
+		GLint y = (tile / TILES_PER_ROW) * TILE_SIZE;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, cacheFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlasFBO);
+		glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE, x, y, x + TILE_SIZE, y + TILE_SIZE,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	liveMatchesCache[tile] = !hasDynamic;
+	if (!hasDynamic)
+		return false;
+	glBindFramebuffer(GL_FRAMEBUFFER, atlasFBO);
+	return true;
+}
+
+void ME::ShadowAtlas::end(GLState& glState) {
+	glState.disable(GL_SCISSOR_TEST);
+}
+
+GLuint ME::ShadowAtlas::getTexture() const {
+	return atlasTexture;
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "framePacket.h"
+#include "glState.h"
+#include "resourceRegistry.h"
+
+namespace ME {
+	// Spot light shadow maps, as square tiles of one depth atlas shared by
+	// every shadowed light. Each tile keeps a cached copy holding only the
+	// static geometry, rendered again only when its light moves or the
+	// static scene changes. Dynamic geometry is drawn every frame over a copy
+	// of that cache, so a frame's shadow cost follows what changed rather
+	// than the size of the scene.
+	//
+	// Tiles are handed out on the thread preparing packets (request and
+	// markCached), the GL side runs where the context is current. Tiles left
+	// unrequested keep their cache and are reused least recently used first.
+	class ShadowAtlas {
+	public:
+		static const GLsizei TILE_SIZE = 512;
+		static const int TILES_PER_ROW = 4;
+		static const int TILE_COUNT = TILES_PER_ROW * TILES_PER_ROW;
+		static const GLsizei SIZE = TILE_SIZE * TILES_PER_ROW;
+		static const float NEAR_PLANE;
+		static_assert(TILE_COUNT == ShadowPacket::MAX_TILES, "Every atlas tile needs a slot in the packet");
+		// What a tile's depth depends on
+		struct SpotShadow {
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+			// Cosine of the outer cone angle
+			float outerCutOff = 0;
+			// Far plane of the shadow
+			float range = 1;
+		};
+	public:
+		// Needs a current context
+		ShadowAtlas();
+		ShadowAtlas(const ShadowAtlas&) = delete;
+		ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+		~ShadowAtlas();
+
+		// Starts handing out tiles for a frame. Tiles rendered for another
+		// static version are stale.
+		void beginFrame(uint64_t staticVersion);
+		// Tile of the light with this key, the one it had before if it is
+		// still around. Returns -1 when every tile is taken this frame. stale
+		// tells whether the static depth has to be rendered again.
+		int request(uint64_t key, const SpotShadow& light, bool& stale);
+		// The tile's static depth was rendered, it stays cached from now on
+		void markCached(int tile);
+		// Forgets every cached tile
+		void invalidate();
+		// Light view-projection of a requested tile
+		const glm::mat4& getViewProjection(int tile) const;
+		// World space straight to the tile's texture coordinates and depth
+		const glm::mat4& getAtlasMatrix(int tile) const;
+
+		// Clears the tile of the static cache and sets it up for drawing
+		void beginStatic(int tile, GLState& glState);
+		// Brings the tile of the atlas up to date with its cache, then sets
+		// it up for drawing dynamic casters when there are any. Returns
+		// whether it did.
+		bool beginLive(int tile, bool staticChanged, bool hasDynamic, GLState& glState);
+		// Leaves the atlas, the caller rebinds its framebuffer
+		void end(GLState& glState);
+		// Depth texture with comparison on, for sampler2DShadow
+		GLuint getTexture() const;
+	private:
+		struct Tile {
+			uint64_t key;
+			SpotShadow light;
+			uint64_t staticVersion;
+			// The static depth matches key, light and version
+			bool cached;
+			// Frame it was last requested in
+			uint64_t usedFrame;
+			glm::mat4 viewProjection;
+			glm::mat4 atlasMatrix;
+		};
+		static bool sameLight(const SpotShadow& a, const SpotShadow& b);
+		void setTile(int tile, GLState& glState) const;
+
+		Tile tiles[TILE_COUNT];
+		uint64_t frame;
+		uint64_t staticVersion;
+		// GL side
+		GLuint atlasTexture;
+		GLuint atlasFBO;
+		// Static depth only, never sampled
+		GLuint cacheRenderbuffer;
+		GLuint cacheFBO;
+		// Whether the atlas tile holds exactly the cached depth
+		bool liveMatchesCache[TILE_COUNT];
+		ResourceRegistry::ID atlasMemoryID;
+		ResourceRegistry::ID cacheMemoryID;
+	};
+}
@@ -0,0 +1,253 @@
+﻿#include "simd.h"
+
+#include <atomic>
+
+#include "simdKernels.h"
+
+#if defined(ME_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+	ME::simd::InstructionSet detectInstructionSet() {
+		using ME::simd::InstructionSet;
+#if defined(ME_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || maxLeaf < 7)
+			return InstructionSet::SSE2;
+		// The OS has to save the wider registers on a context switch
+		unsigned long long enabled = _xgetbv(0);
+		if ((enabled & 0x6) != 0x6)
+			return InstructionSet::SSE2;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		bool avx512 = (info[1] & (1 << 16)) != 0;
+		if (avx512 && (enabled & 0xE6) == 0xE6)
+			return InstructionSet::AVX512;
+		return avx2 && fma ? InstructionSet::AVX2 : InstructionSet::SSE2;
+#elif defined(ME_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+		// Also checks that the OS saves the registers
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return InstructionSet::AVX512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return InstructionSet::AVX2;
+		return InstructionSet::SSE2;
+#else
+		return InstructionSet::SCALAR;
+#endif
+	}
+
+	const ME::simd::Kernels& getKernels(ME::simd::InstructionSet instructionSet) {
+		switch (instructionSet) {
+#if defined(ME_SIMD_X86)
+		case ME::simd::InstructionSet::SSE2:
+			return ME::simd::getSse2Kernels();
+		case ME::simd::InstructionSet::AVX2:
+			return ME::simd::getAvx2Kernels();
+		case ME::simd::InstructionSet::AVX512:
+			return ME::simd::getAvx512Kernels();
+#endif
+		default:
+			return ME::simd::getScalarKernels();
+		}
+	}
+
+	struct Dispatch {
+		ME::simd::InstructionSet supported;
+		std::atomic<ME::simd::InstructionSet> active;
+		std::atomic<const ME::simd::Kernels*> kernels;
+
+		Dispatch() {
+			supported = detectInstructionSet();
+			active = supported;
+			kernels = &getKernels(supported);
+		}
+	};
+
+	Dispatch& getDispatch() {
+		static Dispatch dispatch;
+		return dispatch;
+	}
+
+	const ME::simd::Kernels& activeKernels() {
+		return *getDispatch().kernels.load(std::memory_order_relaxed);
+	}
+}
+
+const ME::simd::Kernels& ME::simd::getScalarKernels() {
+	static const Kernels kernels = { composeTRSBatch<ScalarLanes>, multiplyBatch<ScalarLanes>,
+		inverseTransposeBatch<ScalarLanes>, transformBoundsBatch<ScalarLanes> };
+	return kernels;
+}
+
+const char* ME::simd::getInstructionSetName(InstructionSet instructionSet) {
+	switch (instructionSet) {
+	case InstructionSet::SSE2:
+		return "SSE2";
+	case InstructionSet::AVX2:
+		return "AVX2";
+	case InstructionSet::AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+ME::simd::InstructionSet ME::simd::getSupportedInstructionSet() {
+	return getDispatch().supported;
+}
+
+ME::simd::InstructionSet ME::simd::getInstructionSet() {
+	return getDispatch().active;
+}
+
+bool ME::simd::setInstructionSet(InstructionSet instructionSet) {
+	Dispatch& dispatch = getDispatch();
+	if (instructionSet > dispatch.supported)
+		return false;
+	dispatch.active = instructionSet;
+	dispatch.kernels = &getKernels(instructionSet);
+	return true;
+}
+
+void ME::simd::TransformBatch::clear() {
+	positionX.clear();
+	positionY.clear();
+	positionZ.clear();
+	rotationX.clear();
+	rotationY.clear();
+	rotationZ.clear();
+	rotationW.clear();
+	scaleX.clear();
+	scaleY.clear();
+	scaleZ.clear();
+}
+
+void ME::simd::TransformBatch::reserve(size_t capacity) {
+	positionX.reserve(capacity);
+	positionY.reserve(capacity);
+	positionZ.reserve(capacity);
+	rotationX.reserve(capacity);
+	rotationY.reserve(capacity);
+	rotationZ.reserve(capacity);
+	rotationW.reserve(capacity);
+	scaleX.reserve(capacity);
+	scaleY.reserve(capacity);
+	scaleZ.reserve(capacity);
+}
+
+uint32_t ME::simd::TransformBatch::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	rotationX.push_back(rotation.x);
+	rotationY.push_back(rotation.y);
+	rotationZ.push_back(rotation.z);
+	rotationW.push_back(rotation.w);
+	scaleX.push_back(scale.x);
+	scaleY.push_back(scale.y);
+	scaleZ.push_back(scale.z);
+	return static_cast<uint32_t>(positionX.size() - 1);
+}
+
+size_t ME::simd::TransformBatch::size() const {
+	return positionX.size();
+}
+
+void ME::simd::MatrixBatch::clear() {
+	for (std::vector<float>& element : elements)
+		element.clear();
+}
+
+void ME::simd::MatrixBatch::resize(size_t count) {
+	for (std::vector<float>& element : elements)
+		element.resize(count);
+}
+
+size_t ME::simd::MatrixBatch::size() const {
+	return elements[0].size();
+}
+
+glm::mat4 ME::simd::MatrixBatch::get(size_t index) const {
+	glm::mat4 matrix;
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			matrix[column][row] = elements[column * 4 + row][index];
+	return matrix;
+}
+
+void ME::simd::MatrixBatch::set(size_t index, const glm::mat4& matrix) {
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			elements[column * 4 + row][index] = matrix[column][row];
+}
+
+void ME::simd::composeTRS(const TransformBatch& transforms, MatrixBatch& models) {
+	models.resize(transforms.size());
+	const float* in[10] = {
+		transforms.positionX.data(), transforms.positionY.data(), transforms.positionZ.data(),
+		transforms.rotationX.data(), transforms.rotationY.data(), transforms.rotationZ.data(), transforms.rotationW.data(),
+		transforms.scaleX.data(), transforms.scaleY.data(), transforms.scaleZ.data(),
+	};
+	float* out[16];
+	for (int element = 0; element < 16; element++)
+		out[element] = models.elements[element].data();
+	activeKernels().composeTRS(transforms.size(), in, out);
+}
+
+void ME::simd::multiply(const glm::mat4& left, const MatrixBatch& in, MatrixBatch& out) {
+	size_t count = in.size();
+	out.resize(count);
+	const float* inElements[16];
+	float* outElements[16];
+	for (int element = 0; element < 16; element++) {
+		inElements[element] = in.elements[element].data();
+		outElements[element] = out.elements[element].data();
+	}
+	activeKernels().multiply(count, &left[0][0], inElements, outElements);
+}
+
+void ME::simd::inverseTranspose(const MatrixBatch& in, MatrixBatch& out) {
+	size_t count = in.size();
+	out.resize(count);
+	const float* inElements[16];
+	float* outElements[16];
+	for (int element = 0; element < 16; element++) {
+		inElements[element] = in.elements[element].data();
+		outElements[element] = out.elements[element].data();
+	}
+	activeKernels().inverseTranspose(count, inElements, outElements);
+}
+
+void ME::simd::transformBounds(const MatrixBatch& models, const BoundingBoxes& local, BoundingBoxes& world) {
+	size_t count = local.size();
+	if (&world != &local) {
+		world.centerX.resize(count);
+		world.centerY.resize(count);
+		world.centerZ.resize(count);
+		world.extentX.resize(count);
+		world.extentY.resize(count);
+		world.extentZ.resize(count);
+	}
+	const float* modelElements[16];
+	for (int element = 0; element < 16; element++)
+		modelElements[element] = models.elements[element].data();
+	const float* in[6] = {
+		local.centerX.data(), local.centerY.data(), local.centerZ.data(),
+		local.extentX.data(), local.extentY.data(), local.extentZ.data(),
+	};
+	float* out[6] = {
+		world.centerX.data(), world.centerY.data(), world.centerZ.data(),
+		world.extentX.data(), world.extentY.data(), world.extentZ.data(),
+	};
+	activeKernels().transformBounds(count, modelElements, in, out);
+}
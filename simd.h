@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "culling.h"
+
+namespace ME {
+	// Batch transform math for many objects at once. Everything is stored
+	// structure-of-arrays, one array per component, and each kernel handles a
+	// whole SIMD register of objects per step. The instruction set is picked
+	// at runtime from what the CPU supports.
+	namespace simd {
+		enum class InstructionSet {
+			SCALAR,
+			SSE2,
+			// AVX2 with FMA
+			AVX2,
+			AVX512,
+		};
+		const char* getInstructionSetName(InstructionSet instructionSet);
+		// The best set this CPU and OS support
+		InstructionSet getSupportedInstructionSet();
+		InstructionSet getInstructionSet();
+		// Forces a set, e.g. to compare against the faster ones. Returns false
+		// and changes nothing when the CPU doesn't support it.
+		bool setInstructionSet(InstructionSet instructionSet);
+
+		// Translation, rotation and scale of every object. Rotations must be
+		// unit quaternions.
+		class TransformBatch {
+		public:
+			void clear();
+			void reserve(size_t capacity);
+			uint32_t add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.f));
+			size_t size() const;
+
+			std::vector<float> positionX;
+			std::vector<float> positionY;
+			std::vector<float> positionZ;
+			std::vector<float> rotationX;
+			std::vector<float> rotationY;
+			std::vector<float> rotationZ;
+			std::vector<float> rotationW;
+			std::vector<float> scaleX;
+			std::vector<float> scaleY;
+			std::vector<float> scaleZ;
+		};
+
+		// 4x4 matrices, elements[column * 4 + row] holds that element of every
+		// matrix, the same order as glm
+		class MatrixBatch {
+		public:
+			void clear();
+			void resize(size_t count);
+			size_t size() const;
+			glm::mat4 get(size_t index) const;
+			void set(size_t index, const glm::mat4& matrix);
+
+			std::vector<float> elements[16];
+		};
+
+		// models[i] = translate(position) * rotate(rotation) * scale(scale)
+		void composeTRS(const TransformBatch& transforms, MatrixBatch& models);
+		// out[i] = left * in[i], e.g. the view-projection times every model.
+		// in and out may be the same batch.
+		void multiply(const glm::mat4& left, const MatrixBatch& in, MatrixBatch& out);
+		// Normal matrices, transpose(inverse()) of the upper 3x3 with the rest
+		// of the identity around it. Singular matrices give infinities.
+		void inverseTranspose(const MatrixBatch& in, MatrixBatch& out);
+		// World boxes enclosing each local box under its matrix. local and
+		// world may be the same batch.
+		void transformBounds(const MatrixBatch& models, const BoundingBoxes& local, BoundingBoxes& world);
+	}
+}
@@ -0,0 +1,44 @@
+﻿#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <cstddef>
+#include <immintrin.h>
+
+// Only the kernels below are compiled for AVX2, the rest of the program still
+// runs on any x64 CPU. Headers go above the pragma so their inline functions
+// aren't compiled for AVX2 too. MSVC takes the intrinsics without a flag.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "simdKernels.h"
+
+namespace {
+	struct Lanes {
+		static const int WIDTH = 8;
+		typedef __m256 Float;
+		static Float load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, Float a) { _mm256_storeu_ps(p, a); }
+		static Float set(float value) { return _mm256_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float mulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+		static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+		static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+	};
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const ME::simd::Kernels& ME::simd::getAvx2Kernels() {
+	static const Kernels kernels = { composeTRSBatch<Lanes>, multiplyBatch<Lanes>,
+		inverseTransposeBatch<Lanes>, transformBoundsBatch<Lanes> };
+	return kernels;
+}
+#endif
@@ -0,0 +1,42 @@
+﻿#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <cstddef>
+#include <immintrin.h>
+
+// See simdAvx2.cpp
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include "simdKernels.h"
+
+namespace {
+	struct Lanes {
+		static const int WIDTH = 16;
+		typedef __m512 Float;
+		static Float load(const float* p) { return _mm512_loadu_ps(p); }
+		static void store(float* p, Float a) { _mm512_storeu_ps(p, a); }
+		static Float set(float value) { return _mm512_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+		static Float mulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+		static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+		static Float abs(Float a) { return _mm512_abs_ps(a); }
+	};
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const ME::simd::Kernels& ME::simd::getAvx512Kernels() {
+	static const Kernels kernels = { composeTRSBatch<Lanes>, multiplyBatch<Lanes>,
+		inverseTransposeBatch<Lanes>, transformBoundsBatch<Lanes> };
+	return kernels;
+}
+#endif
@@ -0,0 +1,208 @@
+﻿#pragma once
+
+#include <cstddef>
+
+// Internal to simd.cpp and the per-instruction-set simd*.cpp files. Every
+// instruction set file defines a Lanes struct for its registers and then
+// instantiates the kernel templates below with it.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ME_SIMD_X86
+#endif
+
+namespace ME {
+	namespace simd {
+		// The kernels work on raw component arrays, so the instruction set
+		// files need nothing but this header and the intrinsics
+		struct Kernels {
+			// Position xyz, rotation xyzw, scale xyz in, 16 elements out
+			void (*composeTRS)(size_t count, const float* const* transforms, float* const* models);
+			void (*multiply)(size_t count, const float* left, const float* const* in, float* const* out);
+			void (*inverseTranspose)(size_t count, const float* const* in, float* const* out);
+			// Center xyz and extent xyz in and out
+			void (*transformBounds)(size_t count, const float* const* models, const float* const* local, float* const* world);
+		};
+		const Kernels& getScalarKernels();
+#if defined(ME_SIMD_X86)
+		const Kernels& getSse2Kernels();
+		const Kernels& getAvx2Kernels();
+		const Kernels& getAvx512Kernels();
+#endif
+	}
+}
+
+// Anonymous, so the copy of a kernel compiled for AVX2 is never merged by the
+// linker with the one other files call on any CPU
+namespace {
+	struct ScalarLanes {
+		static const int WIDTH = 1;
+		typedef float Float;
+		static Float load(const float* p) { return *p; }
+		static void store(float* p, Float a) { *p = a; }
+		static Float set(float value) { return value; }
+		static Float add(Float a, Float b) { return a + b; }
+		static Float sub(Float a, Float b) { return a - b; }
+		static Float mul(Float a, Float b) { return a * b; }
+		static Float mulAdd(Float a, Float b, Float c) { return a * b + c; }
+		static Float div(Float a, Float b) { return a / b; }
+		static Float abs(Float a) { return a < 0 ? -a : a; }
+	};
+
+	template <typename Lanes>
+	size_t composeTRSRange(size_t begin, size_t end, const float* const* transforms, float* const* models) {
+		typedef typename Lanes::Float F;
+		const F zero = Lanes::set(0.f);
+		const F one = Lanes::set(1.f);
+		const F two = Lanes::set(2.f);
+		size_t i = begin;
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			F x = Lanes::load(transforms[3] + i);
+			F y = Lanes::load(transforms[4] + i);
+			F z = Lanes::load(transforms[5] + i);
+			F w = Lanes::load(transforms[6] + i);
+			F scaleX = Lanes::load(transforms[7] + i);
+			F scaleY = Lanes::load(transforms[8] + i);
+			F scaleZ = Lanes::load(transforms[9] + i);
+			// Same terms as glm::mat3_cast
+			F xx = Lanes::mul(x, x), yy = Lanes::mul(y, y), zz = Lanes::mul(z, z);
+			F xz = Lanes::mul(x, z), xy = Lanes::mul(x, y), yz = Lanes::mul(y, z);
+			F wx = Lanes::mul(w, x), wy = Lanes::mul(w, y), wz = Lanes::mul(w, z);
+			Lanes::store(models[0] + i, Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(yy, zz))), scaleX));
+			Lanes::store(models[1] + i, Lanes::mul(Lanes::mul(two, Lanes::add(xy, wz)), scaleX));
+			Lanes::store(models[2] + i, Lanes::mul(Lanes::mul(two, Lanes::sub(xz, wy)), scaleX));
+			Lanes::store(models[3] + i, zero);
+			Lanes::store(models[4] + i, Lanes::mul(Lanes::mul(two, Lanes::sub(xy, wz)), scaleY));
+			Lanes::store(models[5] + i, Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, zz))), scaleY));
+			Lanes::store(models[6] + i, Lanes::mul(Lanes::mul(two, Lanes::add(yz, wx)), scaleY));
+			Lanes::store(models[7] + i, zero);
+			Lanes::store(models[8] + i, Lanes::mul(Lanes::mul(two, Lanes::add(xz, wy)), scaleZ));
+			Lanes::store(models[9] + i, Lanes::mul(Lanes::mul(two, Lanes::sub(yz, wx)), scaleZ));
+			Lanes::store(models[10] + i, Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, yy))), scaleZ));
+			Lanes::store(models[11] + i, zero);
+			Lanes::store(models[12] + i, Lanes::load(transforms[0] + i));
+			Lanes::store(models[13] + i, Lanes::load(transforms[1] + i));
+			Lanes::store(models[14] + i, Lanes::load(transforms[2] + i));
+			Lanes::store(models[15] + i, one);
+		}
+		return i;
+	}
+
+	template <typename Lanes>
+	size_t multiplyRange(size_t begin, size_t end, const float* left, const float* const* in, float* const* out) {
+		typedef typename Lanes::Float F;
+		F l[16];
+		for (int element = 0; element < 16; element++)
+			l[element] = Lanes::set(left[element]);
+		size_t i = begin;
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			// A column of the result only needs the same column of in
+			for (int column = 0; column < 4; column++) {
+				F c0 = Lanes::load(in[column * 4] + i);
+				F c1 = Lanes::load(in[column * 4 + 1] + i);
+				F c2 = Lanes::load(in[column * 4 + 2] + i);
+				F c3 = Lanes::load(in[column * 4 + 3] + i);
+				for (int row = 0; row < 4; row++) {
+					F sum = Lanes::mul(l[row], c0);
+					sum = Lanes::mulAdd(l[4 + row], c1, sum);
+					sum = Lanes::mulAdd(l[8 + row], c2, sum);
+					sum = Lanes::mulAdd(l[12 + row], c3, sum);
+					Lanes::store(out[column * 4 + row] + i, sum);
+				}
+			}
+		}
+		return i;
+	}
+
+	template <typename Lanes>
+	size_t inverseTransposeRange(size_t begin, size_t end, const float* const* in, float* const* out) {
+		typedef typename Lanes::Float F;
+		const F zero = Lanes::set(0.f);
+		const F one = Lanes::set(1.f);
+		size_t i = begin;
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			F a0x = Lanes::load(in[0] + i), a0y = Lanes::load(in[1] + i), a0z = Lanes::load(in[2] + i);
+			F a1x = Lanes::load(in[4] + i), a1y = Lanes::load(in[5] + i), a1z = Lanes::load(in[6] + i);
+			F a2x = Lanes::load(in[8] + i), a2y = Lanes::load(in[9] + i), a2z = Lanes::load(in[10] + i);
+			// The cofactor matrix has the cross products of the columns as its
+			// columns, divided by the determinant it is the inverse transpose
+			F c0x = Lanes::sub(Lanes::mul(a1y, a2z), Lanes::mul(a1z, a2y));
+			F c0y = Lanes::sub(Lanes::mul(a1z, a2x), Lanes::mul(a1x, a2z));
+			F c0z = Lanes::sub(Lanes::mul(a1x, a2y), Lanes::mul(a1y, a2x));
+			F c1x = Lanes::sub(Lanes::mul(a2y, a0z), Lanes::mul(a2z, a0y));
+			F c1y = Lanes::sub(Lanes::mul(a2z, a0x), Lanes::mul(a2x, a0z));
+			F c1z = Lanes::sub(Lanes::mul(a2x, a0y), Lanes::mul(a2y, a0x));
+			F c2x = Lanes::sub(Lanes::mul(a0y, a1z), Lanes::mul(a0z, a1y));
+			F c2y = Lanes::sub(Lanes::mul(a0z, a1x), Lanes::mul(a0x, a1z));
+			F c2z = Lanes::sub(Lanes::mul(a0x, a1y), Lanes::mul(a0y, a1x));
+			F determinant = Lanes::mulAdd(a0x, c0x, Lanes::mulAdd(a0y, c0y, Lanes::mul(a0z, c0z)));
+			F inverse = Lanes::div(one, determinant);
+			Lanes::store(out[0] + i, Lanes::mul(c0x, inverse));
+			Lanes::store(out[1] + i, Lanes::mul(c0y, inverse));
+			Lanes::store(out[2] + i, Lanes::mul(c0z, inverse));
+			Lanes::store(out[3] + i, zero);
+			Lanes::store(out[4] + i, Lanes::mul(c1x, inverse));
+			Lanes::store(out[5] + i, Lanes::mul(c1y, inverse));
+			Lanes::store(out[6] + i, Lanes::mul(c1z, inverse));
+			Lanes::store(out[7] + i, zero);
+			Lanes::store(out[8] + i, Lanes::mul(c2x, inverse));
+			Lanes::store(out[9] + i, Lanes::mul(c2y, inverse));
+			Lanes::store(out[10] + i, Lanes::mul(c2z, inverse));
+			Lanes::store(out[11] + i, zero);
+			Lanes::store(out[12] + i, zero);
+			Lanes::store(out[13] + i, zero);
+			Lanes::store(out[14] + i, zero);
+			Lanes::store(out[15] + i, one);
+		}
+		return i;
+	}
+
+	template <typename Lanes>
+	size_t transformBoundsRange(size_t begin, size_t end, const float* const* models, const float* const* local, float* const* world) {
+		typedef typename Lanes::Float F;
+		size_t i = begin;
+		for (; i + Lanes::WIDTH <= end; i += Lanes::WIDTH) {
+			F x = Lanes::load(local[0] + i);
+			F y = Lanes::load(local[1] + i);
+			F z = Lanes::load(local[2] + i);
+			F extentX = Lanes::load(local[3] + i);
+			F extentY = Lanes::load(local[4] + i);
+			F extentZ = Lanes::load(local[5] + i);
+			F center[3], extent[3];
+			// Same as AABB::fromTransform, the extent is projected on every axis
+			for (int axis = 0; axis < 3; axis++) {
+				F m0 = Lanes::load(models[axis] + i);
+				F m1 = Lanes::load(models[4 + axis] + i);
+				F m2 = Lanes::load(models[8 + axis] + i);
+				center[axis] = Lanes::mulAdd(m0, x, Lanes::mulAdd(m1, y,
+					Lanes::mulAdd(m2, z, Lanes::load(models[12 + axis] + i))));
+				extent[axis] = Lanes::mulAdd(Lanes::abs(m0), extentX, Lanes::mulAdd(Lanes::abs(m1), extentY,
+					Lanes::mul(Lanes::abs(m2), extentZ)));
+			}
+			for (int axis = 0; axis < 3; axis++) {
+				Lanes::store(world[axis] + i, center[axis]);
+				Lanes::store(world[3 + axis] + i, extent[axis]);
+			}
+		}
+		return i;
+	}
+
+	// The vector loop first, the objects that don't fill a register after
+	template <typename Lanes>
+	void composeTRSBatch(size_t count, const float* const* transforms, float* const* models) {
+		composeTRSRange<ScalarLanes>(composeTRSRange<Lanes>(0, count, transforms, models), count, transforms, models);
+	}
+
+	template <typename Lanes>
+	void multiplyBatch(size_t count, const float* left, const float* const* in, float* const* out) {
+		multiplyRange<ScalarLanes>(multiplyRange<Lanes>(0, count, left, in, out), count, left, in, out);
+	}
+
+	template <typename Lanes>
+	void inverseTransposeBatch(size_t count, const float* const* in, float* const* out) {
+		inverseTransposeRange<ScalarLanes>(inverseTransposeRange<Lanes>(0, count, in, out), count, in, out);
+	}
+
+	template <typename Lanes>
+	void transformBoundsBatch(size_t count, const float* const* models, const float* const* local, float* const* world) {
+		transformBoundsRange<ScalarLanes>(transformBoundsRange<Lanes>(0, count, models, local, world), count, models, local, world);
+	}
+}
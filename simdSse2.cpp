@@ -0,0 +1,38 @@
+﻿#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <cstddef>
+#include <emmintrin.h>
+
+// x64 always has SSE2, only 32-bit GCC builds need to be told
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include "simdKernels.h"
+
+namespace {
+	struct Lanes {
+		static const int WIDTH = 4;
+		typedef __m128 Float;
+		static Float load(const float* p) { return _mm_loadu_ps(p); }
+		static void store(float* p, Float a) { _mm_storeu_ps(p, a); }
+		static Float set(float value) { return _mm_set1_ps(value); }
+		static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float mulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+		static Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+	};
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+const ME::simd::Kernels& ME::simd::getSse2Kernels() {
+	static const Kernels kernels = { composeTRSBatch<Lanes>, multiplyBatch<Lanes>,
+		inverseTransposeBatch<Lanes>, transformBoundsBatch<Lanes> };
+	return kernels;
+}
+#endif
@@ -4,9 +4,16 @@ ME::Texture::Texture() {
 	allocated = false;
 	glID = 0;
 	data = nullptr;
+	width = 0;
+	height = 0;
+	channels = 0;
+	memoryID = 0;
+	dataMemoryID = 0;
 }
 ME::Texture::Texture(const char* path) {
 	allocated = true;
+	memoryID = 0;
+	dataMemoryID = 0;
 	glGenTextures(1, &glID);
 	glBindTexture(GL_TEXTURE_2D, glID);
 	// Set Texture wraping configurations
@@ -15,42 +22,61 @@ ME::Texture::Texture(const char* path) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	// Loading a texture image
-	int width, height, nrChannels;
 	stbi_set_flip_vertically_on_load(true);
-	data = stbi_load(path, &width, &height, &nrChannels, 0);
+	data = stbi_load(path, &width, &height, &channels, 0);
 	if (data == nullptr) {
 		throw ME::MyError("Fail to load texture image");
 	}
 	// Loading textures and generating mipmaps
 	GLenum format;
-	if (nrChannels == 1)
+	if (channels == 1)
 		format = GL_RED;
-	else if (nrChannels == 3)
+	else if (channels == 3)
 		format = GL_RGB;
-	else if (nrChannels == 4)
+	else if (channels == 4)
 		format = GL_RGBA;
 	else
 		throw ME::MyError("Unsupported texture format");
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 	glGenerateMipmap(GL_TEXTURE_2D);
+	memoryID = ResourceRegistry::addTexture(path, GL_RGB, width, height, ResourceRegistry::getMipLevelCount(width, height));
+	// The decoded pixels stay around after the upload
+	dataMemoryID = ResourceRegistry::add(ResourceRegistry::Category::CPU, std::string(path) + " pixels",
+		static_cast<size_t>(width) * height * channels);
 }
 ME::Texture::Texture(Texture&& other) noexcept {
 	glID = other.glID;
 	data = other.data;
 	allocated = other.allocated;
+	width = other.width;
+	height = other.height;
+	channels = other.channels;
+	memoryID = other.memoryID;
+	dataMemoryID = other.dataMemoryID;
 	other.data = nullptr;
 	other.allocated = false;
+	other.memoryID = 0;
+	other.dataMemoryID = 0;
 }
 ME::Texture& ME::Texture::operator=(Texture&& other) noexcept {
 	if (this != &other) {
 		stbi_image_free(data);
 		if (allocated)
 			glDeleteTextures(1, &glID);
+		ResourceRegistry::remove(memoryID);
+		ResourceRegistry::remove(dataMemoryID);
 		glID = other.glID;
 		data = other.data;
 		allocated = other.allocated;
+		width = other.width;
+		height = other.height;
+		channels = other.channels;
+		memoryID = other.memoryID;
+		dataMemoryID = other.dataMemoryID;
 		other.data = nullptr;
 		other.allocated = false;
+		other.memoryID = 0;
+		other.dataMemoryID = 0;
 	}
 	return *this;
 }
@@ -60,8 +86,19 @@ GLuint& ME::Texture::getGlID() {
 	}
 	return glID;
 }
+int ME::Texture::getWidth() const {
+	return width;
+}
+int ME::Texture::getHeight() const {
+	return height;
+}
+int ME::Texture::getChannels() const {
+	return channels;
+}
 ME::Texture::~Texture() {
 	if (allocated)
 		glDeleteTextures(1, &glID);
 	stbi_image_free(data);
+	ResourceRegistry::remove(memoryID);
+	ResourceRegistry::remove(dataMemoryID);
 }
\ No newline at end of file
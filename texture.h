@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <iostream>
 
+#include "resourceRegistry.h"
 #include "stb_image.h"
 #include "util.h"
 
@@ -12,6 +13,11 @@ namespace ME {
 		bool allocated;
 		GLuint glID;
 		unsigned char* data;
+		int width;
+		int height;
+		int channels;
+		ResourceRegistry::ID memoryID;
+		ResourceRegistry::ID dataMemoryID;
 	public:
 		Texture();
 		Texture(const char* path);
@@ -20,6 +26,9 @@ namespace ME {
 		Texture(Texture&& other) noexcept;
 		Texture& operator=(Texture&& other) noexcept;
 		GLuint& getGlID();
+		int getWidth() const;
+		int getHeight() const;
+		int getChannels() const;
 		~Texture();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+﻿#include "threadPool.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+ME::ThreadPool::ThreadPool(unsigned int workerCount) {
+	if (workerCount == 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+	stopping = false;
+	generation = 0;
+	function = nullptr;
+	context = nullptr;
+	count = 0;
+	chunkSize = 1;
+	chunkCount = 0;
+	nextChunk = 0;
+	activeWorkers = 0;
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ME::ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+unsigned int ME::ThreadPool::getThreadCount() const {
+	return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+void ME::ThreadPool::run(size_t newCount, size_t newChunkSize, JobFunction newFunction, const void* newContext) {
+	if (newCount == 0)
+		return;
+	newChunkSize = std::max<size_t>(newChunkSize, 1);
+	// Not worth waking anyone up, the chunks still go one at a time since
+	// callers may index per chunk
+	if (workers.empty() || newCount <= newChunkSize) {
+		for (size_t begin = 0; begin < newCount; begin += newChunkSize)
+			newFunction(newContext, begin, std::min(begin + newChunkSize, newCount));
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		function = newFunction;
+		context = newContext;
+		count = newCount;
+		chunkSize = newChunkSize;
+		chunkCount = (newCount + newChunkSize - 1) / newChunkSize;
+		nextChunk = 0;
+		activeWorkers = static_cast<unsigned int>(workers.size());
+		generation++;
+	}
+	wake.notify_all();
+	ME_PROFILE_SCOPE("parallelFor");
+	workOnChunks();
+	// The job and its context live on the caller's stack, so wait until no
+	// worker can still touch them
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return activeWorkers == 0; });
+}
+
+void ME::ThreadPool::workOnChunks() {
+	for (;;) {
+		size_t chunk = nextChunk.fetch_add(1);
+		if (chunk >= chunkCount)
+			return;
+		size_t begin = chunk * chunkSize;
+		size_t end = std::min(begin + chunkSize, count);
+		function(context, begin, end);
+	}
+}
+
+void ME::ThreadPool::workerLoop() {
+	ME_PROFILE_THREAD("worker");
+	unsigned long long seenGeneration = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = generation;
+		}
+		{
+			ME_PROFILE_SCOPE("parallelFor");
+			workOnChunks();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		done.notify_one();
+	}
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ME {
+	// Fixed set of workers for data-parallel loops. The calling thread takes
+	// part in the work, and jobs are passed without std::function so a
+	// parallelFor never allocates.
+	class ThreadPool {
+	public:
+		// 0 picks one worker per hardware thread besides the caller
+		explicit ThreadPool(unsigned int workerCount = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		~ThreadPool();
+		// Workers plus the calling thread
+		unsigned int getThreadCount() const;
+		// Calls job(begin, end) for consecutive chunks of [0, count) and
+		// returns once all of them are done. Only one thread may run jobs at a time.
+		template <typename Job>
+		void parallelFor(size_t count, size_t chunkSize, const Job& job) {
+			run(count, chunkSize, &invoke<Job>, &job);
+		}
+	private:
+		typedef void (*JobFunction)(const void* context, size_t begin, size_t end);
+		template <typename Job>
+		static void invoke(const void* context, size_t begin, size_t end) {
+			(*static_cast<const Job*>(context))(begin, end);
+		}
+		void run(size_t count, size_t chunkSize, JobFunction function, const void* context);
+		void workOnChunks();
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		bool stopping;
+		unsigned long long generation;
+		// The job currently being run
+		JobFunction function;
+		const void* context;
+		size_t count;
+		size_t chunkSize;
+		size_t chunkCount;
+		std::atomic<size_t> nextChunk;
+		unsigned int activeWorkers;
+	};
+}
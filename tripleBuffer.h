@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace ME {
+	// Hands the latest value from one producer thread to one consumer thread
+	// without locks. The producer fills the write slot and publishes it, the
+	// consumer picks up the newest published slot. Neither side ever waits
+	// for the other, a value published twice before being read replaces the
+	// older one.
+	template <typename T>
+	class TripleBuffer {
+	public:
+		TripleBuffer() : middle(1) {
+			writeIndex = 0;
+			readIndex = 2;
+		}
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		// Producer side
+		T& getWriteBuffer() {
+			return slots[writeIndex];
+		}
+		// Returns true when the previous value was replaced before being read
+		bool publish() {
+			uint8_t previous = middle.exchange(static_cast<uint8_t>(writeIndex | FRESH), std::memory_order_acq_rel);
+			writeIndex = previous & INDEX;
+			return (previous & FRESH) != 0;
+		}
+		// Safe to call from either side
+		bool hasUnread() const {
+			return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+		}
+
+		// Consumer side. Returns false when nothing new was published, the
+		// read buffer then still holds the previous value.
+		bool acquire() {
+			if (!hasUnread())
+				return false;
+			uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = previous & INDEX;
+			return true;
+		}
+		const T& getReadBuffer() const {
+			return slots[readIndex];
+		}
+	private:
+		static const uint8_t INDEX = 3;
+		static const uint8_t FRESH = 4;
+
+		T slots[3];
+		// Index of the slot between the two sides, plus FRESH when unread
+		std::atomic<uint8_t> middle;
+		uint8_t writeIndex;
+		uint8_t readIndex;
+	};
+}
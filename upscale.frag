@@ -0,0 +1,18 @@
+﻿#version 330 core
+
+// Stretches a frame rendered below the output resolution over the whole
+// viewport, with the texture's bilinear filter
+in vec2 screenCoordinate;
+
+uniform sampler2D frame;
+// Part of the texture the frame covers, and the last texel centre inside it,
+// so the filter never reaches past its edge
+uniform vec2 frameScale;
+uniform vec2 frameLimit;
+
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = texture(frame, min(screenCoordinate * frameScale, frameLimit));
+}
@@ -0,0 +1,11 @@
+﻿#version 330 core
+
+// One triangle covering the screen, no vertex buffer needed
+out vec2 screenCoordinate;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    screenCoordinate = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}